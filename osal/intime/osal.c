@@ -86,3 +86,23 @@ osal_mutex_t * osal_mtx_create(void)
         /* return (void*)RtCreateMutex(NULL, FALSE, NULL); */
         return (void *)0;
 }
+
+int64 osal_monotonic_time(void)
+{
+   struct timeval tv;
+
+   osal_gettimeofday(&tv, 0);
+   return (int64)tv.tv_sec * 1000000000LL + (int64)tv.tv_usec * 1000;
+}
+
+int osal_sleep_until(int64 monotonic)
+{
+   int64 remain;
+
+   remain = monotonic - osal_monotonic_time();
+   if (remain <= 0)
+   {
+      return 0;
+   }
+   return osal_usleep((uint32)((remain + 999) / 1000));
+}
@@ -30,6 +30,7 @@ extern "C"
 #define OSAL_THREAD_HANDLE pthread_t *
 #define OSAL_THREAD_FUNC void
 #define OSAL_THREAD_FUNC_RT void
+#define OSAL_THREAD_LOCAL __thread
 
 #ifdef __cplusplus
 }
@@ -109,7 +109,8 @@ int osal_thread_create(void *thandle, int stacksize, void *func, void *param)
    pthread_attr_init(&attr);
    pthread_attr_setstacksize(&attr, stacksize);
    ret = pthread_create(threadp, &attr, func, param);
-   if(ret < 0)
+   pthread_attr_destroy(&attr);
+   if(ret != 0)
    {
       return 0;
    }
@@ -128,17 +129,47 @@ int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param)
    pthread_attr_setstacksize(&attr, stacksize);
    ret = pthread_create(threadp, &attr, func, param);
    pthread_attr_destroy(&attr);
-   if(ret < 0)
+   if(ret != 0)
    {
       return 0;
    }
    memset(&schparam, 0, sizeof(schparam));
    schparam.sched_priority = 40;
-   ret = pthread_setschedparam(*threadp, SCHED_FIFO, &schparam);
-   if(ret < 0)
+   /* without the privilege for SCHED_FIFO the thread keeps running at
+    * normal priority, it exists and must still be joined */
+   pthread_setschedparam(*threadp, SCHED_FIFO, &schparam);
+
+   return 1;
+}
+
+int osal_thread_join(void *thandle)
+{
+   if (pthread_join(*(pthread_t *)thandle, NULL) != 0)
    {
       return 0;
    }
-
    return 1;
 }
+
+int64 osal_monotonic_time(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (int64)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int osal_sleep_until(int64 monotonic)
+{
+   struct timespec ts;
+   int64 remain;
+
+   remain = monotonic - osal_monotonic_time();
+   if (remain <= 0)
+   {
+      return 0;
+   }
+   ts.tv_sec = remain / 1000000000LL;
+   ts.tv_nsec = remain % 1000000000LL;
+   return nanosleep(&ts, NULL);
+}
@@ -14,6 +14,43 @@ extern "C"
 #include "osal_defs.h"
 #include <stdint.h>
 
+/* Storage class for per thread static data, ports without support share
+ * the data between threads */
+#ifndef OSAL_THREAD_LOCAL
+#define OSAL_THREAD_LOCAL
+#endif
+
+/* Atomic access to int, uint32 and pointer variables shared between
+ * threads. Loads acquire, stores release, exchange, compare and swap and add
+ * are full barriers. osal_atomic_cas returns TRUE if *p held e and was set to
+ * d. */
+#if defined(_MSC_VER)
+#include <intrin.h>
+/* loads must not write, the data may be mapped read only, volatile reads
+ * acquire with the /volatile:ms default of x86 and x64 */
+#define osal_atomic_load(p)         (*(long const volatile *)(p))
+#define osal_atomic_store(p, v)     ((void)_InterlockedExchange((long volatile *)(p), (long)(v)))
+#define osal_atomic_exchange(p, v)  _InterlockedExchange((long volatile *)(p), (long)(v))
+#define osal_atomic_cas(p, e, d)    (_InterlockedCompareExchange((long volatile *)(p), (long)(d), (long)(e)) == (long)(e))
+#define osal_atomic_add(p, v)       ((void)_InterlockedExchangeAdd((long volatile *)(p), (long)(v)))
+#define osal_atomic_loadptr(p)      (*(void * const volatile *)(p))
+#if defined(_WIN64)
+#define osal_atomic_storeptr(p, v)  ((void)_InterlockedExchangePointer((void * volatile *)(p), (void *)(v)))
+#else
+#define osal_atomic_storeptr(p, v)  ((void)_InterlockedExchange((long volatile *)(p), (long)(v)))
+#endif
+#define osal_atomic_fence()         do { long osal_fence_; _InterlockedExchange(&osal_fence_, 0); } while (0)
+#else
+#define osal_atomic_load(p)         __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define osal_atomic_store(p, v)     __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define osal_atomic_exchange(p, v)  __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#define osal_atomic_cas(p, e, d)    __sync_bool_compare_and_swap((p), (e), (d))
+#define osal_atomic_add(p, v)       ((void)__atomic_add_fetch((p), (v), __ATOMIC_ACQ_REL))
+#define osal_atomic_loadptr(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define osal_atomic_storeptr(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define osal_atomic_fence()         __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
 /* General types */
 #ifndef TRUE
 #define TRUE                1
@@ -49,8 +86,11 @@ boolean osal_timer_is_expired(osal_timert * self);
 int osal_usleep(uint32 usec);
 ec_timet osal_current_time(void);
 void osal_time_diff(ec_timet *start, ec_timet *end, ec_timet *diff);
+int64 osal_monotonic_time(void);
+int osal_sleep_until(int64 monotonic);
 int osal_thread_create(void *thandle, int stacksize, void *func, void *param);
 int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param);
+int osal_thread_join(void *thandle);
 
 #ifdef __cplusplus
 }
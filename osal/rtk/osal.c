@@ -126,8 +126,8 @@ void osal_free(void *ptr)
 
 int osal_thread_create(void *thandle, int stacksize, void *func, void *param)
 {
-   thandle = task_spawn ("worker", func, 6,stacksize, param);
-   if(!thandle)
+   *(OSAL_THREAD_HANDLE *)thandle = task_spawn ("worker", func, 6,stacksize, param);
+   if(!*(OSAL_THREAD_HANDLE *)thandle)
    {
       return 0;
    }
@@ -136,10 +136,38 @@ int osal_thread_create(void *thandle, int stacksize, void *func, void *param)
 
 int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param)
 {
-   thandle = task_spawn ("worker_rt", func, 15 ,stacksize, param);
-   if(!thandle)
+   *(OSAL_THREAD_HANDLE *)thandle = task_spawn ("worker_rt", func, 15 ,stacksize, param);
+   if(!*(OSAL_THREAD_HANDLE *)thandle)
    {
       return 0;
    }
    return 1;
 }
+
+int osal_thread_join(void *thandle)
+{
+   /* rt-kernel has no join, callers wait for a flag the task clears on
+    * exit and the kernel reclaims the task when it returns */
+   (void)thandle;
+   return 1;
+}
+
+int64 osal_monotonic_time(void)
+{
+   struct timeval tv;
+
+   osal_gettimeofday(&tv, 0);
+   return (int64)tv.tv_sec * 1000000000LL + (int64)tv.tv_usec * 1000;
+}
+
+int osal_sleep_until(int64 monotonic)
+{
+   int64 remain;
+
+   remain = monotonic - osal_monotonic_time();
+   if (remain <= 0)
+   {
+      return 0;
+   }
+   return osal_usleep((uint32)((remain + 999) / 1000));
+}
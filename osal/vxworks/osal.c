@@ -185,3 +185,37 @@ int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param)
    return 1;
 }
 
+int osal_thread_join(void *thandle)
+{
+   TASK_ID * tid = (TASK_ID *)thandle;
+
+   /* no join in taskLib, wait for the task id to become invalid */
+   while (taskIdVerify(*tid) == OK)
+   {
+      taskDelay(1);
+   }
+   return 1;
+}
+
+int64 osal_monotonic_time(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (int64)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int osal_sleep_until(int64 monotonic)
+{
+   struct timespec ts;
+   int64 remain;
+
+   remain = monotonic - osal_monotonic_time();
+   if (remain <= 0)
+   {
+      return 0;
+   }
+   ts.tv_sec = remain / 1000000000LL;
+   ts.tv_nsec = remain % 1000000000LL;
+   return nanosleep(&ts, NULL);
+}
@@ -134,7 +134,7 @@ void osal_free(void *ptr)
 int osal_thread_create(void *thandle, int stacksize, void *func, void *param)
 {
    *(OSAL_THREAD_HANDLE*)thandle = CreateThread(NULL, stacksize, func, param, 0, NULL);
-   if(!thandle)
+   if(!*(OSAL_THREAD_HANDLE*)thandle)
    {
       return 0;
    }
@@ -147,7 +147,40 @@ int osal_thread_create_rt(void *thandle, int stacksize, void *func, void *param)
    ret = osal_thread_create(thandle, stacksize, func, param);
    if (ret)
    {
-      ret = SetThreadPriority(thandle, THREAD_PRIORITY_TIME_CRITICAL);
+      /* a failed priority change leaves a running thread behind */
+      SetThreadPriority(*(OSAL_THREAD_HANDLE*)thandle, THREAD_PRIORITY_TIME_CRITICAL);
    }
    return ret;
 }
+
+int osal_thread_join(void *thandle)
+{
+   HANDLE h = *(OSAL_THREAD_HANDLE*)thandle;
+
+   if (WaitForSingleObject(h, INFINITE) != WAIT_OBJECT_0)
+   {
+      return 0;
+   }
+   CloseHandle(h);
+   return 1;
+}
+
+int64 osal_monotonic_time(void)
+{
+   struct timeval tv;
+
+   osal_getrelativetime(&tv, 0);
+   return (int64)tv.tv_sec * 1000000000LL + (int64)tv.tv_usec * 1000;
+}
+
+int osal_sleep_until(int64 monotonic)
+{
+   int64 remain;
+
+   remain = monotonic - osal_monotonic_time();
+   if (remain <= 0)
+   {
+      return 0;
+   }
+   return osal_usleep((uint32)((remain + 999) / 1000));
+}
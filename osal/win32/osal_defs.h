@@ -37,6 +37,7 @@ extern "C"
 #define OSAL_THREAD_HANDLE HANDLE
 #define OSAL_THREAD_FUNC void
 #define OSAL_THREAD_FUNC_RT void
+#define OSAL_THREAD_LOCAL __declspec(thread)
 
 #ifdef __cplusplus
 }
@@ -83,6 +83,10 @@ typedef struct
 	int dev_id;
 
 	// TODO: add mutex support
+   /** asynchronous datagrams, see ecx_startdatagram() */
+   ec_asyncT async[EC_MAXASYNC];
+   /** number of asynchronous datagrams not completed */
+   int asynccount;
 } ecx_portt;
 
 extern const uint16 priMAC[3];
@@ -110,7 +114,13 @@ void ecx_setbufstat(ecx_portt *port, uint8 idx, int bufstat);
 uint8 ecx_getindex(ecx_portt *port);
 int ecx_outframe(ecx_portt *port, uint8 idx, int sock);
 int ecx_outframe_red(ecx_portt *port, uint8 idx);
+int ecx_outframe_red_batch(ecx_portt *port, const uint8 *idx, int n);
 int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout);
+int ecx_waitinframe_batch(ecx_portt *port, const uint8 *idx, int *wkc, int n, int timeout);
+int ecx_waitinframe_scatter(ecx_portt *port, const uint8 *idx, uint8 * const *target,
+   const uint16 *length, int *wkc, boolean *placed, int n, int timeout);
+int ecx_pollinframe(ecx_portt *port, uint8 idx, osal_timert *timer);
+int ecx_getframetime(ecx_portt *port, uint8 idx, int64 *txtime, int64 *rxtime);
 int ecx_srconfirm(ecx_portt *port, uint8 idx,int timeout);
 
 int ecx_inframe(ecx_portt *port, uint8 idx, int stacknumber);
@@ -28,10 +28,90 @@
  * packets. The software layer will detect the possible failure modes and
  * compensate. If needed the packets from interface A are resent through interface B.
  * This layer if fully transparent for the higher layers.
+ * Both sockets are waited on together and the resend is issued as soon as the
+ * returned frames show a broken line, within the timeout of the receive.
+ *
+ * With the ECT_TRANSPORT_MMAP transport the socket gets a memory mapped
+ * PACKET_RX_RING and PACKET_TX_RING. Transmit frames are placed in the tx ring
+ * and the kernel is kicked without waiting, received frames are read directly
+ * from the rx ring. This saves the recv() call for every frame.
+ *
+ * With the ECT_TRANSPORT_XDP transport an XDP program on the NIC redirects
+ * all EtherCAT frames to an AF_XDP socket, other traffic passes to the network
+ * stack. Frames are exchanged through UMEM frames and the rx, tx, fill and
+ * completion rings. The program is attached in native mode if the driver
+ * supports it, otherwise in generic (SKB) mode, which works on any NIC incl.
+ * veth pairs.
+ *
+ * The RAW sockets get a socket filter that drops our own outgoing frames and
+ * malformed frames in the kernel, before they are queued to the socket and
+ * looked at under rx_mutex. The filter counts the dropped frames, see
+ * ecx_getfilterstats(). If eBPF is not available a classic BPF filter without
+ * counters is attached instead.
+ *
+ * The frame buffers are allocated at setup, their number is set per port with
+ * ecx_setmaxbuf() and can be up to EC_MAXSLOTS, as the datagram index allows.
+ *
+ * The rx buffers are pointers into a pool of frames with EC_MAXBATCH spare
+ * frames. The plain socket receives into a spare frame, which is then swapped
+ * with the frame owned by the index of the received datagram, so a frame is
+ * not copied between receive and the caller. Ring frames of the
+ * ECT_TRANSPORT_MMAP transport belong to the kernel and are still copied once.
+ * With ECT_TRANSPORT_XDP the rx buffers are UMEM frames and are swapped the
+ * same way, and the tx buffers of the primary stack are placed in the UMEM and
+ * sent from there.
+ *
+ * Free frame indexes are kept in a bitmap that ecx_getindex() and
+ * ecx_setbufstat() update with atomic operations, so threads allocating
+ * indexes (cyclic and mailbox) do not contend on a mutex.
+ *
+ * Optionally ecx_startreceiver() starts one receiver thread per socket. The
+ * receiver is then the only reader of the socket, it stores every frame in
+ * the rx buffer of its index and wakes the threads waiting for that index
+ * with a futex. Waiting threads no longer read the socket or take rx_mutex,
+ * so a mailbox thread cannot hold up the process data thread.
+ *
+ * How a receiving thread waits for its frame is selected per port with
+ * ecx_setwaitmode(). ECT_WAIT_TIMEOUT spins on receive calls that time out
+ * after 1us. ECT_WAIT_BUSYPOLL spins on non blocking receive calls and lets
+ * the kernel busy poll the NIC queue (SO_BUSY_POLL), lowest latency at the
+ * cost of a full core. ECT_WAIT_BLOCK sleeps in ppoll() until a frame
+ * arrives or the deadline of the wait expires, the thread only wakes up when
+ * there is work to do.
+ *
+ * The transports are NIC backends, tables of setup, close, send, receive and
+ * release functions on each stack. The port logic above, frame buffers,
+ * indexes, waiting, receiver threads and redundancy, is the same for all of
+ * them. Besides the backends selected with ecx_setupnic_transport() an
+ * application can pass its own to ecx_setupnic_backend(). The loopback
+ * backend (ECT_TRANSPORT_LOOPBACK) needs no NIC, every frame sent is received
+ * unchanged, which measures the overhead of the master stack alone.
+ *
+ * With ecx_settimestamping() the primary plain socket records a software or
+ * hardware timestamp of every frame leaving and entering the NIC. Receive
+ * stamps come with the frame, transmit stamps are collected from the socket
+ * error queue. ecx_getframetime() returns both per frame index, their
+ * difference is the time the frame spent on the wire and in the slaves,
+ * without the scheduling delays of the master.
+ *
+ * ecx_startcapture() records every frame sent and received by the port in a
+ * pcapng file, with a nanosecond timestamp and its direction. The file is
+ * preallocated and memory mapped, the frames are copied into it as a ring
+ * that overwrites the oldest frames when full. Writing a frame takes no
+ * system call and does not wait for another writing thread longer than a few
+ * spins. ecx_stopcapture() puts the ring in order and truncates the file to
+ * a plain pcapng file. The replay backend (ECT_TRANSPORT_REPLAY) takes such a
+ * capture instead of a NIC. Every frame sent gets the answer recorded for the
+ * frame sent at the same position, after the recorded round trip time, so a
+ * run of the master can be reproduced without the segment.
  */
 
+#define _GNU_SOURCE
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <poll.h>
 #include <net/if.h>
 #include <sys/socket.h>
 #include <unistd.h>
@@ -39,9 +119,23 @@
 #include <time.h>
 #include <arpa/inet.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
 #include <string.h>
-#include <netpacket/packet.h>
+#include <linux/if_packet.h>
+#include <linux/if_xdp.h>
+#include <linux/if_link.h>
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <linux/futex.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+#include <linux/sockios.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
 #include <pthread.h>
 
 #include "oshw.h"
@@ -56,6 +150,10 @@ enum
    ECT_RED_DOUBLE
 };
 
+/** Lines of a redundant port, bits of ecx_portt redlost */
+#define EC_REDLINE_PRIMARY    0x01
+#define EC_REDLINE_SECONDARY  0x02
+
 
 /** Primary source MAC address used for EtherCAT.
  * This address is not the MAC address used from the NIC.
@@ -72,490 +170,3815 @@ const uint16 secMAC[3] = { 0x0404, 0x0404, 0x0404 };
 /** second MAC word is used for identification */
 #define RX_SEC secMAC[1]
 
-static void ecx_clear_rxbufstat(int *rxbufstat)
+/** size of one PACKET_MMAP ring frame, holds tpacket2_hdr and a full frame */
+#define EC_RINGFRAMESIZE   2048
+/** minimum number of frames in rx ring */
+#define EC_RXRINGFRAMES    64
+/** minimum number of frames in tx ring */
+#define EC_TXRINGFRAMES    32
+
+/** size of one AF_XDP UMEM frame */
+#define EC_XSKFRAMESIZE    2048
+/** number of AF_XDP rx UMEM frames, also size of rx and fill ring */
+#define EC_XSKRXFRAMES     64
+/** number of AF_XDP tx UMEM frames, also size of tx and completion ring */
+#define EC_XSKTXFRAMES     32
+/** rx queue of NIC bound to the AF_XDP socket */
+#define EC_XSKQUEUE        0
+/** max. number of 1ms retries to bind AF_XDP socket to a busy queue */
+#define EC_XSKBINDRETRY    100
+
+/** shortest frame passed by the socket filter, one datagram without data */
+#define EC_MINFRAMESIZE    (ETH_HEADERSIZE + EC_HEADERSIZE + EC_WKCSIZE)
+
+/** stack size of receiver thread */
+#define EC_RECEIVERSTACK   (128 * 1024)
+/** max. time in us a receiver thread sleeps before it looks for a stop */
+#define EC_RECEIVERPOLL    10000
+
+/** SO_BUSY_POLL time in us used with ECT_WAIT_BUSYPOLL */
+#define EC_BUSYPOLLTIME    50
+/** max. sleep in us of one ppoll() call with ECT_WAIT_BLOCK, bounds the delay
+ * when another thread reads our frame from the socket */
+#define EC_WAITSLICE       500
+
+/** control buffer size of a message with timestamps */
+#define EC_TSTAMPCTRL      256
+
+/** number of frames the loopback backend can hold, all indexes in flight */
+#define EC_LOOPFRAMES      EC_MAXSLOTS
+
+/** pcapng block types */
+#define EC_PCAPNG_SHB      0x0A0D0D0A
+#define EC_PCAPNG_IDB      0x00000001
+#define EC_PCAPNG_EPB      0x00000006
+/** pcapng byte order magic */
+#define EC_PCAPNG_MAGIC    0x1A2B3C4D
+/** pcapng option codes */
+#define EC_PCAPNG_ENDOFOPT 0
+#define EC_PCAPNG_TSRESOL  9
+#define EC_PCAPNG_FLAGS    2
+/** direction in epb_flags option of a frame */
+#define EC_PCAPNG_INBOUND  1
+#define EC_PCAPNG_OUTBOUND 2
+/** length of section header block */
+#define EC_PCAPNG_SHBLEN   28
+/** length of interface description block with if_tsresol option */
+#define EC_PCAPNG_IDBLEN   32
+/** length of enhanced packet block with epb_flags option, without frame */
+#define EC_PCAPNG_EPBLEN   44
+/** capture interfaces, one per stack */
+#define EC_PCAPNG_IFACES   2
+/** max. number of spins on the capture ring lock before a frame is dropped */
+#define EC_CAPTURESPIN     1000
+
+/** number of frames the replay backend can have in flight */
+#define EC_REPLAYFRAMES    EC_MAXSLOTS
+
+/** frame queue of the loopback backend */
+typedef struct
+{
+   pthread_mutex_t mutex;
+   /** position of oldest frame */
+   int         head;
+   /** number of queued frames */
+   int         count;
+   /** frame lengths */
+   int         length[EC_LOOPFRAMES];
+   /** frames incl. ethernet header */
+   ec_bufT     frame[EC_LOOPFRAMES];
+} ec_loopT;
+
+/** recorded answer to a frame sent */
+typedef struct
+{
+   /** received frame incl. ethernet header in the capture, NULL if lost */
+   const uint8 *frame;
+   /** length of received frame */
+   int         length;
+   /** time from transmit to receive in ns */
+   int64       delay;
+} ec_replayframeT;
+
+/** capture and answer queue of the replay backend */
+typedef struct
+{
+   pthread_mutex_t mutex;
+   /** mapped capture file */
+   uint8       *map;
+   /** length of mapped file */
+   size_t      maplen;
+   /** answers to the frames sent on the primary interface, in order */
+   ec_replayframeT *answer;
+   /** number of answers */
+   int         answers;
+   /** answer to the next frame sent */
+   int         next;
+   /** position of oldest queued answer */
+   int         head;
+   /** number of queued answers */
+   int         count;
+   /** queued answers */
+   const ec_replayframeT *queue[EC_REPLAYFRAMES];
+   /** index of the frame sent of queued answers */
+   uint8       index[EC_REPLAYFRAMES];
+   /** CLOCK_MONOTONIC time in ns from which queued answers are received */
+   int64       due[EC_REPLAYFRAMES];
+} ec_replayT;
+
+static void ecx_clear_rxbufstat(int *rxbufstat, int maxbuf)
 {
    int i;
-   for(i = 0; i < EC_MAXBUF; i++)
+   for(i = 0; i < maxbuf; i++)
    {
       rxbufstat[i] = EC_BUF_EMPTY;
    }
 }
 
-/** Basic setup to connect NIC to socket.
- * @param[in] port        = port context struct
- * @param[in] ifname      = Name of NIC device, f.e. "eth0"
- * @param[in] secondary   = if >0 then use secondary stack instead of primary
+/** Allocate rx buffers of a port. The pool holds one frame per index plus
+ * EC_MAXBATCH spare frames. Every index points at the EtherCAT part of the
+ * frame it owns, ownership moves by pointer swap when a frame is received.
+ * @param[out] rxpool     = rx frame pool
+ * @param[out] rxbuf      = rx buffers
+ * @param[out] rxspare    = spare frames, EC_MAXBATCH entries
+ * @param[out] rxbufstat  = rx buffer status
+ * @param[out] rxsa       = rx MAC source address
+ * @param[in] maxbuf      = number of buffers
  * @return >0 if succeeded
  */
-int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
+static int ecx_allocrxbufs(ec_bufT **rxpool, uint8 ***rxbuf, uint8 **rxspare,
+                           int **rxbufstat, int **rxsa, int maxbuf)
 {
    int i;
-   int r, rval, ifindex;
-   struct timeval timeout;
-   struct ifreq ifr;
-   struct sockaddr_ll sll;
-   int *psock;
-   pthread_mutexattr_t mutexattr;
 
-   rval = 0;
-   if (secondary)
+   *rxpool = malloc(sizeof(ec_bufT) * (maxbuf + EC_MAXBATCH));
+   *rxbuf = malloc(sizeof(uint8 *) * maxbuf);
+   *rxbufstat = malloc(sizeof(int) * maxbuf);
+   *rxsa = malloc(sizeof(int) * maxbuf);
+   if (!*rxpool || !*rxbuf || !*rxbufstat || !*rxsa)
    {
-      /* secondary port struct available? */
-      if (port->redport)
-      {
-         /* when using secondary socket it is automatically a redundant setup */
-         psock = &(port->redport->sockhandle);
-         *psock = -1;
-         port->redstate                   = ECT_RED_DOUBLE;
-         port->redport->stack.sock        = &(port->redport->sockhandle);
-         port->redport->stack.txbuf       = &(port->txbuf);
-         port->redport->stack.txbuflength = &(port->txbuflength);
-         port->redport->stack.tempbuf     = &(port->redport->tempinbuf);
-         port->redport->stack.rxbuf       = &(port->redport->rxbuf);
-         port->redport->stack.rxbufstat   = &(port->redport->rxbufstat);
-         port->redport->stack.rxsa        = &(port->redport->rxsa);
-         ecx_clear_rxbufstat(&(port->redport->rxbufstat[0]));
-      }
-      else
-      {
-         /* fail */
-         return 0;
-      }
+      return 0;
    }
-   else
+   for (i = 0; i < maxbuf; i++)
    {
-      pthread_mutexattr_init(&mutexattr);
-      pthread_mutexattr_setprotocol(&mutexattr  , PTHREAD_PRIO_INHERIT);
-      pthread_mutex_init(&(port->getindex_mutex), &mutexattr);
-      pthread_mutex_init(&(port->tx_mutex)      , &mutexattr);
-      pthread_mutex_init(&(port->rx_mutex)      , &mutexattr);
-      port->sockhandle        = -1;
-      port->lastidx           = 0;
-      port->redstate          = ECT_RED_NONE;
-      port->stack.sock        = &(port->sockhandle);
-      port->stack.txbuf       = &(port->txbuf);
-      port->stack.txbuflength = &(port->txbuflength);
-      port->stack.tempbuf     = &(port->tempinbuf);
-      port->stack.rxbuf       = &(port->rxbuf);
-      port->stack.rxbufstat   = &(port->rxbufstat);
-      port->stack.rxsa        = &(port->rxsa);
-      ecx_clear_rxbufstat(&(port->rxbufstat[0]));
-      psock = &(port->sockhandle);
+      (*rxbuf)[i] = &((*rxpool)[i][ETH_HEADERSIZE]);
    }
-   /* we use RAW packet socket, with packet type ETH_P_ECAT */
-   *psock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ECAT));
-
-   timeout.tv_sec =  0;
-   timeout.tv_usec = 1;
-   r = setsockopt(*psock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-   r = setsockopt(*psock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
-   i = 1;
-   r = setsockopt(*psock, SOL_SOCKET, SO_DONTROUTE, &i, sizeof(i));
-   /* connect socket to NIC by name */
-   strcpy(ifr.ifr_name, ifname);
-   r = ioctl(*psock, SIOCGIFINDEX, &ifr);
-   ifindex = ifr.ifr_ifindex;
-   strcpy(ifr.ifr_name, ifname);
-   ifr.ifr_flags = 0;
-   /* reset flags of NIC interface */
-   r = ioctl(*psock, SIOCGIFFLAGS, &ifr);
-   /* set flags of NIC interface, here promiscuous and broadcast */
-   ifr.ifr_flags = ifr.ifr_flags | IFF_PROMISC | IFF_BROADCAST;
-   r = ioctl(*psock, SIOCSIFFLAGS, &ifr);
-   /* bind socket to protocol, in this case RAW EtherCAT */
-   sll.sll_family = AF_PACKET;
-   sll.sll_ifindex = ifindex;
-   sll.sll_protocol = htons(ETH_P_ECAT);
-   r = bind(*psock, (struct sockaddr *)&sll, sizeof(sll));
-   /* setup ethernet headers in tx buffers so we don't have to repeat it */
-   for (i = 0; i < EC_MAXBUF; i++)
+   for (i = 0; i < EC_MAXBATCH; i++)
    {
-      ec_setupheader(&(port->txbuf[i]));
-      port->rxbufstat[i] = EC_BUF_EMPTY;
+      rxspare[i] = (*rxpool)[maxbuf + i];
    }
-   ec_setupheader(&(port->txbuf2));
-   if (r == 0) rval = 1;
-
-   return rval;
-}
-
-/** Close sockets used
- * @param[in] port        = port context struct
- * @return 0
- */
-int ecx_closenic(ecx_portt *port)
-{
-   if (port->sockhandle >= 0)
-      close(port->sockhandle);
-   if ((port->redport) && (port->redport->sockhandle >= 0))
-      close(port->redport->sockhandle);
+   memset(*rxsa, 0, sizeof(int) * maxbuf);
 
-   return 0;
+   return 1;
 }
 
-/** Fill buffer with ethernet header structure.
- * Destination MAC is always broadcast.
- * Ethertype is always ETH_P_ECAT.
- * @param[out] p = buffer
+/** Free rx buffers of a port.
+ * @param[in,out] rxpool     = rx frame pool
+ * @param[in,out] rxbuf      = rx buffers
+ * @param[in,out] rxbufstat  = rx buffer status
+ * @param[in,out] rxsa       = rx MAC source address
  */
-void ec_setupheader(void *p)
+static void ecx_freerxbufs(ec_bufT **rxpool, uint8 ***rxbuf, int **rxbufstat, int **rxsa)
 {
-   ec_etherheadert *bp;
-   bp = p;
-   bp->da0 = htons(0xffff);
-   bp->da1 = htons(0xffff);
-   bp->da2 = htons(0xffff);
-   bp->sa0 = htons(priMAC[0]);
-   bp->sa1 = htons(priMAC[1]);
-   bp->sa2 = htons(priMAC[2]);
-   bp->etype = htons(ETH_P_ECAT);
+   free(*rxpool);
+   free(*rxbuf);
+   free(*rxbufstat);
+   free(*rxsa);
+   *rxpool = NULL;
+   *rxbuf = NULL;
+   *rxbufstat = NULL;
+   *rxsa = NULL;
 }
 
-/** Get new frame identifier index and allocate corresponding rx buffer.
- * @param[in] port        = port context struct
- * @return new index.
+/** Setup memory mapped rx and tx ring on socket. TPACKET_V2 is used as
+ * it hands every frame to user space on arrival, TPACKET_V3 only releases
+ * complete blocks which adds up to the block timeout to each frame.
+ * Must be called before the socket is bound.
+ * @param[in] sock        = socket handle
+ * @param[out] ring       = ring struct
+ * @return >0 if succeeded
  */
-uint8 ecx_getindex(ecx_portt *port)
+static int ecx_setupring(int sock, ec_ringT *ring)
 {
-   uint8 idx;
-   uint8 cnt;
-
-   pthread_mutex_lock( &(port->getindex_mutex) );
+   struct tpacket_req req;
+   pthread_mutexattr_t mutexattr;
+   int version, loss, blocksize, framesperblock;
+   void *map;
 
-   idx = port->lastidx + 1;
-   /* index can't be larger than buffer array */
-   if (idx >= EC_MAXBUF)
+   version = TPACKET_V2;
+   if (setsockopt(sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
    {
-      idx = 0;
+      return 0;
    }
-   cnt = 0;
-   /* try to find unused index */
-   while ((port->rxbufstat[idx] != EC_BUF_EMPTY) && (cnt < EC_MAXBUF))
+   /* a malformed tx frame is dropped and its slot freed by the kernel, without
+    * it the kernel halts the tx ring at that slot */
+   loss = 1;
+   setsockopt(sock, SOL_PACKET, PACKET_LOSS, &loss, sizeof(loss));
+   /* blocks must be a multiple of the page size, round rings up to whole blocks */
+   blocksize = getpagesize();
+   framesperblock = blocksize / EC_RINGFRAMESIZE;
+   ring->rxframes = ((EC_RXRINGFRAMES + framesperblock - 1) / framesperblock) * framesperblock;
+   ring->txframes = ((EC_TXRINGFRAMES + framesperblock - 1) / framesperblock) * framesperblock;
+   memset(&req, 0, sizeof(req));
+   req.tp_block_size = blocksize;
+   req.tp_frame_size = EC_RINGFRAMESIZE;
+   req.tp_block_nr = ring->rxframes / framesperblock;
+   req.tp_frame_nr = ring->rxframes;
+   if (setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0)
    {
-      idx++;
-      cnt++;
-      if (idx >= EC_MAXBUF)
-      {
-         idx = 0;
-      }
+      return 0;
    }
-   port->rxbufstat[idx] = EC_BUF_ALLOC;
-   if (port->redstate != ECT_RED_NONE)
-      port->redport->rxbufstat[idx] = EC_BUF_ALLOC;
-   port->lastidx = idx;
-
-   pthread_mutex_unlock( &(port->getindex_mutex) );
+   req.tp_block_nr = ring->txframes / framesperblock;
+   req.tp_frame_nr = ring->txframes;
+   if (setsockopt(sock, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0)
+   {
+      return 0;
+   }
+   /* both rings share one mapping, rx ring first */
+   ring->maplen = (size_t)(ring->rxframes + ring->txframes) * EC_RINGFRAMESIZE;
+   map = mmap(NULL, ring->maplen, PROT_READ | PROT_WRITE, MAP_SHARED, sock, 0);
+   if (map == MAP_FAILED)
+   {
+      ring->map = NULL;
+      return 0;
+   }
+   ring->map = map;
+   ring->rxring = ring->map;
+   ring->txring = ring->map + (size_t)ring->rxframes * EC_RINGFRAMESIZE;
+   ring->rxhead = 0;
+   ring->txhead = 0;
+   pthread_mutexattr_init(&mutexattr);
+   pthread_mutexattr_setprotocol(&mutexattr, PTHREAD_PRIO_INHERIT);
+   pthread_mutex_init(&(ring->tx_mutex), &mutexattr);
 
-   return idx;
+   return 1;
 }
 
-/** Set rx buffer status.
- * @param[in] port        = port context struct
- * @param[in] idx      = index in buffer array
- * @param[in] bufstat  = status to set
+/** Release memory mapped ring of socket.
+ * @param[in] ring        = ring struct
  */
-void ecx_setbufstat(ecx_portt *port, uint8 idx, int bufstat)
+static void ecx_closering(ec_ringT *ring)
 {
-   port->rxbufstat[idx] = bufstat;
-   if (port->redstate != ECT_RED_NONE)
-      port->redport->rxbufstat[idx] = bufstat;
+   if (ring->map)
+   {
+      munmap(ring->map, ring->maplen);
+      ring->map = NULL;
+      pthread_mutex_destroy(&(ring->tx_mutex));
+   }
 }
 
-/** Transmit buffer over socket (non blocking).
- * @param[in] port        = port context struct
- * @param[in] idx         = index in tx buffer array
- * @param[in] stacknumber  = 0=Primary 1=Secondary stack
- * @return socket send result
+/** Issue bpf() system call.
+ * @param[in] cmd         = bpf command
+ * @param[in] attr        = command attributes
+ * @return fd or 0 if succeeded, <0 on error
  */
-int ecx_outframe(ecx_portt *port, uint8 idx, int stacknumber)
+static int ecx_bpf(int cmd, union bpf_attr *attr)
 {
-   int lp, rval;
-   ec_stackT *stack;
+   return (int)syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
 
-   if (!stacknumber)
-   {
-      stack = &(port->stack);
-   }
-   else
+/** Load XDP program that redirects EtherCAT frames to the socket in the
+ * XSKMAP entry of the receiving queue and passes all other frames.
+ * @param[in] mapfd       = XSKMAP
+ * @return program fd, <0 on error
+ */
+static int ecx_loadxdpprog(int mapfd)
+{
+   struct bpf_insn prog[] =
    {
-      stack = &(port->redport->stack);
-   }
-   lp = (*stack->txbuflength)[idx];
-   (*stack->rxbufstat)[idx] = EC_BUF_TX;
-   rval = send(*stack->sock, (*stack->txbuf)[idx], lp, 0);
-   if (rval == -1)
+      /* r6 = ctx, r2 = data, r3 = data_end */
+      { BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0 },
+      { BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(struct xdp_md, data), 0 },
+      { BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_6, offsetof(struct xdp_md, data_end), 0 },
+      /* pass if shorter than ethernet header */
+      { BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0 },
+      { BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, ETH_HEADERSIZE },
+      { BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, 8, 0 },
+      /* pass if not EtherCAT, compare in network order as loaded */
+      { BPF_LDX | BPF_MEM | BPF_H, BPF_REG_4, BPF_REG_2, 12, 0 },
+      { BPF_JMP | BPF_JNE | BPF_K, BPF_REG_4, 0, 6, htons(ETH_P_ECAT) },
+      /* return bpf_redirect_map(map, ctx->rx_queue_index, XDP_PASS) */
+      { BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, mapfd },
+      { 0, 0, 0, 0, 0 },
+      { BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(struct xdp_md, rx_queue_index), 0 },
+      { BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS },
+      { BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map },
+      { BPF_JMP | BPF_EXIT, 0, 0, 0, 0 },
+      /* return XDP_PASS */
+      { BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS },
+      { BPF_JMP | BPF_EXIT, 0, 0, 0, 0 },
+   };
+   static const char license[] = "GPL";
+   union bpf_attr attr;
+
+   memset(&attr, 0, sizeof(attr));
+   attr.prog_type = BPF_PROG_TYPE_XDP;
+   attr.expected_attach_type = BPF_XDP;
+   attr.insns = (uint64)(uintptr_t)prog;
+   attr.insn_cnt = sizeof(prog) / sizeof(prog[0]);
+   attr.license = (uint64)(uintptr_t)license;
+
+   return ecx_bpf(BPF_PROG_LOAD, &attr);
+}
+
+/** Load socket filter program that passes well formed EtherCAT frames and
+ * drops our own outgoing frames and malformed frames. Dropped frames are
+ * counted in the array map per ECT_FILTER_* reason.
+ * @param[in] mapfd       = array map with ECT_FILTER_COUNTERS uint64 entries
+ * @return program fd, <0 on error
+ */
+static int ecx_loadfilterprog(int mapfd)
+{
+   struct bpf_insn prog[] =
    {
-      (*stack->rxbufstat)[idx] = EC_BUF_EMPTY;
-   }
+      /* r6 = ctx for packet loads, r7 = frame length */
+      { BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0 },
+      { BPF_LDX | BPF_MEM | BPF_W, BPF_REG_7, BPF_REG_6, offsetof(struct __sk_buff, len), 0 },
+      /* own frame if looped back by the kernel */
+      { BPF_LDX | BPF_MEM | BPF_W, BPF_REG_0, BPF_REG_6, offsetof(struct __sk_buff, pkt_type), 0 },
+      { BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_8, 0, 0, ECT_FILTER_OWN },
+      { BPF_JMP | BPF_JEQ | BPF_K, BPF_REG_0, 0, 17, PACKET_OUTGOING },
+      /* malformed if too short, not EtherCAT or not of type EtherCAT commands */
+      { BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_8, 0, 0, ECT_FILTER_MALFORMED },
+      { BPF_JMP | BPF_JLT | BPF_K, BPF_REG_7, 0, 15, EC_MINFRAMESIZE },
+      { BPF_LD | BPF_ABS | BPF_H, 0, 0, 0, 12 },
+      { BPF_JMP | BPF_JNE | BPF_K, BPF_REG_0, 0, 13, ETH_P_ECAT },
+      { BPF_LD | BPF_ABS | BPF_B, 0, 0, 0, ETH_HEADERSIZE + 1 },
+      { BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_9, BPF_REG_0, 0, 0 },
+      { BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_9, 0, 0, 0xf0 },
+      { BPF_JMP | BPF_JNE | BPF_K, BPF_REG_9, 0, 9, 0x10 },
+      /* malformed if EtherCAT length exceeds frame */
+      { BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_0, 0, 0, 0x07 },
+      { BPF_ALU64 | BPF_LSH | BPF_K, BPF_REG_0, 0, 0, 8 },
+      { BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_9, BPF_REG_0, 0, 0 },
+      { BPF_LD | BPF_ABS | BPF_B, 0, 0, 0, ETH_HEADERSIZE },
+      { BPF_ALU64 | BPF_OR | BPF_X, BPF_REG_0, BPF_REG_9, 0, 0 },
+      { BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_0, 0, 0, ETH_HEADERSIZE + EC_ELENGTHSIZE },
+      { BPF_JMP | BPF_JGT | BPF_X, BPF_REG_0, BPF_REG_7, 2, 0 },
+      /* pass complete frame */
+      { BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_0, BPF_REG_7, 0, 0 },
+      { BPF_JMP | BPF_EXIT, 0, 0, 0, 0 },
+      /* drop, count in map entry r8 */
+      { BPF_STX | BPF_MEM | BPF_W, BPF_REG_10, BPF_REG_8, -4, 0 },
+      { BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, mapfd },
+      { 0, 0, 0, 0, 0 },
+      { BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_2, BPF_REG_10, 0, 0 },
+      { BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_2, 0, 0, -4 },
+      { BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_map_lookup_elem },
+      { BPF_JMP | BPF_JEQ | BPF_K, BPF_REG_0, 0, 2, 0 },
+      { BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_1, 0, 0, 1 },
+      { BPF_STX | BPF_ATOMIC | BPF_DW, BPF_REG_0, BPF_REG_1, 0, BPF_ADD },
+      { BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, 0 },
+      { BPF_JMP | BPF_EXIT, 0, 0, 0, 0 },
+   };
+   static const char license[] = "GPL";
+   union bpf_attr attr;
 
-   return rval;
+   memset(&attr, 0, sizeof(attr));
+   attr.prog_type = BPF_PROG_TYPE_SOCKET_FILTER;
+   attr.insns = (uint64)(uintptr_t)prog;
+   attr.insn_cnt = sizeof(prog) / sizeof(prog[0]);
+   attr.license = (uint64)(uintptr_t)license;
+
+   return ecx_bpf(BPF_PROG_LOAD, &attr);
 }
 
-/** Transmit buffer over socket (non blocking).
- * @param[in] port        = port context struct
- * @param[in] idx = index in tx buffer array
- * @return socket send result
+/** Attach socket filter to RAW socket. Tries the counting eBPF filter first,
+ * falls back to the same checks as classic BPF without counters.
+ * @param[in] sock        = socket handle
+ * @return drop counter map fd, -1 if the classic filter or no filter is used
  */
-int ecx_outframe_red(ecx_portt *port, uint8 idx)
+static int ecx_attachfilter(int sock)
 {
-   ec_comt *datagramP;
-   ec_etherheadert *ehp;
-   int rval;
+   struct sock_filter code[] =
+   {
+      /* drop own outgoing frames */
+      BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PACKET_OUTGOING, 18, 0),
+      /* drop malformed frames */
+      BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+      BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, EC_MINFRAMESIZE, 0, 16),
+      BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_ECAT, 0, 14),
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, ETH_HEADERSIZE + 1),
+      BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0xf0),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x10, 0, 11),
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, ETH_HEADERSIZE + 1),
+      BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0x07),
+      BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 8),
+      BPF_STMT(BPF_MISC | BPF_TAX, 0),
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, ETH_HEADERSIZE),
+      BPF_STMT(BPF_ALU | BPF_OR | BPF_X, 0),
+      BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, ETH_HEADERSIZE + EC_ELENGTHSIZE),
+      BPF_STMT(BPF_MISC | BPF_TAX, 0),
+      BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+      BPF_JUMP(BPF_JMP | BPF_JGE | BPF_X, 0, 0, 1),
+      /* pass complete frame */
+      BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+      BPF_STMT(BPF_RET | BPF_K, 0),
+   };
+   struct sock_fprog fprog;
+   union bpf_attr attr;
+   int mapfd, progfd;
 
-   ehp = (ec_etherheadert *)&(port->txbuf[idx]);
-   /* rewrite MAC source address 1 to primary */
-   ehp->sa1 = htons(priMAC[1]);
-   /* transmit over primary socket*/
-   rval = ecx_outframe(port, idx, 0);
-   if (port->redstate != ECT_RED_NONE)
+   memset(&attr, 0, sizeof(attr));
+   attr.map_type = BPF_MAP_TYPE_ARRAY;
+   attr.key_size = sizeof(uint32);
+   attr.value_size = sizeof(uint64);
+   attr.max_entries = ECT_FILTER_COUNTERS;
+   mapfd = ecx_bpf(BPF_MAP_CREATE, &attr);
+   if (mapfd >= 0)
    {
-      pthread_mutex_lock( &(port->tx_mutex) );
-      ehp = (ec_etherheadert *)&(port->txbuf2);
-      /* use dummy frame for secondary socket transmit (BRD) */
-      datagramP = (ec_comt*)&(port->txbuf2[ETH_HEADERSIZE]);
-      /* write index to frame */
-      datagramP->index = idx;
-      /* rewrite MAC source address 1 to secondary */
-      ehp->sa1 = htons(secMAC[1]);
-      /* transmit over secondary socket */
-      port->redport->rxbufstat[idx] = EC_BUF_TX;
-      if (send(port->redport->sockhandle, &(port->txbuf2), port->txbuflength2 , 0) == -1)
+      progfd = ecx_loadfilterprog(mapfd);
+      if (progfd >= 0)
       {
-         port->redport->rxbufstat[idx] = EC_BUF_EMPTY;
+         /* the socket holds a reference to the program */
+         if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_BPF, &progfd, sizeof(progfd)) == 0)
+         {
+            close(progfd);
+            return mapfd;
+         }
+         close(progfd);
       }
-      pthread_mutex_unlock( &(port->tx_mutex) );
+      close(mapfd);
    }
+   fprog.len = sizeof(code) / sizeof(code[0]);
+   fprog.filter = code;
+   setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
 
-   return rval;
+   return -1;
 }
 
-/** Non blocking read of socket. Put frame in temporary buffer.
- * @param[in] port        = port context struct
- * @param[in] stacknumber = 0=primary 1=secondary stack
- * @return >0 if frame is available and read
+/** Map one AF_XDP ring of the socket.
+ * @param[in] fd          = AF_XDP socket
+ * @param[out] xring      = ring struct
+ * @param[in] off         = ring offsets reported by the kernel
+ * @param[in] pgoff       = mmap offset of ring
+ * @param[in] entries     = number of ring entries
+ * @param[in] entrysize   = size of one entry
+ * @return >0 if succeeded
  */
-static int ecx_recvpkt(ecx_portt *port, int stacknumber)
+static int ecx_mapxskring(int fd, ec_xskringT *xring, const struct xdp_ring_offset *off,
+                          off_t pgoff, uint32 entries, size_t entrysize)
 {
-   int lp, bytesrx;
-   ec_stackT *stack;
+   uint8 *map;
 
-   if (!stacknumber)
-   {
-      stack = &(port->stack);
-   }
-   else
+   xring->maplen = off->desc + entries * entrysize;
+   map = mmap(NULL, xring->maplen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, pgoff);
+   if (map == MAP_FAILED)
    {
-      stack = &(port->redport->stack);
+      xring->map = NULL;
+      return 0;
    }
-   lp = sizeof(port->tempinbuf);
-   bytesrx = recv(*stack->sock, (*stack->tempbuf), lp, 0);
-   port->tempinbufs = bytesrx;
+   xring->map = map;
+   xring->producer = (uint32 *)(map + off->producer);
+   xring->consumer = (uint32 *)(map + off->consumer);
+   xring->desc = map + off->desc;
+   xring->mask = entries - 1;
 
-   return (bytesrx > 0);
+   return 1;
 }
 
-/** Non blocking receive frame function. Uses RX buffer and index to combine
- * read frame with transmitted frame. To compensate for received frames that
- * are out-of-order all frames are stored in their respective indexed buffer.
- * If a frame was placed in the buffer previously, the function retrieves it
- * from that buffer index without calling ec_recvpkt. If the requested index
- * is not already in the buffer it calls ec_recvpkt to fetch it. There are
- * three options now, 1 no frame read, so exit. 2 frame read but other
- * than requested index, store in buffer and exit. 3 frame read with matching
- * index, store in buffer, set completed flag in buffer status and exit.
- *
- * @param[in] port        = port context struct
- * @param[in] idx         = requested index of frame
- * @param[in] stacknumber = 0=primary 1=secondary stack
- * @return Workcounter if a frame is found with corresponding index, otherwise
- * EC_NOFRAME or EC_OTHERFRAME.
+/** Clear AF_XDP socket struct, nothing allocated.
+ * @param[out] xsk        = AF_XDP socket struct
  */
-int ecx_inframe(ecx_portt *port, uint8 idx, int stacknumber)
+static void ecx_clearxsk(ec_xskT *xsk)
 {
-   uint16  l;
-   int     rval;
-   uint8   idxf;
-   ec_etherheadert *ehp;
-   ec_comt *ecp;
-   ec_stackT *stack;
-   ec_bufT *rxbuf;
+   memset(xsk, 0, sizeof(*xsk));
+   xsk->fd = xsk->mapfd = xsk->progfd = xsk->linkfd = -1;
+}
 
-   if (!stacknumber)
+/** Release AF_XDP socket and everything attached to it.
+ * @param[in] xsk         = AF_XDP socket struct
+ */
+static void ecx_closexsk(ec_xskT *xsk)
+{
+   ec_xskringT *xring[4];
+   int i;
+
+   xring[0] = &(xsk->rx);
+   xring[1] = &(xsk->tx);
+   xring[2] = &(xsk->fill);
+   xring[3] = &(xsk->comp);
+   /* closing the link detaches the program from the NIC */
+   if (xsk->linkfd >= 0)
+      close(xsk->linkfd);
+   if (xsk->progfd >= 0)
+      close(xsk->progfd);
+   if (xsk->mapfd >= 0)
+      close(xsk->mapfd);
+   for (i = 0; i < 4; i++)
    {
-      stack = &(port->stack);
+      if (xring[i]->map)
+      {
+         munmap(xring[i]->map, xring[i]->maplen);
+         xring[i]->map = NULL;
+      }
    }
-   else
+   if (xsk->fd >= 0)
    {
-      stack = &(port->redport->stack);
+      close(xsk->fd);
+      pthread_mutex_destroy(&(xsk->tx_mutex));
    }
-   rval = EC_NOFRAME;
-   rxbuf = &(*stack->rxbuf)[idx];
-   /* check if requested index is already in buffer ? */
-   if ((idx < EC_MAXBUF) && ((*stack->rxbufstat)[idx] == EC_BUF_RCVD))
+   if (xsk->umem)
    {
-      l = (*rxbuf)[0] + ((uint16)((*rxbuf)[1] & 0x0f) << 8);
-      /* return WKC */
-      rval = ((*rxbuf)[l] + ((uint16)(*rxbuf)[l + 1] << 8));
-      /* mark as completed */
-      (*stack->rxbufstat)[idx] = EC_BUF_COMPLETE;
+      munmap(xsk->umem, xsk->umemlen);
    }
-   else
+   ecx_clearxsk(xsk);
+}
+
+/** Setup AF_XDP socket with UMEM on queue EC_XSKQUEUE of NIC and attach the
+ * redirecting XDP program, native mode first and generic mode as fallback.
+ * The UMEM holds one rx frame per index, the rx frames of the fill ring, the
+ * tx frames and room for the tx buffers of the port. It uses unaligned chunks
+ * so tx buffers can be sent where they are.
+ * @param[out] xsk        = AF_XDP socket struct
+ * @param[in] ifindex     = NIC interface index
+ * @param[in] maxbuf      = number of frame buffers of port
+ * @return >0 if succeeded
+ */
+static int ecx_setupxsk(ec_xskT *xsk, int ifindex, int maxbuf)
+{
+   struct xdp_umem_reg umemreg;
+   struct xdp_mmap_offsets off;
+   struct xdp_options opts;
+   struct sockaddr_xdp sxdp;
+   union bpf_attr attr;
+   pthread_mutexattr_t mutexattr;
+   socklen_t optlen;
+   uint32 entries, key, i;
+   int r;
+   uint64 *fill;
+   void *umem;
+   size_t pagesize;
+
+   ecx_clearxsk(xsk);
+   pagesize = getpagesize();
+   xsk->txfirst = maxbuf + EC_XSKRXFRAMES;
+   xsk->txlen = sizeof(ec_bufT) * maxbuf;
+   xsk->umemlen = (size_t)(xsk->txfirst + EC_XSKTXFRAMES) * EC_XSKFRAMESIZE + xsk->txlen;
+   xsk->umemlen = (xsk->umemlen + pagesize - 1) & ~(pagesize - 1);
+   umem = mmap(NULL, xsk->umemlen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (umem == MAP_FAILED)
+   {
+      return 0;
+   }
+   xsk->umem = umem;
+   xsk->fd = socket(AF_XDP, SOCK_RAW, 0);
+   if (xsk->fd < 0)
+   {
+      ecx_closexsk(xsk);
+      return 0;
+   }
+   pthread_mutexattr_init(&mutexattr);
+   pthread_mutexattr_setprotocol(&mutexattr, PTHREAD_PRIO_INHERIT);
+   pthread_mutex_init(&(xsk->tx_mutex), &mutexattr);
+   memset(&umemreg, 0, sizeof(umemreg));
+   umemreg.addr = (uint64)(uintptr_t)xsk->umem;
+   umemreg.len = xsk->umemlen;
+   umemreg.chunk_size = EC_XSKFRAMESIZE;
+   umemreg.flags = XDP_UMEM_UNALIGNED_CHUNK_FLAG;
+   if (setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_REG, &umemreg, sizeof(umemreg)) < 0)
+   {
+      ecx_closexsk(xsk);
+      return 0;
+   }
+   entries = EC_XSKRXFRAMES;
+   setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_FILL_RING, &entries, sizeof(entries));
+   setsockopt(xsk->fd, SOL_XDP, XDP_RX_RING, &entries, sizeof(entries));
+   entries = EC_XSKTXFRAMES;
+   setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &entries, sizeof(entries));
+   setsockopt(xsk->fd, SOL_XDP, XDP_TX_RING, &entries, sizeof(entries));
+   optlen = sizeof(off);
+   if ((getsockopt(xsk->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0) ||
+       !ecx_mapxskring(xsk->fd, &(xsk->rx), &off.rx, XDP_PGOFF_RX_RING, EC_XSKRXFRAMES, sizeof(struct xdp_desc)) ||
+       !ecx_mapxskring(xsk->fd, &(xsk->tx), &off.tx, XDP_PGOFF_TX_RING, EC_XSKTXFRAMES, sizeof(struct xdp_desc)) ||
+       !ecx_mapxskring(xsk->fd, &(xsk->fill), &off.fr, XDP_UMEM_PGOFF_FILL_RING, EC_XSKRXFRAMES, sizeof(uint64)) ||
+       !ecx_mapxskring(xsk->fd, &(xsk->comp), &off.cr, XDP_UMEM_PGOFF_COMPLETION_RING, EC_XSKTXFRAMES, sizeof(uint64)))
+   {
+      ecx_closexsk(xsk);
+      return 0;
+   }
+   /* hand the rx frames not owned by an index to the kernel */
+   fill = xsk->fill.desc;
+   for (i = 0; i < EC_XSKRXFRAMES; i++)
+   {
+      fill[i] = (uint64)(maxbuf + i) * EC_XSKFRAMESIZE;
+   }
+   __atomic_store_n(xsk->fill.producer, EC_XSKRXFRAMES, __ATOMIC_RELEASE);
+   memset(&sxdp, 0, sizeof(sxdp));
+   sxdp.sxdp_family = AF_XDP;
+   sxdp.sxdp_ifindex = ifindex;
+   sxdp.sxdp_queue_id = EC_XSKQUEUE;
+   /* a socket closed just before releases the queue asynchronously */
+   for (i = 0; i < EC_XSKBINDRETRY; i++)
+   {
+      r = bind(xsk->fd, (struct sockaddr *)&sxdp, sizeof(sxdp));
+      if ((r == 0) || (errno != EBUSY))
+      {
+         break;
+      }
+      osal_usleep(1000);
+   }
+   if (r < 0)
+   {
+      ecx_closexsk(xsk);
+      return 0;
+   }
+   /* the NIC reads tx frames by DMA in zero-copy mode, page by page */
+   optlen = sizeof(opts);
+   if ((getsockopt(xsk->fd, SOL_XDP, XDP_OPTIONS, &opts, &optlen) == 0) &&
+       (opts.flags & XDP_OPTIONS_ZEROCOPY))
+   {
+      xsk->pagemask = pagesize - 1;
+   }
+   /* XSKMAP with the socket at the bound queue */
+   memset(&attr, 0, sizeof(attr));
+   attr.map_type = BPF_MAP_TYPE_XSKMAP;
+   attr.key_size = sizeof(uint32);
+   attr.value_size = sizeof(uint32);
+   attr.max_entries = EC_XSKQUEUE + 1;
+   xsk->mapfd = ecx_bpf(BPF_MAP_CREATE, &attr);
+   if (xsk->mapfd < 0)
+   {
+      ecx_closexsk(xsk);
+      return 0;
+   }
+   key = EC_XSKQUEUE;
+   memset(&attr, 0, sizeof(attr));
+   attr.map_fd = xsk->mapfd;
+   attr.key = (uint64)(uintptr_t)&key;
+   attr.value = (uint64)(uintptr_t)&(xsk->fd);
+   if (ecx_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0)
+   {
+      ecx_closexsk(xsk);
+      return 0;
+   }
+   xsk->progfd = ecx_loadxdpprog(xsk->mapfd);
+   if (xsk->progfd < 0)
+   {
+      ecx_closexsk(xsk);
+      return 0;
+   }
+   memset(&attr, 0, sizeof(attr));
+   attr.link_create.prog_fd = xsk->progfd;
+   attr.link_create.target_ifindex = ifindex;
+   attr.link_create.attach_type = BPF_XDP;
+   attr.link_create.flags = XDP_FLAGS_DRV_MODE;
+   xsk->linkfd = ecx_bpf(BPF_LINK_CREATE, &attr);
+   if (xsk->linkfd < 0)
+   {
+      attr.link_create.flags = XDP_FLAGS_SKB_MODE;
+      xsk->linkfd = ecx_bpf(BPF_LINK_CREATE, &attr);
+   }
+   if (xsk->linkfd < 0)
+   {
+      ecx_closexsk(xsk);
+      return 0;
+   }
+
+   return 1;
+}
+
+/** Open RAW socket for EtherCAT frames on NIC and set the NIC promiscuous.
+ * The socket is not bound yet.
+ * @param[in] ifname      = Name of NIC device, f.e. "eth0"
+ * @param[out] ifindex    = interface index of NIC
+ * @return socket handle
+ */
+static int ecx_opensocket(const char *ifname, int *ifindex)
+{
+   int i, r, sock;
+   struct timeval timeout;
+   struct ifreq ifr;
+
+   /* we use RAW packet socket, with packet type ETH_P_ECAT */
+   sock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ECAT));
+
+   timeout.tv_sec =  0;
+   timeout.tv_usec = 1;
+   r = setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+   r = setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+   i = 1;
+   r = setsockopt(sock, SOL_SOCKET, SO_DONTROUTE, &i, sizeof(i));
+   /* connect socket to NIC by name */
+   strcpy(ifr.ifr_name, ifname);
+   r = ioctl(sock, SIOCGIFINDEX, &ifr);
+   *ifindex = ifr.ifr_ifindex;
+   strcpy(ifr.ifr_name, ifname);
+   ifr.ifr_flags = 0;
+   /* reset flags of NIC interface */
+   r = ioctl(sock, SIOCGIFFLAGS, &ifr);
+   /* set flags of NIC interface, here promiscuous and broadcast */
+   ifr.ifr_flags = ifr.ifr_flags | IFF_PROMISC | IFF_BROADCAST;
+   r = ioctl(sock, SIOCSIFFLAGS, &ifr);
+   (void)r;
+
+   return sock;
+}
+
+/** Bind RAW socket to NIC, in this case RAW EtherCAT.
+ * @param[in] sock        = socket handle
+ * @param[in] ifindex     = interface index of NIC
+ * @return >0 if succeeded
+ */
+static int ecx_bindsocket(int sock, int ifindex)
+{
+   struct sockaddr_ll sll;
+
+   memset(&sll, 0, sizeof(sll));
+   sll.sll_family = AF_PACKET;
+   sll.sll_ifindex = ifindex;
+   sll.sll_protocol = htons(ETH_P_ECAT);
+
+   return (bind(sock, (struct sockaddr *)&sll, sizeof(sll)) == 0);
+}
+
+/** Setup of plain socket backend.
+ * @param[in] stack       = stack to set up
+ * @param[in] ifname      = Name of NIC device, f.e. "eth0"
+ * @return >0 if succeeded
+ */
+static int ecx_socketsetup(ec_stackT *stack, const char *ifname)
+{
+   int ifindex;
+
+   *stack->sock = ecx_opensocket(ifname, &ifindex);
+   /* filter frames in the kernel before they are queued to the socket */
+   *stack->filtermapfd = ecx_attachfilter(*stack->sock);
+
+   return ecx_bindsocket(*stack->sock, ifindex);
+}
+
+/** Close of plain socket backend.
+ * @param[in] stack       = stack to close
+ */
+static void ecx_socketclose(ec_stackT *stack)
+{
+   if (*stack->filtermapfd >= 0)
+   {
+      close(*stack->filtermapfd);
+      *stack->filtermapfd = -1;
+   }
+   if (*stack->sock >= 0)
+   {
+      close(*stack->sock);
+      *stack->sock = -1;
+   }
+}
+
+/** Setup of memory mapped ring backend.
+ * @param[in] stack       = stack to set up
+ * @param[in] ifname      = Name of NIC device, f.e. "eth0"
+ * @return >0 if succeeded
+ */
+static int ecx_mmapsetup(ec_stackT *stack, const char *ifname)
+{
+   int ifindex;
+
+   *stack->sock = ecx_opensocket(ifname, &ifindex);
+   *stack->filtermapfd = ecx_attachfilter(*stack->sock);
+   /* rings must exist before bind, else frames queue outside the ring */
+   if (!ecx_setupring(*stack->sock, stack->ring))
+   {
+      ecx_socketclose(stack);
+      return 0;
+   }
+
+   return ecx_bindsocket(*stack->sock, ifindex);
+}
+
+/** Close of memory mapped ring backend.
+ * @param[in] stack       = stack to close
+ */
+static void ecx_mmapclose(ec_stackT *stack)
+{
+   ecx_closering(stack->ring);
+   ecx_socketclose(stack);
+}
+
+/** Setup of AF_XDP backend.
+ * @param[in] stack       = stack to set up
+ * @param[in] ifname      = Name of NIC device, f.e. "eth0"
+ * @return >0 if succeeded
+ */
+static int ecx_xdpsetup(ec_stackT *stack, const char *ifname)
+{
+   ec_xskT *xsk;
+   int ifindex, i;
+
+   xsk = stack->xsk;
+   /* RAW socket is only needed to configure the NIC */
+   close(ecx_opensocket(ifname, &ifindex));
+   if (!ecx_setupxsk(xsk, ifindex, *stack->maxbuf))
+   {
+      return 0;
+   }
+   *stack->sock = xsk->fd;
+   /* every index owns a UMEM frame, received frames are swapped in */
+   for (i = 0; i < *stack->maxbuf; i++)
+   {
+      (*stack->rxbuf)[i] = xsk->umem + (size_t)i * EC_XSKFRAMESIZE + ETH_HEADERSIZE;
+   }
+   /* the tx buffers are built in the UMEM and sent from there */
+   if (stack->primary)
+   {
+      xsk->txbuf = (ec_bufT *)(xsk->umem + (size_t)(xsk->txfirst + EC_XSKTXFRAMES) * EC_XSKFRAMESIZE);
+      xsk->txheap = *stack->txbuf;
+      memcpy(xsk->txbuf, xsk->txheap, xsk->txlen);
+      *stack->txbuf = xsk->txbuf;
+   }
+
+   return 1;
+}
+
+/** Close of AF_XDP backend. The tx buffers go back to the heap, the rx
+ * buffers are not used until the next setup.
+ * @param[in] stack       = stack to close
+ */
+static void ecx_xdpclose(ec_stackT *stack)
+{
+   ec_xskT *xsk;
+
+   xsk = stack->xsk;
+   if (xsk->txheap)
+   {
+      memcpy(xsk->txheap, xsk->txbuf, xsk->txlen);
+      *stack->txbuf = xsk->txheap;
+   }
+   /* socket is owned by the AF_XDP struct */
+   ecx_closexsk(xsk);
+   *stack->sock = -1;
+}
+
+/** Setup of loopback backend. The frame queue is signalled by an eventfd that
+ * counts the queued frames, so the port can poll it like a socket.
+ * @param[in] stack       = stack to set up
+ * @param[in] ifname      = not used, there is no NIC
+ * @return >0 if succeeded
+ */
+static int ecx_loopsetup(ec_stackT *stack, const char *ifname)
+{
+   ec_loopT *loop;
+   pthread_mutexattr_t mutexattr;
+
+   (void)ifname;
+   loop = malloc(sizeof(*loop));
+   if (!loop)
+   {
+      return 0;
+   }
+   memset(loop, 0, sizeof(*loop));
+   *stack->sock = eventfd(0, EFD_NONBLOCK | EFD_SEMAPHORE);
+   if (*stack->sock < 0)
+   {
+      free(loop);
+      return 0;
+   }
+   pthread_mutexattr_init(&mutexattr);
+   pthread_mutexattr_setprotocol(&mutexattr, PTHREAD_PRIO_INHERIT);
+   pthread_mutex_init(&(loop->mutex), &mutexattr);
+   stack->backenddata = loop;
+
+   return 1;
+}
+
+/** Close of loopback backend.
+ * @param[in] stack       = stack to close
+ */
+static void ecx_loopclose(ec_stackT *stack)
+{
+   ec_loopT *loop;
+
+   loop = stack->backenddata;
+   if (loop)
+   {
+      pthread_mutex_destroy(&(loop->mutex));
+      free(loop);
+      stack->backenddata = NULL;
+   }
+   if (*stack->sock >= 0)
+   {
+      close(*stack->sock);
+      *stack->sock = -1;
+   }
+}
+
+/** Close of replay backend.
+ * @param[in] stack       = stack to close
+ */
+static void ecx_replayclose(ec_stackT *stack)
+{
+   ec_replayT *replay;
+
+   replay = stack->backenddata;
+   if (replay)
+   {
+      if (replay->map)
+      {
+         munmap(replay->map, replay->maplen);
+      }
+      free(replay->answer);
+      pthread_mutex_destroy(&(replay->mutex));
+      free(replay);
+      stack->backenddata = NULL;
+   }
+   if (*stack->sock >= 0)
+   {
+      close(*stack->sock);
+      *stack->sock = -1;
+   }
+}
+
+/** Current time of clock.
+ * @param[in] clock       = clock to read, f.e. CLOCK_MONOTONIC
+ * @return time in ns
+ */
+static int64 ecx_clocktime(clockid_t clock)
+{
+   struct timespec now;
+
+   clock_gettime(clock, &now);
+
+   return (int64)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/** Find the answers to the frames sent on the primary interface (0) of a
+ * capture. The answer to a frame is the next frame received with the index
+ * of its first datagram. Packet blocks without epb_flags direction are
+ * skipped.
+ * @param[in] replay      = replay backend with mapped capture
+ * @return >0 if the capture is a pcapng file in host byte order
+ */
+static int ecx_replayload(ec_replayT *replay)
+{
+   ec_replayframeT *answer;
+   int pending[256];
+   const uint8 *block, *opt, *frame;
+   size_t pos;
+   uint32 type, blocklen, iface, caplen, optlen, direction;
+   int64 tsunit, ts;
+   int i, size, ifaces;
+   uint8 idxf;
+
+   for (i = 0; i < 256; i++)
+   {
+      pending[i] = -1;
+   }
+   if ((replay->maplen < EC_PCAPNG_SHBLEN) ||
+       (*(const uint32 *)replay->map != EC_PCAPNG_SHB) ||
+       (*(const uint32 *)&replay->map[8] != EC_PCAPNG_MAGIC))
+   {
+      return 0;
+   }
+   tsunit = 1000;
+   ifaces = 0;
+   size = 0;
+   pos = 0;
+   while (pos + 12 <= replay->maplen)
+   {
+      block = &replay->map[pos];
+      type = *(const uint32 *)block;
+      blocklen = *(const uint32 *)&block[4];
+      if ((blocklen < 12) || (blocklen & 3) || (blocklen > replay->maplen - pos))
+      {
+         break;
+      }
+      pos += blocklen;
+      if ((type == EC_PCAPNG_IDB) && (ifaces++ == 0))
+      {
+         /* timestamp resolution of primary interface, default us */
+         opt = &block[16];
+         while (opt + 4 <= &block[blocklen - 4])
+         {
+            optlen = *(const uint16 *)&opt[2];
+            if (*(const uint16 *)opt == EC_PCAPNG_ENDOFOPT)
+            {
+               break;
+            }
+            if ((*(const uint16 *)opt == EC_PCAPNG_TSRESOL) && (optlen == 1) && (opt[4] <= 9))
+            {
+               for (tsunit = 1, i = opt[4]; i < 9; i++)
+               {
+                  tsunit *= 10;
+               }
+            }
+            opt += 4 + ((optlen + 3) & ~3);
+         }
+      }
+      if ((type != EC_PCAPNG_EPB) || (blocklen < 32))
+      {
+         continue;
+      }
+      iface = *(const uint32 *)&block[8];
+      ts = (int64)(((uint64)*(const uint32 *)&block[12] << 32) | *(const uint32 *)&block[16]);
+      caplen = *(const uint32 *)&block[20];
+      frame = &block[28];
+      if ((iface != 0) || (caplen < EC_MINFRAMESIZE) || (caplen > sizeof(ec_bufT)) ||
+          (28 + ((caplen + 3) & ~3) + 4 > blocklen) ||
+          (((const ec_etherheadert *)frame)->etype != htons(ETH_P_ECAT)))
+      {
+         continue;
+      }
+      /* direction from epb_flags option */
+      direction = 0;
+      opt = &frame[(caplen + 3) & ~3];
+      while (opt + 4 <= &block[blocklen - 4])
+      {
+         optlen = *(const uint16 *)&opt[2];
+         if (*(const uint16 *)opt == EC_PCAPNG_ENDOFOPT)
+         {
+            break;
+         }
+         if ((*(const uint16 *)opt == EC_PCAPNG_FLAGS) && (optlen == 4))
+         {
+            direction = *(const uint32 *)&opt[4] & 3;
+         }
+         opt += 4 + ((optlen + 3) & ~3);
+      }
+      idxf = ((const ec_comt *)&frame[ETH_HEADERSIZE])->index;
+      if (direction == EC_PCAPNG_OUTBOUND)
+      {
+         if (replay->answers >= size)
+         {
+            size = size ? size * 2 : 1024;
+            answer = realloc(replay->answer, sizeof(*answer) * size);
+            if (!answer)
+            {
+               return 0;
+            }
+            replay->answer = answer;
+         }
+         /* lost until its answer is found, delay holds the transmit time */
+         answer = &replay->answer[replay->answers];
+         answer->frame = NULL;
+         answer->length = 0;
+         answer->delay = ts;
+         pending[idxf] = replay->answers++;
+      }
+      else if ((direction == EC_PCAPNG_INBOUND) && (pending[idxf] >= 0))
+      {
+         answer = &replay->answer[pending[idxf]];
+         answer->frame = frame;
+         answer->length = caplen;
+         answer->delay = (ts - answer->delay) * tsunit;
+         if (answer->delay < 0)
+         {
+            answer->delay = 0;
+         }
+         pending[idxf] = -1;
+      }
+   }
+
+   return 1;
+}
+
+/** Setup of replay backend. The capture file is mapped and the answers to the
+ * frames sent are looked up, answers in flight are signalled by an eventfd
+ * as with the loopback backend.
+ * @param[in] stack       = stack to set up
+ * @param[in] ifname      = pcapng capture file, see ecx_startcapture()
+ * @return >0 if succeeded
+ */
+static int ecx_replaysetup(ec_stackT *stack, const char *ifname)
+{
+   ec_replayT *replay;
+   pthread_mutexattr_t mutexattr;
+   struct stat st;
+   int fd;
+
+   replay = malloc(sizeof(*replay));
+   if (!replay)
+   {
+      return 0;
+   }
+   memset(replay, 0, sizeof(*replay));
+   pthread_mutexattr_init(&mutexattr);
+   pthread_mutexattr_setprotocol(&mutexattr, PTHREAD_PRIO_INHERIT);
+   pthread_mutex_init(&(replay->mutex), &mutexattr);
+   stack->backenddata = replay;
+   fd = open(ifname, O_RDONLY);
+   if (fd < 0)
+   {
+      ecx_replayclose(stack);
+      return 0;
+   }
+   if ((fstat(fd, &st) == 0) && (st.st_size > 0))
+   {
+      replay->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+      if (replay->map == MAP_FAILED)
+      {
+         replay->map = NULL;
+      }
+      else
+      {
+         replay->maplen = st.st_size;
+      }
+   }
+   close(fd);
+   if (!replay->map || !ecx_replayload(replay))
+   {
+      ecx_replayclose(stack);
+      return 0;
+   }
+   *stack->sock = eventfd(0, EFD_NONBLOCK | EFD_SEMAPHORE);
+   if (*stack->sock < 0)
+   {
+      ecx_replayclose(stack);
+      return 0;
+   }
+
+   return 1;
+}
+
+/** Free frame buffers of port, and of redundant port if it is set up.
+ * @param[in] port        = port context struct
+ */
+static void ecx_freebufs(ecx_portt *port)
+{
+   free(port->txbuf);
+   free(port->txbuflength);
+   port->txbuf = NULL;
+   port->txbuflength = NULL;
+   ecx_freerxbufs(&(port->rxpool), &(port->rxbuf), &(port->rxbufstat), &(port->rxsa));
+   if ((port->redstate != ECT_RED_NONE) && port->redport)
+   {
+      ecx_freerxbufs(&(port->redport->rxpool), &(port->redport->rxbuf),
+                     &(port->redport->rxbufstat), &(port->redport->rxsa));
+   }
+}
+
+/** Set number of frame buffers of port, i.e. the number of frames that can be
+ * in flight at once. Call before ecx_setupnic(), the buffers are allocated
+ * there. A port that is not set uses EC_MAXBUF buffers.
+ * @param[in] port        = port context struct
+ * @param[in] maxbuf      = number of buffers, 1 to EC_MAXSLOTS
+ * @return >0 if succeeded
+ */
+int ecx_setmaxbuf(ecx_portt *port, int maxbuf)
+{
+   if ((maxbuf < 1) || (maxbuf > EC_MAXSLOTS))
+   {
+      return 0;
+   }
+   port->maxbuf = maxbuf;
+
+   return 1;
+}
+
+/** Basic setup to connect NIC to socket.
+ * @param[in] port        = port context struct
+ * @param[in] ifname      = Name of NIC device, f.e. "eth0"
+ * @param[in] secondary   = if >0 then use secondary stack instead of primary
+ * @return >0 if succeeded
+ */
+int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
+{
+   return ecx_setupnic_transport(port, ifname, secondary, ECT_TRANSPORT_SOCKET);
+}
+
+/** Basic setup to connect NIC to socket, with selectable transport.
+ * @param[in] port        = port context struct
+ * @param[in] ifname      = Name of NIC device, f.e. "eth0", or capture file
+ *                          for ECT_TRANSPORT_REPLAY
+ * @param[in] secondary   = if >0 then use secondary stack instead of primary
+ * @param[in] transport   = ECT_TRANSPORT_SOCKET, ECT_TRANSPORT_MMAP,
+ *                          ECT_TRANSPORT_XDP, ECT_TRANSPORT_LOOPBACK or
+ *                          ECT_TRANSPORT_REPLAY
+ * @return >0 if succeeded
+ */
+int ecx_setupnic_transport(ecx_portt *port, const char *ifname, int secondary, int transport)
+{
+   const ec_backendT *backend;
+
+   switch (transport)
+   {
+      case ECT_TRANSPORT_SOCKET:
+         backend = &ecx_socketbackend;
+         break;
+      case ECT_TRANSPORT_MMAP:
+         backend = &ecx_mmapbackend;
+         break;
+      case ECT_TRANSPORT_XDP:
+         backend = &ecx_xdpbackend;
+         break;
+      case ECT_TRANSPORT_LOOPBACK:
+         backend = &ecx_loopbackend;
+         break;
+      case ECT_TRANSPORT_REPLAY:
+         backend = &ecx_replaybackend;
+         break;
+      default:
+         return 0;
+   }
+
+   return ecx_setupnic_backend(port, ifname, secondary, backend);
+}
+
+/** Basic setup to connect NIC to port, with the given backend. Primary and
+ * secondary stack can use different backends. A port still open from a
+ * previous setup is closed first, a secondary stack already set up is refused.
+ * @param[in] port        = port context struct
+ * @param[in] ifname      = Name of NIC device, f.e. "eth0"
+ * @param[in] secondary   = if >0 then use secondary stack instead of primary
+ * @param[in] backend     = NIC backend, f.e. &ecx_socketbackend
+ * @return >0 if succeeded
+ */
+int ecx_setupnic_backend(ecx_portt *port, const char *ifname, int secondary, const ec_backendT *backend)
+{
+   int i;
+   ec_stackT *stack;
+   pthread_mutexattr_t mutexattr;
+
+   if (secondary)
+   {
+      /* secondary port struct available and not yet set up? */
+      if (port->redport && (port->redstate == ECT_RED_NONE))
+      {
+         /* when using secondary socket it is automatically a redundant setup */
+         port->redport->sockhandle = -1;
+         /* rx buffers match the tx buffers of the primary port */
+         if (!ecx_allocrxbufs(&(port->redport->rxpool), &(port->redport->rxbuf),
+                              port->redport->rxspare, &(port->redport->rxbufstat),
+                              &(port->redport->rxsa), port->maxbuf))
+         {
+            ecx_freerxbufs(&(port->redport->rxpool), &(port->redport->rxbuf),
+                           &(port->redport->rxbufstat), &(port->redport->rxsa));
+            return 0;
+         }
+         port->redstate                   = ECT_RED_DOUBLE;
+         port->redport->stack.backend     = backend;
+         port->redport->stack.backenddata = NULL;
+         port->redport->stack.sock        = &(port->redport->sockhandle);
+         port->redport->stack.maxbuf      = &(port->maxbuf);
+         port->redport->stack.txbuf       = &(port->txbuf);
+         port->redport->stack.txbuflength = &(port->txbuflength);
+         port->redport->stack.rxspare     = port->redport->rxspare;
+         port->redport->stack.rxbuf       = &(port->redport->rxbuf);
+         port->redport->stack.rxbufstat   = &(port->redport->rxbufstat);
+         port->redport->stack.rxsa        = &(port->redport->rxsa);
+         port->redport->stack.ring        = &(port->redport->ring);
+         port->redport->stack.xsk         = &(port->redport->xsk);
+         port->redport->stack.filtermapfd = &(port->redport->filtermapfd);
+         port->redport->stack.primary     = FALSE;
+         ecx_clear_rxbufstat(port->redport->rxbufstat, port->maxbuf);
+         stack = &(port->redport->stack);
+      }
+      else
+      {
+         /* fail */
+         return 0;
+      }
+   }
+   else
+   {
+      /* still open from a previous setup, close it to reuse the port */
+      if (port->txbuf)
+      {
+         ecx_closenic(port);
+      }
+      /* no redundant buffers to free if the allocation below fails */
+      port->redstate = ECT_RED_NONE;
+      pthread_mutexattr_init(&mutexattr);
+      pthread_mutexattr_setprotocol(&mutexattr  , PTHREAD_PRIO_INHERIT);
+      pthread_mutex_init(&(port->tx_mutex)      , &mutexattr);
+      pthread_mutex_init(&(port->rx_mutex)      , &mutexattr);
+      if ((port->maxbuf < 1) || (port->maxbuf > EC_MAXSLOTS))
+      {
+         port->maxbuf = EC_MAXBUF;
+      }
+      port->txbuf = malloc(sizeof(ec_bufT) * port->maxbuf);
+      port->txbuflength = malloc(sizeof(int) * port->maxbuf);
+      if (!port->txbuf || !port->txbuflength ||
+          !ecx_allocrxbufs(&(port->rxpool), &(port->rxbuf), port->rxspare,
+                           &(port->rxbufstat), &(port->rxsa), port->maxbuf))
+      {
+         ecx_freebufs(port);
+         return 0;
+      }
+      memset(port->txbuflength, 0, sizeof(int) * port->maxbuf);
+      port->sockhandle        = -1;
+      port->lastidx           = 0;
+      for (i = 0; i < EC_MAXMASK; i++)
+      {
+         port->freemask[i] = 0;
+      }
+      for (i = 0; i < port->maxbuf; i++)
+      {
+         port->freemask[i / 64] |= (uint64)1 << (i % 64);
+      }
+      port->waitmode          = ECT_WAIT_TIMEOUT;
+      port->tstamp            = ECT_TSTAMP_OFF;
+      port->zerocopy          = FALSE;
+      port->receiver          = FALSE;
+      port->redlost           = 0;
+      memset(&(port->capture), 0, sizeof(port->capture));
+      port->capture.fd        = -1;
+      memset(port->async, 0, sizeof(port->async));
+      port->asynccount        = 0;
+      port->stack.backend     = backend;
+      port->stack.backenddata = NULL;
+      port->stack.sock        = &(port->sockhandle);
+      port->stack.maxbuf      = &(port->maxbuf);
+      port->stack.txbuf       = &(port->txbuf);
+      port->stack.txbuflength = &(port->txbuflength);
+      port->stack.rxspare     = port->rxspare;
+      port->stack.rxbuf       = &(port->rxbuf);
+      port->stack.rxbufstat   = &(port->rxbufstat);
+      port->stack.rxsa        = &(port->rxsa);
+      port->stack.ring        = &(port->ring);
+      port->stack.xsk         = &(port->xsk);
+      port->stack.filtermapfd = &(port->filtermapfd);
+      port->stack.primary     = TRUE;
+      ecx_clear_rxbufstat(port->rxbufstat, port->maxbuf);
+      stack = &(port->stack);
+   }
+   stack->ring->map = NULL;
+   ecx_clearxsk(stack->xsk);
+   *stack->filtermapfd = -1;
+   /* setup ethernet headers in tx buffers so we don't have to repeat it */
+   for (i = 0; i < port->maxbuf; i++)
+   {
+      ec_setupheader(&(port->txbuf[i]));
+      port->rxbufstat[i] = EC_BUF_EMPTY;
+   }
+   ec_setupheader(&(port->txbuf2));
+
+   return backend->setup(stack, ifname);
+}
+
+/** Apply wait mode to one socket.
+ * @param[in] sock        = socket handle
+ * @param[in] waitmode    = ECT_WAIT_TIMEOUT, ECT_WAIT_BUSYPOLL or ECT_WAIT_BLOCK
+ * @return >0 if succeeded
+ */
+static int ecx_setsockwaitmode(int sock, int waitmode)
+{
+   int flags, busypoll;
+
+   flags = fcntl(sock, F_GETFL, 0);
+   if (flags < 0)
+   {
+      return 0;
+   }
+   if (waitmode == ECT_WAIT_TIMEOUT)
+   {
+      flags &= ~O_NONBLOCK;
+   }
+   else
+   {
+      flags |= O_NONBLOCK;
+   }
+   if (fcntl(sock, F_SETFL, flags) < 0)
+   {
+      return 0;
+   }
+   busypoll = (waitmode == ECT_WAIT_BUSYPOLL) ? EC_BUSYPOLLTIME : 0;
+   /* busy polling is a hint, not all kernels and NICs support it */
+   setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, &busypoll, sizeof(busypoll));
+#ifdef SO_PREFER_BUSY_POLL
+   busypoll = (waitmode == ECT_WAIT_BUSYPOLL);
+   setsockopt(sock, SOL_SOCKET, SO_PREFER_BUSY_POLL, &busypoll, sizeof(busypoll));
+#endif
+
+   return 1;
+}
+
+/** Select how receiving threads wait for frames. Call after the NIC(s) are
+ * set up, the mode applies to the primary and, if used, secondary socket.
+ * @param[in] port        = port context struct
+ * @param[in] waitmode    = ECT_WAIT_TIMEOUT, ECT_WAIT_BUSYPOLL or ECT_WAIT_BLOCK
+ * @return >0 if succeeded
+ */
+int ecx_setwaitmode(ecx_portt *port, int waitmode)
+{
+   if ((waitmode < ECT_WAIT_TIMEOUT) || (waitmode > ECT_WAIT_BLOCK))
+   {
+      return 0;
+   }
+   if (!ecx_setsockwaitmode(port->sockhandle, waitmode))
+   {
+      return 0;
+   }
+   if ((port->redstate != ECT_RED_NONE) &&
+       !ecx_setsockwaitmode(port->redport->sockhandle, waitmode))
+   {
+      return 0;
+   }
+   port->waitmode = waitmode;
+
+   return 1;
+}
+
+/** Add drop counters of one socket filter.
+ * @param[in] mapfd       = drop counter map
+ * @param[in,out] count   = counters per ECT_FILTER_* reason
+ * @return >0 if counters are available
+ */
+static int ecx_readfilterstats(int mapfd, uint64 *count)
+{
+   union bpf_attr attr;
+   uint32 key;
+   uint64 value;
+
+   if (mapfd < 0)
+   {
+      return 0;
+   }
+   for (key = 0; key < ECT_FILTER_COUNTERS; key++)
+   {
+      memset(&attr, 0, sizeof(attr));
+      attr.map_fd = mapfd;
+      attr.key = (uint64)(uintptr_t)&key;
+      attr.value = (uint64)(uintptr_t)&value;
+      if (ecx_bpf(BPF_MAP_LOOKUP_ELEM, &attr) < 0)
+      {
+         return 0;
+      }
+      count[key] += value;
+   }
+
+   return 1;
+}
+
+/** Read number of frames dropped by the socket filter, summed over primary
+ * and secondary socket.
+ * @param[in] port        = port context struct
+ * @param[out] own        = own outgoing frames dropped
+ * @param[out] malformed  = malformed frames dropped
+ * @return >0 if counters are available, 0 if no counting filter is attached
+ */
+int ecx_getfilterstats(ecx_portt *port, uint64 *own, uint64 *malformed)
+{
+   uint64 count[ECT_FILTER_COUNTERS];
+   int rval;
+
+   memset(count, 0, sizeof(count));
+   rval = ecx_readfilterstats(port->filtermapfd, count);
+   if (port->redstate != ECT_RED_NONE)
+   {
+      rval |= ecx_readfilterstats(port->redport->filtermapfd, count);
+   }
+   *own = count[ECT_FILTER_OWN];
+   *malformed = count[ECT_FILTER_MALFORMED];
+
+   return rval;
+}
+
+/** Timestamp of a received message.
+ * @param[in] port        = port context struct
+ * @param[in] msg         = message incl. control messages
+ * @return timestamp in ns, 0 if the message has none
+ */
+static int64 ecx_msgstamp(ecx_portt *port, struct msghdr *msg)
+{
+   struct cmsghdr *cmsg;
+   struct scm_timestamping *tss;
+   struct timespec *ts;
+
+   for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg))
+   {
+      if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPING))
+      {
+         tss = (struct scm_timestamping *)CMSG_DATA(cmsg);
+         /* software stamp in ts[0], raw hardware stamp in ts[2] */
+         ts = &(tss->ts[(port->tstamp == ECT_TSTAMP_HARDWARE) ? 2 : 0]);
+         return (int64)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+      }
+   }
+
+   return 0;
+}
+
+/** Index of an EtherCAT frame.
+ * @param[in] port        = port context struct
+ * @param[in] frame       = frame incl. ethernet header
+ * @param[in] length      = frame length
+ * @return frame index, -1 if not an EtherCAT frame of this port
+ */
+static int ecx_frameindex(ecx_portt *port, const uint8 *frame, int length)
+{
+   const ec_etherheadert *ehp;
+   const ec_comt *ecp;
+
+   ehp = (const ec_etherheadert *)frame;
+   if ((length < (int)EC_MINFRAMESIZE) || (ehp->etype != htons(ETH_P_ECAT)))
+   {
+      return -1;
+   }
+   ecp = (const ec_comt *)&frame[ETH_HEADERSIZE];
+   if (ecp->index >= port->maxbuf)
+   {
+      return -1;
+   }
+
+   return ecp->index;
+}
+
+/** Collect transmit timestamps from the error queue of the primary socket.
+ * The kernel returns the sent frame with its stamp, which gives the index.
+ * A stamp is only taken while its index is in flight and the returned frame
+ * is the one in the tx buffer, a stamp arriving late from an earlier use of
+ * the index is dropped.
+ * @param[in] port        = port context struct
+ */
+static void ecx_readtxstamps(ecx_portt *port)
+{
+   struct msghdr msg;
+   struct iovec iov;
+   ec_bufT frame;
+   uint8 control[EC_TSTAMPCTRL];
+   int length, idx;
+
+   for (;;)
+   {
+      memset(&msg, 0, sizeof(msg));
+      iov.iov_base = frame;
+      iov.iov_len = sizeof(frame);
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      length = recvmsg(port->sockhandle, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+      if (length < 0)
+      {
+         break;
+      }
+      idx = ecx_frameindex(port, frame, length);
+      if ((idx >= 0) &&
+          (port->rxbufstat[idx] != EC_BUF_EMPTY) && (port->rxbufstat[idx] != EC_BUF_ALLOC) &&
+          (length == port->txbuflength[idx]) && !memcmp(frame, &(port->txbuf[idx]), length))
+      {
+         port->txtime[idx] = ecx_msgstamp(port, &msg);
+      }
+   }
+}
+
+/** Select packet timestamping of the primary socket. Only the plain socket
+ * transport (ECT_TRANSPORT_SOCKET) supports timestamps. Software stamps work
+ * on any NIC incl. veth pairs, hardware stamps are enabled on the NIC with
+ * SIOCSHWTSTAMP and are taken from the NIC clock.
+ * @param[in] port        = port context struct
+ * @param[in] mode        = ECT_TSTAMP_OFF, ECT_TSTAMP_SOFTWARE or ECT_TSTAMP_HARDWARE
+ * @return >0 if succeeded
+ */
+int ecx_settimestamping(ecx_portt *port, int mode)
+{
+   struct sockaddr_ll sll;
+   socklen_t length;
+   struct ifreq ifr;
+   struct hwtstamp_config config;
+   int flags, i;
+
+   if ((mode < ECT_TSTAMP_OFF) || (mode > ECT_TSTAMP_HARDWARE))
+   {
+      return 0;
+   }
+   /* rings, AF_XDP and loopback do not pass the stamps */
+   if (port->stack.backend != &ecx_socketbackend)
+   {
+      return (mode == ECT_TSTAMP_OFF);
+   }
+   flags = 0;
+   if (mode == ECT_TSTAMP_SOFTWARE)
+   {
+      flags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE |
+              SOF_TIMESTAMPING_SOFTWARE;
+   }
+   else if (mode == ECT_TSTAMP_HARDWARE)
+   {
+      length = sizeof(sll);
+      memset(&ifr, 0, sizeof(ifr));
+      if ((getsockname(port->sockhandle, (struct sockaddr *)&sll, &length) < 0) ||
+          !if_indextoname(sll.sll_ifindex, ifr.ifr_name))
+      {
+         return 0;
+      }
+      memset(&config, 0, sizeof(config));
+      config.tx_type = HWTSTAMP_TX_ON;
+      config.rx_filter = HWTSTAMP_FILTER_ALL;
+      ifr.ifr_data = (void *)&config;
+      if (ioctl(port->sockhandle, SIOCSHWTSTAMP, &ifr) < 0)
+      {
+         return 0;
+      }
+      flags = SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RX_HARDWARE |
+              SOF_TIMESTAMPING_RAW_HARDWARE;
+   }
+   if (setsockopt(port->sockhandle, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0)
+   {
+      return 0;
+   }
+   pthread_mutex_lock(&(port->rx_mutex));
+   port->tstamp = mode;
+   /* stamps still queued would keep the socket signalling POLLERR */
+   ecx_readtxstamps(port);
+   for (i = 0; i < EC_MAXSLOTS; i++)
+   {
+      port->txtime[i] = 0;
+      port->rxtime[i] = 0;
+   }
+   pthread_mutex_unlock(&(port->rx_mutex));
+
+   return 1;
+}
+
+/** Select receive of process data in place. The plain socket transport in
+ * single NIC mode then scatters the data of the first datagram of an LRW
+ * frame directly into the IOmap, the copy out of the rx buffer is saved.
+ * The receiver threads, timestamping and capture keep the copying receive.
+ * @param[in] port        = port context struct
+ * @param[in] enable      = TRUE to receive in place
+ * @return >0 if the port can receive in place
+ */
+int ecx_setzerocopy(ecx_portt *port, int enable)
+{
+   if (enable && (port->stack.backend != &ecx_socketbackend))
+   {
+      return 0;
+   }
+   port->zerocopy = enable ? TRUE : FALSE;
+
+   return 1;
+}
+
+/** Read the timestamps of the last frame transmitted with index. Valid from
+ * the return of the frame until the index is released.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index of frame
+ * @param[out] txtime     = transmit timestamp in ns
+ * @param[out] rxtime     = receive timestamp in ns
+ * @return >0 if both timestamps are known
+ */
+int ecx_getframetime(ecx_portt *port, uint8 idx, int64 *txtime, int64 *rxtime)
+{
+   *txtime = 0;
+   *rxtime = 0;
+   if (!port->tstamp || (idx >= port->maxbuf))
+   {
+      return 0;
+   }
+   /* hardware transmit stamps may be queued after the frame returned */
+   if (!port->txtime[idx])
+   {
+      pthread_mutex_lock(&(port->rx_mutex));
+      ecx_readtxstamps(port);
+      pthread_mutex_unlock(&(port->rx_mutex));
+   }
+   *txtime = port->txtime[idx];
+   *rxtime = port->rxtime[idx];
+
+   return (*txtime && *rxtime);
+}
+
+/** Drop the oldest packet block of capture ring.
+ * @param[in] cap         = capture ring
+ */
+static void ecx_capturedrop(ec_captureT *cap)
+{
+   cap->tail += *(uint32 *)&(cap->map[cap->tail + 4]);
+   cap->frames--;
+   cap->overwritten++;
+   if (cap->wrapped && (cap->tail >= cap->end))
+   {
+      /* all blocks behind head are gone */
+      cap->tail = cap->start;
+      cap->wrapped = FALSE;
+   }
+}
+
+/** Reserve packet block in capture ring, the oldest blocks are overwritten.
+ * @param[in] cap         = capture ring
+ * @param[in] length      = block length, multiple of 4
+ * @return block, NULL if it does not fit in the ring
+ */
+static uint8 *ecx_capturereserve(ec_captureT *cap, size_t length)
+{
+   uint8 *block;
+
+   if (length > cap->maplen - cap->start)
+   {
+      return NULL;
+   }
+   if (cap->head + length > cap->maplen)
+   {
+      /* wrap, the blocks from tail to end stay until they are overwritten */
+      while (cap->wrapped)
+      {
+         ecx_capturedrop(cap);
+      }
+      cap->end = cap->head;
+      cap->head = cap->start;
+      cap->wrapped = TRUE;
+   }
+   while (cap->wrapped && (cap->tail < cap->head + length))
+   {
+      ecx_capturedrop(cap);
+   }
+   block = &(cap->map[cap->head]);
+   cap->head += length;
+   cap->frames++;
+
+   return block;
+}
+
+/** Write frame to the capture of port as enhanced packet block. Called from
+ * the sending and receiving threads, it does not wait longer than
+ * EC_CAPTURESPIN spins for another thread writing, the frame is dropped
+ * instead.
+ * @param[in] port        = port context struct
+ * @param[in] stacknumber = 0=primary 1=secondary stack, the pcapng interface
+ * @param[in] frame       = frame incl. ethernet header
+ * @param[in] length      = frame length in bytes
+ * @param[in] direction   = EC_PCAPNG_INBOUND or EC_PCAPNG_OUTBOUND
+ */
+static void ecx_captureframe(ecx_portt *port, int stacknumber, const void *frame, int length,
+                             uint32 direction)
+{
+   ec_captureT *cap;
+   uint8 *block;
+   uint32 *word;
+   uint32 caplen, padlen, blocklen;
+   int64 ts;
+   int spin;
+
+   cap = &(port->capture);
+   if (!__atomic_load_n(&(cap->active), __ATOMIC_RELAXED) || (length <= 0))
+   {
+      return;
+   }
+   caplen = length;
+   padlen = (caplen + 3) & ~3;
+   blocklen = EC_PCAPNG_EPBLEN + padlen;
+   ts = ecx_clocktime(CLOCK_REALTIME);
+   spin = 0;
+   while (__atomic_exchange_n(&(cap->lock), 1, __ATOMIC_ACQUIRE))
+   {
+      if (++spin > EC_CAPTURESPIN)
+      {
+         __atomic_add_fetch(&(cap->dropped), 1, __ATOMIC_RELAXED);
+         return;
+      }
+   }
+   block = cap->active ? ecx_capturereserve(cap, blocklen) : NULL;
+   if (block)
+   {
+      word = (uint32 *)block;
+      word[0] = EC_PCAPNG_EPB;
+      word[1] = blocklen;
+      word[2] = stacknumber;
+      word[3] = (uint32)((uint64)ts >> 32);
+      word[4] = (uint32)ts;
+      word[5] = caplen;
+      word[6] = caplen;
+      memcpy(&block[28], frame, caplen);
+      memset(&block[28 + caplen], 0, padlen - caplen);
+      word = (uint32 *)&block[28 + padlen];
+      /* epb_flags option with direction, end of options, block length */
+      ((uint16 *)word)[0] = EC_PCAPNG_FLAGS;
+      ((uint16 *)word)[1] = 4;
+      word[1] = direction;
+      word[2] = EC_PCAPNG_ENDOFOPT;
+      word[3] = blocklen;
+   }
+   __atomic_store_n(&(cap->lock), 0, __ATOMIC_RELEASE);
+}
+
+/** Start capture of all frames sent and received by port into a pcapng file.
+ * The file is preallocated with size bytes and memory mapped, it holds the
+ * most recent frames that fit. Primary and secondary stack are pcapng
+ * interfaces 0 and 1, timestamps are CLOCK_REALTIME in ns. Call after
+ * ecx_setupnic(). For the shortest writes put the file on tmpfs, f.e. in
+ * /dev/shm, so that no page of it waits for the disk.
+ * @param[in] port        = port context struct
+ * @param[in] filename    = capture file, created or truncated
+ * @param[in] size        = size of capture file in bytes
+ * @return >0 if succeeded
+ */
+int ecx_startcapture(ecx_portt *port, const char *filename, size_t size)
+{
+   ec_captureT *cap;
+   uint32 *word;
+   int i;
+
+   cap = &(port->capture);
+   size &= ~(size_t)3;
+   if (cap->map || (size < EC_PCAPNG_SHBLEN + EC_PCAPNG_IFACES * EC_PCAPNG_IDBLEN +
+                            2 * (EC_PCAPNG_EPBLEN + sizeof(ec_bufT))))
+   {
+      return 0;
+   }
+   cap->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+   if (cap->fd < 0)
+   {
+      return 0;
+   }
+   /* allocate all blocks now, ftruncate() alone leaves a sparse file */
+   if ((posix_fallocate(cap->fd, 0, size) != 0) && (ftruncate(cap->fd, size) < 0))
+   {
+      close(cap->fd);
+      return 0;
+   }
+   cap->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, cap->fd, 0);
+   if (cap->map == MAP_FAILED)
+   {
+      cap->map = NULL;
+      close(cap->fd);
+      return 0;
+   }
+   /* keep the pages resident if allowed, a page fault would stall the writer */
+   mlock(cap->map, size);
+   cap->maplen = size;
+   word = (uint32 *)cap->map;
+   /* section header block, section length unknown */
+   word[0] = EC_PCAPNG_SHB;
+   word[1] = EC_PCAPNG_SHBLEN;
+   word[2] = EC_PCAPNG_MAGIC;
+   word[3] = 1;
+   word[4] = 0xffffffff;
+   word[5] = 0xffffffff;
+   word[6] = EC_PCAPNG_SHBLEN;
+   /* one ethernet interface per stack with if_tsresol 9, ns */
+   for (i = 0; i < EC_PCAPNG_IFACES; i++)
+   {
+      word = (uint32 *)&(cap->map[EC_PCAPNG_SHBLEN + i * EC_PCAPNG_IDBLEN]);
+      word[0] = EC_PCAPNG_IDB;
+      word[1] = EC_PCAPNG_IDBLEN;
+      ((uint16 *)word)[4] = 1;
+      ((uint16 *)word)[5] = 0;
+      word[3] = sizeof(ec_bufT);
+      ((uint16 *)word)[8] = EC_PCAPNG_TSRESOL;
+      ((uint16 *)word)[9] = 1;
+      word[5] = 9;
+      word[6] = EC_PCAPNG_ENDOFOPT;
+      word[7] = EC_PCAPNG_IDBLEN;
+   }
+   cap->start = EC_PCAPNG_SHBLEN + EC_PCAPNG_IFACES * EC_PCAPNG_IDBLEN;
+   cap->head = cap->start;
+   cap->tail = cap->start;
+   cap->end = cap->start;
+   cap->wrapped = FALSE;
+   cap->lock = 0;
+   cap->frames = 0;
+   cap->overwritten = 0;
+   cap->dropped = 0;
+   __atomic_store_n(&(cap->active), TRUE, __ATOMIC_RELEASE);
+
+   return 1;
+}
+
+/** Stop capture of port. The packet blocks are put in order, oldest first,
+ * and the file is truncated after the last one.
+ * @param[in] port        = port context struct
+ * @return number of frames in capture file
+ */
+int ecx_stopcapture(ecx_portt *port)
+{
+   ec_captureT *cap;
+   uint8 *older;
+   size_t olderlen, length;
+
+   cap = &(port->capture);
+   if (!cap->map)
+   {
+      return 0;
+   }
+   while (__atomic_exchange_n(&(cap->lock), 1, __ATOMIC_ACQUIRE))
+   {
+      sched_yield();
+   }
+   cap->active = FALSE;
+   __atomic_store_n(&(cap->lock), 0, __ATOMIC_RELEASE);
+   length = cap->head;
+   if (cap->wrapped)
+   {
+      /* move the blocks behind head to the front */
+      olderlen = cap->end - cap->tail;
+      older = malloc(olderlen);
+      if (older)
+      {
+         memcpy(older, &(cap->map[cap->tail]), olderlen);
+         memmove(&(cap->map[cap->start + olderlen]), &(cap->map[cap->start]),
+                 cap->head - cap->start);
+         memcpy(&(cap->map[cap->start]), older, olderlen);
+         free(older);
+         length += olderlen;
+      }
+      else
+      {
+         while (cap->wrapped)
+         {
+            ecx_capturedrop(cap);
+         }
+      }
+   }
+   msync(cap->map, length, MS_SYNC);
+   munmap(cap->map, cap->maplen);
+   cap->map = NULL;
+   if (ftruncate(cap->fd, length) < 0)
+   {
+      /* the stale bytes after the last block remain */
+   }
+   close(cap->fd);
+   cap->fd = -1;
+
+   return (int)cap->frames;
+}
+
+/** Read capture counters of port, they keep their values after the capture
+ * is stopped.
+ * @param[in] port        = port context struct
+ * @param[out] frames     = frames in capture ring
+ * @param[out] overwritten = frames overwritten by newer ones
+ * @param[out] dropped    = frames not captured because the ring was busy
+ * @return >0 if the capture runs
+ */
+int ecx_getcapturestats(ecx_portt *port, uint64 *frames, uint64 *overwritten, uint64 *dropped)
+{
+   ec_captureT *cap;
+
+   cap = &(port->capture);
+   *frames = __atomic_load_n(&(cap->frames), __ATOMIC_RELAXED);
+   *overwritten = __atomic_load_n(&(cap->overwritten), __ATOMIC_RELAXED);
+   *dropped = __atomic_load_n(&(cap->dropped), __ATOMIC_RELAXED);
+
+   return (cap->map != NULL);
+}
+
+/** Close sockets used
+ * @param[in] port        = port context struct
+ * @return 0
+ */
+int ecx_closenic(ecx_portt *port)
+{
+   ecx_stopreceiver(port);
+   ecx_stopcapture(port);
+   if (port->stack.backend)
+   {
+      port->stack.backend->close(&(port->stack));
+      port->stack.backend = NULL;
+   }
+   if ((port->redport) && (port->redstate != ECT_RED_NONE) && port->redport->stack.backend)
+   {
+      port->redport->stack.backend->close(&(port->redport->stack));
+      port->redport->stack.backend = NULL;
+   }
+   ecx_freebufs(port);
+   port->redstate = ECT_RED_NONE;
+
+   return 0;
+}
+
+/** Fill buffer with ethernet header structure.
+ * Destination MAC is always broadcast.
+ * Ethertype is always ETH_P_ECAT.
+ * @param[out] p = buffer
+ */
+void ec_setupheader(void *p)
+{
+   ec_etherheadert *bp;
+   bp = p;
+   bp->da0 = htons(0xffff);
+   bp->da1 = htons(0xffff);
+   bp->da2 = htons(0xffff);
+   bp->sa0 = htons(priMAC[0]);
+   bp->sa1 = htons(priMAC[1]);
+   bp->sa2 = htons(priMAC[2]);
+   bp->etype = htons(ETH_P_ECAT);
+}
+
+/** Reclaim tx frames the kernel reports in the completion ring. Call with
+ * tx_mutex locked.
+ * @param[in] xsk         = AF_XDP socket struct
+ */
+static void ecx_reclaimtx_xsk(ec_xskT *xsk)
+{
+   uint32 prod, cons;
+   uint64 addr;
+
+   prod = __atomic_load_n(xsk->comp.producer, __ATOMIC_ACQUIRE);
+   cons = *xsk->comp.consumer;
+   while (cons != prod)
+   {
+      addr = ((uint64 *)xsk->comp.desc)[cons & xsk->comp.mask];
+      if (addr >= (uint64)(xsk->txfirst + EC_XSKTXFRAMES) * EC_XSKFRAMESIZE)
+      {
+         xsk->txbusy[(addr - (uint64)(xsk->txfirst + EC_XSKTXFRAMES) * EC_XSKFRAMESIZE) /
+                     sizeof(ec_bufT)]--;
+      }
+      xsk->txdone++;
+      cons++;
+   }
+   __atomic_store_n(xsk->comp.consumer, cons, __ATOMIC_RELEASE);
+}
+
+/** Wait until the kernel is done with the frames sent from a tx buffer in
+ * the UMEM, before the buffer is written again. A frame the kernel could not
+ * take at once is sent later and read from the buffer then. Waits at most
+ * EC_TIMEOUTRET.
+ * @param[in] xsk         = AF_XDP socket struct
+ * @param[in] idx         = index of tx buffer
+ */
+static void ecx_waittx_xsk(ec_xskT *xsk, uint8 idx)
+{
+   osal_timert timer;
+   int busy;
+
+   osal_timer_start(&timer, EC_TIMEOUTRET);
+   do
+   {
+      pthread_mutex_lock(&(xsk->tx_mutex));
+      ecx_reclaimtx_xsk(xsk);
+      busy = xsk->txbusy[idx];
+      pthread_mutex_unlock(&(xsk->tx_mutex));
+      if (busy)
+      {
+         /* kick the kernel again for frames left in the tx ring */
+         sendto(xsk->fd, NULL, 0, MSG_DONTWAIT, NULL, 0);
+      }
+   } while (busy && !osal_timer_is_expired(&timer));
+}
+
+/** Get new frame identifier index and allocate corresponding rx buffer.
+ * @param[in] port        = port context struct
+ * @return new index.
+ */
+uint8 ecx_getindex(ecx_portt *port)
+{
+   uint64 mask, from, bit;
+   int start, words, word, pos, i, found;
+   uint8 idx;
+
+   /* search free index round robin, starting after the last one */
+   start = __atomic_load_n(&(port->lastidx), __ATOMIC_RELAXED) + 1;
+   if (start >= port->maxbuf)
+   {
+      start = 0;
+   }
+   idx = (uint8)start;
+   found = FALSE;
+   words = (port->maxbuf + 63) / 64;
+   /* the start word is visited twice, from start on and finally in full */
+   for (i = 0; (i <= words) && !found; i++)
+   {
+      word = ((start / 64) + i) % words;
+      from = (i == 0) ? (~(uint64)0 << (start % 64)) : ~(uint64)0;
+      mask = __atomic_load_n(&(port->freemask[word]), __ATOMIC_ACQUIRE) & from;
+      while (mask && !found)
+      {
+         pos = __builtin_ctzll(mask);
+         bit = (uint64)1 << pos;
+         /* claim the index, another thread may have been faster */
+         if (__atomic_fetch_and(&(port->freemask[word]), ~bit, __ATOMIC_ACQ_REL) & bit)
+         {
+            idx = (uint8)(word * 64 + pos);
+            found = TRUE;
+         }
+         else
+         {
+            mask = __atomic_load_n(&(port->freemask[word]), __ATOMIC_ACQUIRE) & from;
+         }
+      }
+   }
+   /* tx buffer in AF_XDP UMEM may still be read by the kernel */
+   if (port->xsk.txbuf && __atomic_load_n(&(port->xsk.txbusy[idx]), __ATOMIC_RELAXED))
+   {
+      ecx_waittx_xsk(&(port->xsk), idx);
+   }
+   /* if no index is free the next one is reused, as before */
+   port->rxbufstat[idx] = EC_BUF_ALLOC;
+   if (port->redstate != ECT_RED_NONE)
+      port->redport->rxbufstat[idx] = EC_BUF_ALLOC;
+   /* stamps of the last use of the index must not show up on this one */
+   if (port->tstamp)
+   {
+      port->txtime[idx] = 0;
+      port->rxtime[idx] = 0;
+   }
+   __atomic_store_n(&(port->lastidx), idx, __ATOMIC_RELAXED);
+
+   return idx;
+}
+
+/** Set rx buffer status.
+ * @param[in] port        = port context struct
+ * @param[in] idx      = index in buffer array
+ * @param[in] bufstat  = status to set
+ */
+void ecx_setbufstat(ecx_portt *port, uint8 idx, int bufstat)
+{
+   uint64 bit;
+
+   port->rxbufstat[idx] = bufstat;
+   if (port->redstate != ECT_RED_NONE)
+      port->redport->rxbufstat[idx] = bufstat;
+   bit = (uint64)1 << (idx % 64);
+   if (bufstat == EC_BUF_EMPTY)
+   {
+      /* status first, the next owner sets its own status after the release */
+      __atomic_fetch_or(&(port->freemask[idx / 64]), bit, __ATOMIC_RELEASE);
+   }
+   else
+   {
+      __atomic_fetch_and(&(port->freemask[idx / 64]), ~bit, __ATOMIC_ACQ_REL);
+   }
+}
+
+/** Transmit frame over AF_XDP socket (non blocking). A frame in the tx
+ * buffers placed in the UMEM is sent where it is. Other frames, and in
+ * zero-copy mode frames crossing a page, are copied to the next tx UMEM frame.
+ * Tx UMEM frames are used round robin and are free again once the kernel
+ * reports them in the completion ring.
+ * @param[in] xsk         = AF_XDP socket struct
+ * @param[in] frame       = frame incl. ethernet header
+ * @param[in] length      = frame length in bytes
+ * @return socket send result
+ */
+static int ecx_sendpkt_xsk(ec_xskT *xsk, const void *frame, int length)
+{
+   struct xdp_desc *desc;
+   uint32 prod;
+   uint64 addr;
+   uintptr_t pos;
+   int rval;
+
+   rval = -1;
+   pthread_mutex_lock(&(xsk->tx_mutex));
+   ecx_reclaimtx_xsk(xsk);
+   if ((xsk->txsent - xsk->txdone) < EC_XSKTXFRAMES)
+   {
+      pos = (uintptr_t)frame - (uintptr_t)xsk->txbuf;
+      addr = (uint64)((const uint8 *)frame - xsk->umem);
+      if (!xsk->txbuf || (pos >= xsk->txlen) ||
+          (xsk->pagemask && (((addr & xsk->pagemask) + length) > (xsk->pagemask + 1))))
+      {
+         addr = (uint64)(xsk->txfirst + (xsk->txsent % EC_XSKTXFRAMES)) * EC_XSKFRAMESIZE;
+         memcpy(xsk->umem + addr, frame, length);
+      }
+      else
+      {
+         /* the tx buffer must not change until the kernel is done with it */
+         xsk->txbusy[pos / sizeof(ec_bufT)]++;
+      }
+      prod = *xsk->tx.producer;
+      desc = (struct xdp_desc *)xsk->tx.desc + (prod & xsk->tx.mask);
+      desc->addr = addr;
+      desc->len = length;
+      desc->options = 0;
+      __atomic_store_n(xsk->tx.producer, prod + 1, __ATOMIC_RELEASE);
+      xsk->txsent++;
+      /* kick kernel to process the tx ring */
+      if ((sendto(xsk->fd, NULL, 0, MSG_DONTWAIT, NULL, 0) >= 0) ||
+          (errno == EAGAIN) || (errno == EBUSY) || (errno == ENOBUFS))
+      {
+         rval = length;
+      }
+   }
+   pthread_mutex_unlock(&(xsk->tx_mutex));
+
+   return rval;
+}
+
+/** Send of plain socket backend.
+ * @param[in] stack       = stack to transmit on
+ * @param[in] frame       = frame incl. ethernet header
+ * @param[in] length      = frame length in bytes
+ * @return socket send result
+ */
+static int ecx_socketsend(ec_stackT *stack, const void *frame, int length)
+{
+   return send(*stack->sock, frame, length, 0);
+}
+
+/** Send of memory mapped ring backend. The frame is placed in the tx ring
+ * and the kernel is kicked without waiting for the transmission to complete.
+ * @param[in] stack       = stack to transmit on
+ * @param[in] frame       = frame incl. ethernet header
+ * @param[in] length      = frame length in bytes
+ * @return length, -1 if the tx ring is full or the slot held a rejected frame
+ */
+static int ecx_mmapsend(ec_stackT *stack, const void *frame, int length)
+{
+   ec_ringT *ring;
+   struct tpacket2_hdr *hdr;
+   uint32 status;
+   int rval;
+
+   ring = stack->ring;
+   rval = -1;
+   pthread_mutex_lock(&(ring->tx_mutex));
+   hdr = (struct tpacket2_hdr *)(ring->txring + (size_t)ring->txhead * EC_RINGFRAMESIZE);
+   status = __atomic_load_n(&(hdr->tp_status), __ATOMIC_ACQUIRE);
+   if (status == TP_STATUS_WRONG_FORMAT)
+   {
+      /* kernel rejected the frame in this slot, free it so the ring does not
+       * stall on it, this send fails and the next one reuses the slot */
+      __atomic_store_n(&(hdr->tp_status), TP_STATUS_AVAILABLE, __ATOMIC_RELEASE);
+   }
+   /* frame slot is free when the kernel has finished the previous transmission */
+   else if (status == TP_STATUS_AVAILABLE)
+   {
+      memcpy((uint8 *)hdr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll), frame, length);
+      hdr->tp_len = length;
+      __atomic_store_n(&(hdr->tp_status), TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+      ring->txhead = (ring->txhead + 1) % ring->txframes;
+      if (send(*stack->sock, NULL, 0, MSG_DONTWAIT) >= 0)
+      {
+         rval = length;
+      }
+   }
+   pthread_mutex_unlock(&(ring->tx_mutex));
+
+   return rval;
+}
+
+/** Send of AF_XDP backend.
+ * @param[in] stack       = stack to transmit on
+ * @param[in] frame       = frame incl. ethernet header
+ * @param[in] length      = frame length in bytes
+ * @return length, -1 if no tx frame is free
+ */
+static int ecx_xdpsend(ec_stackT *stack, const void *frame, int length)
+{
+   return ecx_sendpkt_xsk(stack->xsk, frame, length);
+}
+
+/** Send of loopback backend, the frame is queued for receive.
+ * @param[in] stack       = stack to transmit on
+ * @param[in] frame       = frame incl. ethernet header
+ * @param[in] length      = frame length in bytes
+ * @return length, -1 if the queue is full
+ */
+static int ecx_loopsend(ec_stackT *stack, const void *frame, int length)
+{
+   ec_loopT *loop;
+   uint64 one;
+   int pos, rval;
+
+   loop = stack->backenddata;
+   one = 1;
+   rval = -1;
+   pthread_mutex_lock(&(loop->mutex));
+   if ((loop->count < EC_LOOPFRAMES) && (length <= (int)sizeof(ec_bufT)))
+   {
+      pos = (loop->head + loop->count) % EC_LOOPFRAMES;
+      memcpy(loop->frame[pos], frame, length);
+      loop->length[pos] = length;
+      loop->count++;
+      /* eventfd counts the queued frames, keep both in step under the mutex */
+      if (write(*stack->sock, &one, sizeof(one)) == sizeof(one))
+      {
+         rval = length;
+      }
+   }
+   pthread_mutex_unlock(&(loop->mutex));
+
+   return rval;
+}
+
+/** Send of replay backend. The answer recorded for the frame sent at this
+ * position is queued, to be received after its recorded round trip time. A
+ * frame lost in the capture gets no answer.
+ * @param[in] stack       = stack to transmit on
+ * @param[in] frame       = frame incl. ethernet header
+ * @param[in] length      = frame length in bytes
+ * @return length, -1 if the queue is full or the capture has ended
+ */
+static int ecx_replaysend(ec_stackT *stack, const void *frame, int length)
+{
+   ec_replayT *replay;
+   const ec_replayframeT *answer;
+   uint64 one;
+   int pos, rval;
+
+   replay = stack->backenddata;
+   one = 1;
+   rval = -1;
+   if (length < (int)EC_MINFRAMESIZE)
+   {
+      return -1;
+   }
+   pthread_mutex_lock(&(replay->mutex));
+   if ((replay->count < EC_REPLAYFRAMES) && (replay->next < replay->answers))
+   {
+      answer = &replay->answer[replay->next++];
+      rval = length;
+      if (answer->frame)
+      {
+         pos = (replay->head + replay->count) % EC_REPLAYFRAMES;
+         replay->queue[pos] = answer;
+         replay->index[pos] = ((const ec_comt *)((const uint8 *)frame + ETH_HEADERSIZE))->index;
+         replay->due[pos] = ecx_clocktime(CLOCK_MONOTONIC) + answer->delay;
+         replay->count++;
+         if (write(*stack->sock, &one, sizeof(one)) != sizeof(one))
+         {
+            rval = -1;
+         }
+      }
+   }
+   pthread_mutex_unlock(&(replay->mutex));
+
+   return rval;
+}
+
+/** Transmit frame over stack (non blocking).
+ * @param[in] stack       = stack to transmit on
+ * @param[in] frame       = frame incl. ethernet header
+ * @param[in] length      = frame length in bytes
+ * @return length, -1 if failed
+ */
+static int ecx_sendpkt(ec_stackT *stack, const void *frame, int length)
+{
+   return stack->backend->send(stack, frame, length);
+}
+
+/** Transmit buffer over socket (non blocking).
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index in tx buffer array
+ * @param[in] stacknumber  = 0=Primary 1=Secondary stack
+ * @return socket send result
+ */
+int ecx_outframe(ecx_portt *port, uint8 idx, int stacknumber)
+{
+   int lp, rval;
+   ec_stackT *stack;
+
+   if (!stacknumber)
+   {
+      stack = &(port->stack);
+   }
+   else
+   {
+      stack = &(port->redport->stack);
+   }
+   lp = (*stack->txbuflength)[idx];
+   (*stack->rxbufstat)[idx] = EC_BUF_TX;
+   if (!stacknumber && port->tstamp)
+   {
+      port->txtime[idx] = 0;
+      port->rxtime[idx] = 0;
+   }
+   /* before the send, the answer may be captured as soon as it is sent */
+   ecx_captureframe(port, stacknumber, (*stack->txbuf)[idx], lp, EC_PCAPNG_OUTBOUND);
+   rval = ecx_sendpkt(stack, (*stack->txbuf)[idx], lp);
+   if (rval == -1)
+   {
+      /* not in flight, the index stays with the caller until it releases it */
+      if (!stacknumber)
+      {
+         ecx_setbufstat(port, idx, EC_BUF_ALLOC);
+      }
+      else
+      {
+         (*stack->rxbufstat)[idx] = EC_BUF_ALLOC;
+      }
+   }
+
+   return rval;
+}
+
+/** Transmit buffer over socket (non blocking).
+ * @param[in] port        = port context struct
+ * @param[in] idx = index in tx buffer array
+ * @return socket send result
+ */
+int ecx_outframe_red(ecx_portt *port, uint8 idx)
+{
+   ec_comt *datagramP;
+   ec_etherheadert *ehp;
+   int rval;
+
+   ehp = (ec_etherheadert *)&(port->txbuf[idx]);
+   /* rewrite MAC source address 1 to primary */
+   ehp->sa1 = htons(priMAC[1]);
+   /* the primary frame returns on the secondary socket, a receiver thread
+    * may read it before this function returns */
+   if (port->redstate != ECT_RED_NONE)
+   {
+      port->redport->rxbufstat[idx] = EC_BUF_TX;
+   }
+   /* transmit over primary socket*/
+   rval = ecx_outframe(port, idx, 0);
+   if ((port->redstate != ECT_RED_NONE) && (rval != -1))
+   {
+      pthread_mutex_lock( &(port->tx_mutex) );
+      ehp = (ec_etherheadert *)&(port->txbuf2);
+      /* use dummy frame for secondary socket transmit (BRD) */
+      datagramP = (ec_comt*)&(port->txbuf2[ETH_HEADERSIZE]);
+      /* write index to frame */
+      datagramP->index = idx;
+      /* rewrite MAC source address 1 to secondary */
+      ehp->sa1 = htons(secMAC[1]);
+      /* transmit over secondary socket */
+      ecx_captureframe(port, 1, &(port->txbuf2), port->txbuflength2, EC_PCAPNG_OUTBOUND);
+      if (ecx_sendpkt(&(port->redport->stack), &(port->txbuf2), port->txbuflength2) == -1)
+      {
+         /* only the secondary side, the primary frame is still in flight */
+         port->redport->rxbufstat[idx] = EC_BUF_ALLOC;
+      }
+      pthread_mutex_unlock( &(port->tx_mutex) );
+   }
+
+   return rval;
+}
+
+/** Hand current rx ring frame back to the kernel and advance to the next.
+ * @param[in] ring        = ring struct
+ */
+static void ecx_releasepkt_ring(ec_ringT *ring)
+{
+   struct tpacket2_hdr *hdr;
+
+   hdr = (struct tpacket2_hdr *)(ring->rxring + (size_t)ring->rxhead * EC_RINGFRAMESIZE);
+   __atomic_store_n(&(hdr->tp_status), TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+   ring->rxhead = (ring->rxhead + 1) % ring->rxframes;
+}
+
+/** Hand current AF_XDP rx frame back to the kernel through the fill ring, or
+ * the frame it was swapped with.
+ * @param[in] xsk         = AF_XDP socket struct
+ */
+static void ecx_releasepkt_xsk(ec_xskT *xsk)
+{
+   uint32 cons, prod;
+
+   cons = *xsk->rx.consumer;
+   prod = *xsk->fill.producer;
+   /* the received frame or the one of the index it was swapped with */
+   ((uint64 *)xsk->fill.desc)[prod & xsk->fill.mask] =
+      (uint64)(xsk->rxspare - xsk->umem) & ~((uint64)EC_XSKFRAMESIZE - 1);
+   __atomic_store_n(xsk->fill.producer, prod + 1, __ATOMIC_RELEASE);
+   __atomic_store_n(xsk->rx.consumer, cons + 1, __ATOMIC_RELEASE);
+}
+
+/** Receive frame on the primary plain socket with its timestamp. Transmit
+ * timestamps queued meanwhile are collected first.
+ * @param[in] port        = port context struct
+ * @param[out] frame      = buffer to receive into
+ * @return recv() result
+ */
+static int ecx_recvstamped(ecx_portt *port, uint8 *frame)
+{
+   struct msghdr msg;
+   struct iovec iov;
+   uint8 control[EC_TSTAMPCTRL];
+   int bytesrx, idx;
+
+   ecx_readtxstamps(port);
+   memset(&msg, 0, sizeof(msg));
+   iov.iov_base = frame;
+   iov.iov_len = sizeof(ec_bufT);
+   msg.msg_iov = &iov;
+   msg.msg_iovlen = 1;
+   msg.msg_control = control;
+   msg.msg_controllen = sizeof(control);
+   bytesrx = recvmsg(port->sockhandle, &msg, 0);
+   idx = ecx_frameindex(port, frame, bytesrx);
+   if (idx >= 0)
+   {
+      port->rxtime[idx] = ecx_msgstamp(port, &msg);
+   }
+
+   return bytesrx;
+}
+
+/** Receive of plain socket backend. The frame is received into a spare
+ * frame, ecx_storeframe() swaps it into place. The primary socket reads the
+ * timestamps with the frame if timestamping is on.
+ * @param[in] port        = port context struct
+ * @param[in] stack       = stack to receive on
+ * @param[out] frame      = received frame incl. ethernet header
+ * @return recv() result
+ */
+static int ecx_socketrecv(ecx_portt *port, ec_stackT *stack, uint8 **frame)
+{
+   *frame = stack->rxspare[0];
+   if ((stack == &(port->stack)) && port->tstamp)
+   {
+      return ecx_recvstamped(port, *frame);
+   }
+
+   return recv(*stack->sock, *frame, sizeof(ec_bufT), 0);
+}
+
+/** Receive of memory mapped ring backend. The frame is not copied but
+ * referenced in the ring, it is handed back with ecx_mmaprelease().
+ * @param[in] port        = port context struct
+ * @param[in] stack       = stack to receive on
+ * @param[out] frame      = received frame incl. ethernet header
+ * @return frame length, 0 if none
+ */
+static int ecx_mmaprecv(ecx_portt *port, ec_stackT *stack, uint8 **frame)
+{
+   ec_ringT *ring;
+   struct tpacket2_hdr *hdr;
+   struct pollfd pfd;
+   const struct timespec ringwait = { 0, 1000 };
+   int bytesrx;
+
+   ring = stack->ring;
+   bytesrx = 0;
+   hdr = (struct tpacket2_hdr *)(ring->rxring + (size_t)ring->rxhead * EC_RINGFRAMESIZE);
+   if (__atomic_load_n(&(hdr->tp_status), __ATOMIC_ACQUIRE) & TP_STATUS_USER)
+   {
+      bytesrx = hdr->tp_snaplen;
+      *frame = (uint8 *)hdr + hdr->tp_mac;
+      if (bytesrx <= 0)
+      {
+         ecx_releasepkt_ring(ring);
+      }
+   }
+   else if (port->waitmode == ECT_WAIT_TIMEOUT)
+   {
+      /* ring empty, wait as short as the socket receive timeout does */
+      pfd.fd = *stack->sock;
+      pfd.events = POLLIN;
+      ppoll(&pfd, 1, &ringwait, NULL);
+   }
+
+   return bytesrx;
+}
+
+/** Release of memory mapped ring backend.
+ * @param[in] stack       = stack the frame was read from
+ */
+static void ecx_mmaprelease(ec_stackT *stack)
+{
+   ecx_releasepkt_ring(stack->ring);
+}
+
+/** Receive of AF_XDP backend. The frame is not copied but referenced in the
+ * UMEM. ecx_storeframe() swaps it with the UMEM frame of its index, which is
+ * handed back with ecx_xdprelease().
+ * @param[in] port        = port context struct
+ * @param[in] stack       = stack to receive on
+ * @param[out] frame      = received frame incl. ethernet header
+ * @return frame length, 0 if none
+ */
+static int ecx_xdprecv(ecx_portt *port, ec_stackT *stack, uint8 **frame)
+{
+   ec_xskT *xsk;
+   struct xdp_desc *desc;
+   struct pollfd pfd;
+   const struct timespec ringwait = { 0, 1000 };
+   uint32 cons;
+   int bytesrx;
+
+   xsk = stack->xsk;
+   bytesrx = 0;
+   cons = *xsk->rx.consumer;
+   if (__atomic_load_n(xsk->rx.producer, __ATOMIC_ACQUIRE) != cons)
+   {
+      desc = (struct xdp_desc *)xsk->rx.desc + (cons & xsk->rx.mask);
+      bytesrx = desc->len;
+      /* unaligned chunks carry the offset of the data in the upper bits */
+      *frame = xsk->umem + (desc->addr & XSK_UNALIGNED_BUF_ADDR_MASK) +
+               (desc->addr >> XSK_UNALIGNED_BUF_OFFSET_SHIFT);
+      xsk->rxspare = *frame;
+      if (bytesrx <= 0)
+      {
+         ecx_releasepkt_xsk(xsk);
+      }
+   }
+   else if (port->waitmode == ECT_WAIT_TIMEOUT)
+   {
+      /* rx ring empty, wait as short as the socket receive timeout does */
+      pfd.fd = xsk->fd;
+      pfd.events = POLLIN;
+      ppoll(&pfd, 1, &ringwait, NULL);
+   }
+
+   return bytesrx;
+}
+
+/** Release of AF_XDP backend.
+ * @param[in] stack       = stack the frame was read from
+ */
+static void ecx_xdprelease(ec_stackT *stack)
+{
+   ecx_releasepkt_xsk(stack->xsk);
+}
+
+/** Receive of loopback backend, takes the oldest queued frame. Never waits,
+ * the queue is filled by the threads sending.
+ * @param[in] port        = port context struct
+ * @param[in] stack       = stack to receive on
+ * @param[out] frame      = received frame incl. ethernet header
+ * @return frame length, 0 if none
+ */
+static int ecx_looprecv(ecx_portt *port, ec_stackT *stack, uint8 **frame)
+{
+   ec_loopT *loop;
+   uint64 count;
+   int bytesrx;
+
+   (void)port;
+   loop = stack->backenddata;
+   bytesrx = 0;
+   pthread_mutex_lock(&(loop->mutex));
+   if (loop->count > 0)
+   {
+      bytesrx = loop->length[loop->head];
+      memcpy(stack->rxspare[0], loop->frame[loop->head], bytesrx);
+      *frame = stack->rxspare[0];
+      loop->head = (loop->head + 1) % EC_LOOPFRAMES;
+      loop->count--;
+      if (read(*stack->sock, &count, sizeof(count)) != sizeof(count))
+      {
+         /* counter and queue are only changed together, not reached */
+      }
+   }
+   pthread_mutex_unlock(&(loop->mutex));
+
+   return bytesrx;
+}
+
+/** Receive of replay backend, takes the oldest queued answer once it is due
+ * and gives it the index of the frame it answers. Never waits.
+ * @param[in] port        = port context struct
+ * @param[in] stack       = stack to receive on
+ * @param[out] frame      = received frame incl. ethernet header
+ * @return frame length, 0 if none
+ */
+static int ecx_replayrecv(ecx_portt *port, ec_stackT *stack, uint8 **frame)
+{
+   ec_replayT *replay;
+   ec_comt *ecp;
+   uint64 count;
+   int bytesrx;
+
+   (void)port;
+   replay = stack->backenddata;
+   bytesrx = 0;
+   pthread_mutex_lock(&(replay->mutex));
+   if ((replay->count > 0) && (replay->due[replay->head] <= ecx_clocktime(CLOCK_MONOTONIC)))
+   {
+      bytesrx = replay->queue[replay->head]->length;
+      memcpy(stack->rxspare[0], replay->queue[replay->head]->frame, bytesrx);
+      ecp = (ec_comt *)&(stack->rxspare[0][ETH_HEADERSIZE]);
+      ecp->index = replay->index[replay->head];
+      *frame = stack->rxspare[0];
+      replay->head = (replay->head + 1) % EC_REPLAYFRAMES;
+      replay->count--;
+      if (read(*stack->sock, &count, sizeof(count)) != sizeof(count))
+      {
+         /* counter and queue are only changed together, not reached */
+      }
+   }
+   pthread_mutex_unlock(&(replay->mutex));
+
+   return bytesrx;
+}
+
+/** Plain RAW socket backend, ECT_TRANSPORT_SOCKET */
+const ec_backendT ecx_socketbackend =
+{
+   "socket", ecx_socketsetup, ecx_socketclose, ecx_socketsend, ecx_socketrecv, NULL
+};
+
+/** RAW socket with memory mapped rings, ECT_TRANSPORT_MMAP */
+const ec_backendT ecx_mmapbackend =
+{
+   "mmap", ecx_mmapsetup, ecx_mmapclose, ecx_mmapsend, ecx_mmaprecv, ecx_mmaprelease
+};
+
+/** AF_XDP socket, ECT_TRANSPORT_XDP */
+const ec_backendT ecx_xdpbackend =
+{
+   "xdp", ecx_xdpsetup, ecx_xdpclose, ecx_xdpsend, ecx_xdprecv, ecx_xdprelease
+};
+
+/** In-process loopback without NIC, ECT_TRANSPORT_LOOPBACK */
+const ec_backendT ecx_loopbackend =
+{
+   "loopback", ecx_loopsetup, ecx_loopclose, ecx_loopsend, ecx_looprecv, NULL
+};
+
+/** Replay of a pcapng capture without NIC, ECT_TRANSPORT_REPLAY */
+const ec_backendT ecx_replaybackend =
+{
+   "replay", ecx_replaysetup, ecx_replayclose, ecx_replaysend, ecx_replayrecv, NULL
+};
+
+/** Non blocking read of stack. Frames are received into the spare frame of
+ * the stack, or, if the backend has a release function, referenced in its
+ * ring and handed back with ecx_releasepkt() after use.
+ * @param[in] port        = port context struct
+ * @param[in] stacknumber = 0=primary 1=secondary stack
+ * @param[out] frame      = received frame incl. ethernet header
+ * @return >0 if frame is available and read
+ */
+static int ecx_recvpkt(ecx_portt *port, int stacknumber, uint8 **frame)
+{
+   int bytesrx;
+   ec_stackT *stack;
+
+   if (!stacknumber)
+   {
+      stack = &(port->stack);
+   }
+   else
+   {
+      stack = &(port->redport->stack);
+   }
+   bytesrx = stack->backend->recv(port, stack, frame);
+   port->tempinbufs = bytesrx;
+   if (bytesrx > 0)
+   {
+      ecx_captureframe(port, stacknumber, *frame, bytesrx, EC_PCAPNG_INBOUND);
+      /* a line returning frames is not lost (anymore) */
+      if (__atomic_load_n(&(port->redlost), __ATOMIC_RELAXED))
+      {
+         __atomic_and_fetch(&(port->redlost),
+                            stacknumber ? ~EC_REDLINE_SECONDARY : ~EC_REDLINE_PRIMARY,
+                            __ATOMIC_RELAXED);
+      }
+   }
+
+   return (bytesrx > 0);
+}
+
+/** Release frame read by ecx_recvpkt(). Only needed for backends that
+ * reference frames in a ring.
+ * @param[in] stack       = stack the frame was read from
+ */
+static void ecx_releasepkt(ec_stackT *stack)
+{
+   if (stack->backend->release)
+   {
+      stack->backend->release(stack);
+   }
+}
+
+/** Spare entry ecx_recvpkt() receives into.
+ * @param[in] stack       = stack the frame was read from
+ * @return spare entry, NULL if the frame is in a ring and has to be copied
+ */
+static uint8 **ecx_recvspare(ec_stackT *stack)
+{
+   /* AF_XDP rx buffers are UMEM frames too, the frames are swapped */
+   if (stack->backend == &ecx_xdpbackend)
+   {
+      return &(stack->xsk->rxspare);
+   }
+   if (stack->backend->release)
+   {
+      return NULL;
+   }
+
+   return &(stack->rxspare[0]);
+}
+
+/** Hand received frame to the rx buffer of its index. A spare frame is
+ * swapped with the frame the index owns, a ring frame is copied.
+ * @param[in] stack       = stack the frame was read from
+ * @param[in] frame       = received frame incl. ethernet header
+ * @param[in,out] spare   = spare entry holding frame, NULL for ring frames
+ * @param[in] idx         = index of frame
+ */
+static void ecx_putframe(ec_stackT *stack, uint8 *frame, uint8 **spare, uint8 idx)
+{
+   uint8 *rxbuf;
+
+   rxbuf = (*stack->rxbuf)[idx];
+   if (spare)
+   {
+      /* index takes the received frame, its previous frame becomes spare */
+      (*stack->rxbuf)[idx] = &frame[ETH_HEADERSIZE];
+      *spare = rxbuf - ETH_HEADERSIZE;
+   }
+   else
+   {
+      /* put it in the buffer array (strip ethernet header) */
+      memcpy(rxbuf, &frame[ETH_HEADERSIZE], (*stack->txbuflength)[idx] - ETH_HEADERSIZE);
+   }
+}
+
+/** Store received frame in the rx buffer of its index. If it is the requested
+ * index it is marked completed, else it is marked received if someone is
+ * waiting for it.
+ * @param[in] stack       = stack the frame was read from
+ * @param[in] frame       = received frame incl. ethernet header
+ * @param[in,out] spare   = spare entry holding frame, NULL for ring frames
+ * @param[in] idx         = requested index, or -1 if none
+ * @return Workcounter if frame has the requested index, otherwise EC_OTHERFRAME.
+ */
+static int ecx_storeframe(ec_stackT *stack, uint8 *frame, uint8 **spare, int idx)
+{
+   uint16  l;
+   int     rval;
+   uint8   idxf;
+   ec_etherheadert *ehp;
+   ec_comt *ecp;
+   uint8   *rxbuf;
+
+   rval = EC_OTHERFRAME;
+   ehp =(ec_etherheadert*)(frame);
+   /* check if it is an EtherCAT frame */
+   if (ehp->etype == htons(ETH_P_ECAT))
+   {
+      ecp =(ec_comt*)(&frame[ETH_HEADERSIZE]);
+      l = etohs(ecp->elength) & 0x0fff;
+      idxf = ecp->index;
+      /* found index equals requested index ? */
+      if (idxf == idx)
+      {
+         ecx_putframe(stack, frame, spare, idxf);
+         rxbuf = (*stack->rxbuf)[idxf];
+         /* return WKC */
+         rval = (rxbuf[l] + ((uint16)(rxbuf[l + 1]) << 8));
+         /* mark as completed */
+         (*stack->rxbufstat)[idx] = EC_BUF_COMPLETE;
+         /* store MAC source word 1 for redundant routing info */
+         (*stack->rxsa)[idx] = ntohs(ehp->sa1);
+      }
+      else
+      {
+         /* check if index exist and someone is waiting for it */
+         if (idxf < *stack->maxbuf && (*stack->rxbufstat)[idxf] == EC_BUF_TX)
+         {
+            ecx_putframe(stack, frame, spare, idxf);
+            /* mark as received, after the data for a receiver thread */
+            __atomic_store_n(&(*stack->rxbufstat)[idxf], EC_BUF_RCVD, __ATOMIC_RELEASE);
+            (*stack->rxsa)[idxf] = ntohs(ehp->sa1);
+         }
+         else
+         {
+            /* strange things happened */
+         }
+      }
+   }
+
+   return rval;
+}
+
+/** Non blocking receive frame function. Uses RX buffer and index to combine
+ * read frame with transmitted frame. To compensate for received frames that
+ * are out-of-order all frames are stored in their respective indexed buffer.
+ * If a frame was placed in the buffer previously, the function retrieves it
+ * from that buffer index without calling ec_recvpkt. If the requested index
+ * is not already in the buffer it calls ec_recvpkt to fetch it. There are
+ * three options now, 1 no frame read, so exit. 2 frame read but other
+ * than requested index, store in buffer and exit. 3 frame read with matching
+ * index, store in buffer, set completed flag in buffer status and exit.
+ *
+ * @param[in] port        = port context struct
+ * @param[in] idx         = requested index of frame
+ * @param[in] stacknumber = 0=primary 1=secondary stack
+ * @return Workcounter if a frame is found with corresponding index, otherwise
+ * EC_NOFRAME or EC_OTHERFRAME.
+ */
+int ecx_inframe(ecx_portt *port, uint8 idx, int stacknumber)
+{
+   uint16  l;
+   int     rval;
+   ec_stackT *stack;
+   uint8 *rxbuf;
+   uint8 *frame;
+
+   if (!stacknumber)
+   {
+      stack = &(port->stack);
+   }
+   else
+   {
+      stack = &(port->redport->stack);
+   }
+   rval = EC_NOFRAME;
+   /* check if requested index is already in buffer ? */
+   if ((idx < *stack->maxbuf) &&
+       (__atomic_load_n(&(*stack->rxbufstat)[idx], __ATOMIC_ACQUIRE) == EC_BUF_RCVD))
+   {
+      /* frame of index is only swapped before it is marked received */
+      rxbuf = (*stack->rxbuf)[idx];
+      l = rxbuf[0] + ((uint16)(rxbuf[1] & 0x0f) << 8);
+      /* return WKC */
+      rval = (rxbuf[l] + ((uint16)rxbuf[l + 1] << 8));
+      /* mark as completed */
+      (*stack->rxbufstat)[idx] = EC_BUF_COMPLETE;
+   }
+   /* with receiver threads only they read the socket */
+   else if (!port->receiver)
    {
       pthread_mutex_lock(&(port->rx_mutex));
       /* non blocking call to retrieve frame from socket */
-      if (ecx_recvpkt(port, stacknumber))
-      {
-         rval = EC_OTHERFRAME;
-         ehp =(ec_etherheadert*)(stack->tempbuf);
-         /* check if it is an EtherCAT frame */
-         if (ehp->etype == htons(ETH_P_ECAT))
-         {
-            ecp =(ec_comt*)(&(*stack->tempbuf)[ETH_HEADERSIZE]);
-            l = etohs(ecp->elength) & 0x0fff;
-            idxf = ecp->index;
-            /* found index equals requested index ? */
-            if (idxf == idx)
+      if (ecx_recvpkt(port, stacknumber, &frame))
+      {
+         rval = ecx_storeframe(stack, frame, ecx_recvspare(stack), idx);
+         /* hand ring frame back to kernel */
+         ecx_releasepkt(stack);
+      }
+      pthread_mutex_unlock( &(port->rx_mutex) );
+
+   }
+
+   /* WKC if matching frame found */
+   return rval;
+}
+
+/** Read all frames available on the primary socket and store them in the rx
+ * buffers of their index, marked as received. A plain socket is drained with
+ * one recvmmsg() call, rings are read until empty.
+ * @param[in] port        = port context struct
+ * @return number of frames read
+ */
+static int ecx_drainframes(ecx_portt *port)
+{
+   struct mmsghdr msg[EC_MAXBATCH];
+   struct iovec iov[EC_MAXBATCH];
+   uint8 control[EC_MAXBATCH][EC_TSTAMPCTRL];
+   ec_stackT *stack;
+   uint8 *frame;
+   int i, n, idx;
+
+   stack = &(port->stack);
+   n = 0;
+   if (port->receiver)
+   {
+      return 0;
+   }
+   pthread_mutex_lock(&(port->rx_mutex));
+   /* recvmmsg() is for plain sockets, other backends are read one by one */
+   if (stack->backend != &ecx_socketbackend)
+   {
+      while ((n < EC_MAXBATCH) && ecx_recvpkt(port, 0, &frame))
+      {
+         ecx_storeframe(stack, frame, ecx_recvspare(stack), -1);
+         ecx_releasepkt(stack);
+         n++;
+      }
+   }
+   else
+   {
+      memset(msg, 0, sizeof(msg));
+      for (i = 0; i < EC_MAXBATCH; i++)
+      {
+         iov[i].iov_base = port->rxspare[i];
+         iov[i].iov_len = sizeof(ec_bufT);
+         msg[i].msg_hdr.msg_iov = &iov[i];
+         msg[i].msg_hdr.msg_iovlen = 1;
+         if (port->tstamp)
+         {
+            msg[i].msg_hdr.msg_control = control[i];
+            msg[i].msg_hdr.msg_controllen = sizeof(control[i]);
+         }
+      }
+      if (port->tstamp)
+      {
+         ecx_readtxstamps(port);
+      }
+      /* wait for the first frame as long as the socket timeout, then take what is there */
+      n = recvmmsg(*stack->sock, msg, EC_MAXBATCH, MSG_WAITFORONE, NULL);
+      for (i = 0; i < n; i++)
+      {
+         if (msg[i].msg_len > 0)
+         {
+            ecx_captureframe(port, 0, port->rxspare[i], msg[i].msg_len, EC_PCAPNG_INBOUND);
+            idx = ecx_frameindex(port, port->rxspare[i], msg[i].msg_len);
+            if (port->tstamp && (idx >= 0))
             {
-               /* yes, put it in the buffer array (strip ethernet header) */
-               memcpy(rxbuf, &(*stack->tempbuf)[ETH_HEADERSIZE], (*stack->txbuflength)[idx] - ETH_HEADERSIZE);
-               /* return WKC */
-               rval = ((*rxbuf)[l] + ((uint16)((*rxbuf)[l + 1]) << 8));
-               /* mark as completed */
-               (*stack->rxbufstat)[idx] = EC_BUF_COMPLETE;
-               /* store MAC source word 1 for redundant routing info */
-               (*stack->rxsa)[idx] = ntohs(ehp->sa1);
+               port->rxtime[idx] = ecx_msgstamp(port, &(msg[i].msg_hdr));
             }
-            else
+            ecx_storeframe(stack, port->rxspare[i], &(port->rxspare[i]), -1);
+         }
+      }
+   }
+   pthread_mutex_unlock(&(port->rx_mutex));
+
+   return (n > 0) ? n : 0;
+}
+
+/** Time left until timer expires.
+ * @param[in] timer       = absolute timeout time
+ * @return time left in ns, <=0 if expired
+ */
+static int64 ecx_timeleft(osal_timert *timer)
+{
+   struct timespec now;
+
+   /* osal timers run on the monotonic clock */
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return ((int64)timer->stop_time.sec - now.tv_sec) * 1000000000LL +
+          ((int64)timer->stop_time.usec * 1000 - now.tv_nsec);
+}
+
+/** Sleep until the receiver thread stores a frame for index or the timer
+ * expires.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index of frame
+ * @param[in] event       = value of the event counter before the frame was
+ *                          last looked for
+ * @param[in] timer       = absolute timeout time
+ */
+static void ecx_waitevent(ecx_portt *port, uint8 idx, uint32 event, osal_timert *timer)
+{
+   struct timespec wait;
+   int64 remain;
+
+   remain = ecx_timeleft(timer);
+   if (remain <= 0)
+   {
+      return;
+   }
+   wait.tv_sec = remain / 1000000000LL;
+   wait.tv_nsec = remain % 1000000000LL;
+   /* returns at once if a frame was stored since event was read */
+   syscall(SYS_futex, &(port->rxevent[idx]), FUTEX_WAIT_PRIVATE, event, &wait, NULL, 0);
+}
+
+/** Sleep until a frame is available on one of the selected sockets or the
+ * timer expires. Only sleeps with ECT_WAIT_BLOCK, in the other modes the
+ * caller keeps polling.
+ * @param[in] port        = port context struct
+ * @param[in] primary     = wait on primary socket
+ * @param[in] secondary   = wait on secondary socket
+ * @param[in] timer       = absolute timeout time
+ */
+static void ecx_waitpkt(ecx_portt *port, int primary, int secondary, osal_timert *timer)
+{
+   struct pollfd pfd[2];
+   struct timespec wait;
+   int64 remain;
+   int n;
+
+   if (port->waitmode != ECT_WAIT_BLOCK)
+   {
+      return;
+   }
+   remain = ecx_timeleft(timer);
+   if (remain <= 0)
+   {
+      return;
+   }
+   if (remain > EC_WAITSLICE * 1000LL)
+   {
+      remain = EC_WAITSLICE * 1000LL;
+   }
+   n = 0;
+   if (primary)
+   {
+      pfd[n].fd = port->sockhandle;
+      pfd[n++].events = POLLIN;
+   }
+   if (secondary && (port->redstate != ECT_RED_NONE))
+   {
+      pfd[n].fd = port->redport->sockhandle;
+      pfd[n++].events = POLLIN;
+   }
+   wait.tv_sec = remain / 1000000000LL;
+   wait.tv_nsec = remain % 1000000000LL;
+   ppoll(pfd, n, &wait, NULL);
+}
+
+/** Wait until a frame can be read from one of the selected stacks of a
+ * redundant port or the timer expires. Both sockets are waited on together,
+ * so a frame on one is not held up by a receive call waiting on the other.
+ * With ECT_WAIT_BUSYPOLL the non blocking reads are spun on instead.
+ * @param[in] port        = port context struct
+ * @param[in] primary     = wait on primary socket
+ * @param[in] secondary   = wait on secondary socket
+ * @param[in] timer       = absolute timeout time
+ * @return EC_REDLINE_PRIMARY and EC_REDLINE_SECONDARY bits of the stacks
+ * that can be read
+ */
+static int ecx_pollred(ecx_portt *port, int primary, int secondary, osal_timert *timer)
+{
+   struct pollfd pfd[2];
+   struct timespec wait;
+   int64 remain;
+   int ready;
+
+   if (port->waitmode == ECT_WAIT_BUSYPOLL)
+   {
+      return (primary ? EC_REDLINE_PRIMARY : 0) | (secondary ? EC_REDLINE_SECONDARY : 0);
+   }
+   remain = ecx_timeleft(timer);
+   if (remain <= 0)
+   {
+      return 0;
+   }
+   if (remain > EC_WAITSLICE * 1000LL)
+   {
+      remain = EC_WAITSLICE * 1000LL;
+   }
+   /* negative descriptors are ignored by ppoll() */
+   pfd[0].fd = primary ? port->sockhandle : -1;
+   pfd[0].events = POLLIN;
+   pfd[0].revents = 0;
+   pfd[1].fd = secondary ? port->redport->sockhandle : -1;
+   pfd[1].events = POLLIN;
+   pfd[1].revents = 0;
+   wait.tv_sec = remain / 1000000000LL;
+   wait.tv_nsec = remain % 1000000000LL;
+   ready = 0;
+   if (ppoll(pfd, 2, &wait, NULL) > 0)
+   {
+      if (pfd[0].revents & POLLIN)
+      {
+         ready |= EC_REDLINE_PRIMARY;
+      }
+      if (pfd[1].revents & POLLIN)
+      {
+         ready |= EC_REDLINE_SECONDARY;
+      }
+   }
+
+   return ready;
+}
+
+/** Move the frame of index received on the secondary stack to the primary
+ * rx buffer. The two frames are swapped, the secondary keeps a frame to
+ * receive into. UMEM frames of an AF_XDP stack are copied instead.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index of frame
+ */
+static void ecx_takeredframe(ecx_portt *port, uint8 idx)
+{
+   uint8 *rxbuf;
+
+   /* UMEM frames must stay with their socket */
+   if ((port->stack.backend == &ecx_xdpbackend) ||
+       (port->redport->stack.backend == &ecx_xdpbackend))
+   {
+      memcpy(port->rxbuf[idx], port->redport->rxbuf[idx], port->txbuflength[idx] - ETH_HEADERSIZE);
+      return;
+   }
+   rxbuf = port->rxbuf[idx];
+   port->rxbuf[idx] = port->redport->rxbuf[idx];
+   port->redport->rxbuf[idx] = rxbuf;
+}
+
+/** Blocking redundant receive frame function. If redundant mode is not active then
+ * it skips the secondary stack and redundancy functions. In redundant mode it waits
+ * for both (primary and secondary) frames to come in. The result goes in an decision
+ * tree that decides, depending on the route of the packet and its possible missing arrival,
+ * how to reroute the original packet to get the data in an other try.
+ *
+ * Both stacks are waited on together. The repair resend over the secondary
+ * stack is issued as soon as the route of the frames shows a broken line. When
+ * only our dummy frame turned back on the secondary, the primary line gets
+ * half of the time left to return its frame before the frame is resent, at
+ * once if the primary line is known lost. The answer to a resend is waited
+ * for up to EC_TIMEOUTRET, even past the timer. A line that did not return
+ * any frame is remembered as lost and not waited for, until it returns a
+ * frame again.
+ *
+ * @param[in] port        = port context struct
+ * @param[in] idx = requested index of frame
+ * @param[in] timer = absolute timeout time
+ * @param[in] resend = FALSE to only merge the frames already stored, the
+ * sockets are not read and no repair resend is issued
+ * @return Workcounter if a frame is found with corresponding index, otherwise
+ * EC_NOFRAME.
+ */
+static int ecx_waitinframe_red(ecx_portt *port, uint8 idx, osal_timert *timer, int resend)
+{
+   int wkc  = EC_NOFRAME;
+   int wkc2 = EC_NOFRAME;
+   int primrx, secrx, lost, seen, ready, resent, done;
+   uint32 event;
+   int64 left;
+   osal_timert half, answer;
+   osal_timert *wait, *until;
+
+   /* if not in redundant mode then only the primary stack is read */
+   if (port->redstate == ECT_RED_NONE)
+   {
+      do
+      {
+         /* frames stored by a receiver thread after this end the wait below */
+         event = __atomic_load_n(&(port->rxevent[idx]), __ATOMIC_ACQUIRE);
+         wkc = ecx_inframe(port, idx, 0);
+         if (port->receiver)
+         {
+            if (wkc <= EC_NOFRAME)
             {
-               /* check if index exist and someone is waiting for it */
-               if (idxf < EC_MAXBUF && (*stack->rxbufstat)[idxf] == EC_BUF_TX)
-               {
-                  rxbuf = &(*stack->rxbuf)[idxf];
-                  /* put it in the buffer array (strip ethernet header) */
-                  memcpy(rxbuf, &(*stack->tempbuf)[ETH_HEADERSIZE], (*stack->txbuflength)[idxf] - ETH_HEADERSIZE);
-                  /* mark as received */
-                  (*stack->rxbufstat)[idxf] = EC_BUF_RCVD;
-                  (*stack->rxsa)[idxf] = ntohs(ehp->sa1);
-               }
-               else
-               {
-                  /* strange things happened */
-               }
+               ecx_waitevent(port, idx, event, timer);
+            }
+         }
+         /* nothing read, wait for the socket */
+         else if (wkc == EC_NOFRAME)
+         {
+            ecx_waitpkt(port, TRUE, FALSE, timer);
+         }
+      } while ((wkc <= EC_NOFRAME) && !osal_timer_is_expired(timer));
+
+      return wkc;
+   }
+   lost = __atomic_load_n(&(port->redlost), __ATOMIC_RELAXED);
+   /* the primary line may return its frame until half of the time is left */
+   left = ecx_timeleft(timer);
+   osal_timer_start(&half, (left > 0) ? (uint32)(left / 2000) : 0);
+   wait = timer;
+   /* primrx and secrx are the MAC source of the first frame on each socket */
+   primrx = 0;
+   secrx = 0;
+   seen = 0;
+   resent = FALSE;
+   /* sockets of ECT_WAIT_TIMEOUT block in receive calls, they are only read
+    * once they poll readable, frames stored by other threads are taken at once */
+   ready = EC_REDLINE_PRIMARY | EC_REDLINE_SECONDARY;
+   if (((port->waitmode == ECT_WAIT_TIMEOUT) && !port->receiver) || !resend)
+   {
+      ready = 0;
+   }
+   do
+   {
+      event = __atomic_load_n(&(port->rxevent[idx]), __ATOMIC_ACQUIRE);
+      /* only read frame if not already in */
+      if ((wkc <= EC_NOFRAME) &&
+          ((ready & EC_REDLINE_PRIMARY) ||
+           (__atomic_load_n(&(port->rxbufstat[idx]), __ATOMIC_ACQUIRE) == EC_BUF_RCVD)))
+      {
+         wkc = ecx_inframe(port, idx, 0);
+         if (wkc > EC_NOFRAME)
+         {
+            primrx = port->rxsa[idx];
+            seen |= EC_REDLINE_PRIMARY;
+         }
+      }
+      if ((wkc2 <= EC_NOFRAME) &&
+          ((ready & EC_REDLINE_SECONDARY) ||
+           (__atomic_load_n(&(port->redport->rxbufstat[idx]), __ATOMIC_ACQUIRE) == EC_BUF_RCVD)))
+      {
+         wkc2 = ecx_inframe(port, idx, 1);
+         if (wkc2 > EC_NOFRAME)
+         {
+            if (!(seen & EC_REDLINE_SECONDARY))
+            {
+               secrx = port->redport->rxsa[idx];
             }
+            seen |= EC_REDLINE_SECONDARY;
+            /* after the resend only its answer counts, not our dummy frame */
+            if (resent && (port->redport->rxsa[idx] != RX_PRIM))
+            {
+               wkc2 = EC_NOFRAME;
+            }
+         }
+      }
+      if (!resent && resend)
+      {
+         /* primary frame turned back at a broken line, pass it on through the
+          * secondary socket to the slaves behind the break. Without receiver
+          * threads this does not wait for our dummy frame, its late return is
+          * ignored above. */
+         if ((primrx == RX_PRIM) && !(lost & EC_REDLINE_SECONDARY) &&
+             ((secrx == RX_SEC) || ((secrx == 0) && !port->receiver)))
+         {
+            /* copy primary rx to tx buffer */
+            memcpy(&(port->txbuf[idx][ETH_HEADERSIZE]), port->rxbuf[idx], port->txbuflength[idx] - ETH_HEADERSIZE);
+            resent = TRUE;
+         }
+         /* primary line silent or lost, send the unprocessed frame through
+          * the secondary */
+         else if ((primrx == 0) && (secrx == RX_SEC) &&
+                  ((lost & EC_REDLINE_PRIMARY) || osal_timer_is_expired(&half)))
+         {
+            resent = TRUE;
+         }
+         if (resent)
+         {
+            /* resend secondary tx, its answer gets its own time */
+            ecx_outframe(port, idx, 1);
+            wkc2 = EC_NOFRAME;
+            osal_timer_start(&answer, EC_TIMEOUTRET);
+            wait = &answer;
+         }
+      }
+      if (resent)
+      {
+         done = (wkc2 > EC_NOFRAME);
+      }
+      else
+      {
+         /* both frames in, or the primary turned back and the secondary is lost */
+         done = ((wkc > EC_NOFRAME) && (wkc2 > EC_NOFRAME)) ||
+                ((primrx == RX_PRIM) && (lost & EC_REDLINE_SECONDARY));
+      }
+      if (!done && resend)
+      {
+         /* wake up for the resend if the primary stays silent */
+         until = wait;
+         if (!resent && resend && (primrx == 0) && (secrx == RX_SEC))
+         {
+            until = &half;
+         }
+         if (port->receiver)
+         {
+            ecx_waitevent(port, idx, event, until);
+         }
+         else
+         {
+            ready = ecx_pollred(port, (wkc <= EC_NOFRAME), (wkc2 <= EC_NOFRAME), until);
          }
       }
-      pthread_mutex_unlock( &(port->rx_mutex) );
-
+   /* wait for both frames to arrive or timeout */
+   } while (!done && resend && !osal_timer_is_expired(wait));
+   /* primary socket got secondary frame and secondary socket got primary frame,
+    * normal situation in redundant mode, or the resend was answered */
+   if ((wkc2 > EC_NOFRAME) && (resent || ((primrx == RX_SEC) && (secrx == RX_PRIM))))
+   {
+      /* move secondary buffer to primary */
+      ecx_takeredframe(port, idx);
+      wkc = wkc2;
+   }
+   /* remember lines that returned nothing while the other line was turned
+    * back, also when a resend covered them, ecx_recvpkt() forgets them with
+    * the next frame they return */
+   if (!(seen & EC_REDLINE_PRIMARY) && (secrx == RX_SEC))
+   {
+      __atomic_or_fetch(&(port->redlost), EC_REDLINE_PRIMARY, __ATOMIC_RELAXED);
+   }
+   if (!(seen & EC_REDLINE_SECONDARY) && (primrx == RX_PRIM))
+   {
+      __atomic_or_fetch(&(port->redlost), EC_REDLINE_SECONDARY, __ATOMIC_RELAXED);
    }
 
-   /* WKC if matching frame found */
-   return rval;
+   /* return WKC or EC_NOFRAME */
+   return wkc;
 }
 
-/** Blocking redundant receive frame function. If redundant mode is not active then
- * it skips the secondary stack and redundancy functions. In redundant mode it waits
- * for both (primary and secondary) frames to come in. The result goes in an decision
- * tree that decides, depending on the route of the packet and its possible missing arrival,
- * how to reroute the original packet to get the data in an other try.
- *
+/** Blocking receive frame function. Calls ec_waitinframe_red().
  * @param[in] port        = port context struct
- * @param[in] idx = requested index of frame
- * @param[in] timer = absolute timeout time
+ * @param[in] idx       = requested index of frame
+ * @param[in] timeout   = timeout in us
  * @return Workcounter if a frame is found with corresponding index, otherwise
  * EC_NOFRAME.
  */
-static int ecx_waitinframe_red(ecx_portt *port, uint8 idx, osal_timert *timer)
+int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout)
 {
-   osal_timert timer2;
-   int wkc  = EC_NOFRAME;
-   int wkc2 = EC_NOFRAME;
-   int primrx, secrx;
+   int wkc;
+   osal_timert timer;
 
-   /* if not in redundant mode then always assume secondary is OK */
-   if (port->redstate == ECT_RED_NONE)
-      wkc2 = 0;
-   do
+   osal_timer_start (&timer, timeout);
+   wkc = ecx_waitinframe_red(port, idx, &timer, TRUE);
+
+   return wkc;
+}
+
+/** Transmit several buffers over socket (non blocking). On a plain socket in
+ * single NIC mode all frames are handed to the kernel with one sendmmsg() call,
+ * otherwise they are transmitted one by one with ecx_outframe_red().
+ * @param[in] port        = port context struct
+ * @param[in] idx         = indexes in tx buffer array
+ * @param[in] n           = number of frames
+ * @return number of frames transmitted
+ */
+int ecx_outframe_red_batch(ecx_portt *port, const uint8 *idx, int n)
+{
+   struct mmsghdr msg[EC_MAXBATCH];
+   struct iovec iov[EC_MAXBATCH];
+   ec_etherheadert *ehp;
+   int i, chunk, rval, sent;
+
+   sent = 0;
+   if ((port->redstate != ECT_RED_NONE) || (port->stack.backend != &ecx_socketbackend))
    {
-      /* only read frame if not already in */
-      if (wkc <= EC_NOFRAME)
-         wkc  = ecx_inframe(port, idx, 0);
-      /* only try secondary if in redundant mode */
-      if (port->redstate != ECT_RED_NONE)
+      for (i = 0; i < n; i++)
       {
-         /* only read frame if not already in */
-         if (wkc2 <= EC_NOFRAME)
-            wkc2 = ecx_inframe(port, idx, 1);
+         if (ecx_outframe_red(port, idx[i]) >= 0)
+         {
+            sent++;
+         }
       }
-   /* wait for both frames to arrive or timeout */
-   } while (((wkc <= EC_NOFRAME) || (wkc2 <= EC_NOFRAME)) && !osal_timer_is_expired(timer));
-   /* only do redundant functions when in redundant mode */
+      return sent;
+   }
+   while (sent < n)
+   {
+      chunk = n - sent;
+      if (chunk > EC_MAXBATCH)
+      {
+         chunk = EC_MAXBATCH;
+      }
+      memset(msg, 0, sizeof(msg[0]) * chunk);
+      for (i = 0; i < chunk; i++)
+      {
+         ehp = (ec_etherheadert *)&(port->txbuf[idx[sent + i]]);
+         /* rewrite MAC source address 1 to primary */
+         ehp->sa1 = htons(priMAC[1]);
+         iov[i].iov_base = &(port->txbuf[idx[sent + i]]);
+         iov[i].iov_len = port->txbuflength[idx[sent + i]];
+         msg[i].msg_hdr.msg_iov = &iov[i];
+         msg[i].msg_hdr.msg_iovlen = 1;
+         port->rxbufstat[idx[sent + i]] = EC_BUF_TX;
+         port->txtime[idx[sent + i]] = 0;
+         port->rxtime[idx[sent + i]] = 0;
+         ecx_captureframe(port, 0, iov[i].iov_base, iov[i].iov_len, EC_PCAPNG_OUTBOUND);
+      }
+      rval = sendmmsg(port->sockhandle, msg, chunk, 0);
+      if (rval < 0)
+      {
+         rval = 0;
+      }
+      sent += rval;
+      if (rval < chunk)
+      {
+         break;
+      }
+   }
+   /* frames not handed to the kernel will never return, the indexes stay with
+    * the caller until it releases them */
+   for (i = sent; i < n; i++)
+   {
+      ecx_setbufstat(port, idx[i], EC_BUF_ALLOC);
+   }
+
+   return sent;
+}
+
+/** Blocking receive of several frames. In single NIC mode the socket is
+ * drained in batches until all requested frames are in or the timeout
+ * expires. In redundant mode the frames are received one by one with
+ * ecx_waitinframe().
+ * @param[in] port        = port context struct
+ * @param[in] idx         = requested indexes of frames
+ * @param[out] wkc        = per frame Workcounter, or EC_NOFRAME
+ * @param[in] n           = number of frames
+ * @param[in] timeout     = timeout in us for all frames
+ * @return number of frames received
+ */
+int ecx_waitinframe_batch(ecx_portt *port, const uint8 *idx, int *wkc, int n, int timeout)
+{
+   osal_timert timer;
+   int i, pending, first, tried;
+   uint32 event;
+
+   pending = n;
+   if (n <= 0)
+   {
+      return 0;
+   }
    if (port->redstate != ECT_RED_NONE)
    {
-      /* primrx if the received MAC source on primary socket */
-      primrx = 0;
-      if (wkc > EC_NOFRAME) primrx = port->rxsa[idx];
-      /* secrx if the received MAC source on psecondary socket */
-      secrx = 0;
-      if (wkc2 > EC_NOFRAME) secrx = port->redport->rxsa[idx];
+      for (i = 0; i < n; i++)
+      {
+         wkc[i] = ecx_waitinframe(port, idx[i], timeout);
+         if (wkc[i] > EC_NOFRAME)
+         {
+            pending--;
+         }
+      }
+      return n - pending;
+   }
+   for (i = 0; i < n; i++)
+   {
+      wkc[i] = EC_NOFRAME;
+   }
+   osal_timer_start(&timer, timeout);
+   first = 0;
+   tried = FALSE;
+   for (;;)
+   {
+      /* frames may have been stored by the receive of an other thread */
+      for (i = 0; i < n; i++)
+      {
+         if ((wkc[i] <= EC_NOFRAME) &&
+             (__atomic_load_n(&(port->rxbufstat[idx[i]]), __ATOMIC_ACQUIRE) == EC_BUF_RCVD))
+         {
+            /* frame is in buffer, ecx_inframe() only completes it */
+            wkc[i] = ecx_inframe(port, idx[i], 0);
+            pending--;
+         }
+      }
+      while ((first < n - 1) && (wkc[first] > EC_NOFRAME))
+      {
+         first++;
+      }
+      /* a receive is tried once even without time left */
+      if (!pending || (tried && osal_timer_is_expired(&timer)))
+      {
+         break;
+      }
+      tried = TRUE;
+      if (port->receiver)
+      {
+         /* wait for the first missing frame, the others are checked after */
+         event = __atomic_load_n(&(port->rxevent[idx[first]]), __ATOMIC_ACQUIRE);
+         if (__atomic_load_n(&(port->rxbufstat[idx[first]]), __ATOMIC_ACQUIRE) != EC_BUF_RCVD)
+         {
+            ecx_waitevent(port, idx[first], event, &timer);
+         }
+      }
+      else if (!ecx_drainframes(port))
+      {
+         ecx_waitpkt(port, TRUE, FALSE, &timer);
+      }
+   }
+
+   return n - pending;
+}
 
-      /* primary socket got secondary frame and secondary socket got primary frame */
-      /* normal situation in redundant mode */
-      if ( ((primrx == RX_SEC) && (secrx == RX_PRIM)) )
+/** Blocking receive of several frames with the data of the first datagram of
+ * each frame received in place. The frames are read in order, each straight
+ * into the rx buffer of its index, with the datagram data scattered into its
+ * target. A target must hold the data of the tx frame, as the IOmap does for
+ * an LRW of a not overlapping IOmap: when an other frame lands in its place
+ * the target is given back the tx data and the frame goes the usual way to
+ * its index. Without in place receive, see ecx_setzerocopy(), and in
+ * redundant mode, with receiver threads, timestamping or capture this is
+ * ecx_waitinframe_batch().
+ * @param[in] port        = port context struct
+ * @param[in] idx         = requested indexes of frames
+ * @param[in] target      = per frame buffer of datagram data, NULL to copy
+ * @param[in] length      = per frame length of datagram data
+ * @param[out] wkc        = per frame Workcounter, or EC_NOFRAME
+ * @param[out] placed     = per frame TRUE if the data is in target
+ * @param[in] n           = number of frames
+ * @param[in] timeout     = timeout in us for all frames
+ * @return number of frames received
+ */
+int ecx_waitinframe_scatter(ecx_portt *port, const uint8 *idx, uint8 * const *target,
+   const uint16 *length, int *wkc, boolean *placed, int n, int timeout)
+{
+   struct mmsghdr msg[EC_MAXBATCH];
+   struct iovec iov[EC_MAXBATCH][3];
+   int frameof[EC_MAXBATCH];
+   boolean misplaced[EC_MAXBATCH];
+   osal_timert timer;
+   ec_etherheadert *ehp;
+   ec_comt *ecp;
+   uint8 *head, *frame, *rxbuf;
+   int i, j, m, got, pending, len, part, tried;
+   int hdr = ETH_HEADERSIZE + EC_HEADERSIZE;
+
+   for (i = 0; i < n; i++)
+   {
+      placed[i] = FALSE;
+   }
+   if (!port->zerocopy || (port->redstate != ECT_RED_NONE) || port->receiver ||
+       port->tstamp || port->capture.active ||
+       (port->stack.backend != &ecx_socketbackend))
+   {
+      return ecx_waitinframe_batch(port, idx, wkc, n, timeout);
+   }
+   for (i = 0; i < n; i++)
+   {
+      wkc[i] = EC_NOFRAME;
+   }
+   pending = n;
+   tried = FALSE;
+   osal_timer_start(&timer, timeout);
+   while (pending)
+   {
+      /* frames stored by an other receive are only completed */
+      for (i = 0; i < n; i++)
+      {
+         if ((wkc[i] <= EC_NOFRAME) &&
+             (__atomic_load_n(&(port->rxbufstat[idx[i]]), __ATOMIC_ACQUIRE) == EC_BUF_RCVD))
+         {
+            wkc[i] = ecx_inframe(port, idx[i], 0);
+            pending--;
+         }
+      }
+      /* a receive is tried once even without time left */
+      if (!pending || (tried && osal_timer_is_expired(&timer)))
       {
-         /* copy secondary buffer to primary */
-         memcpy(&(port->rxbuf[idx]), &(port->redport->rxbuf[idx]), port->txbuflength[idx] - ETH_HEADERSIZE);
-         wkc = wkc2;
+         break;
       }
-      /* primary socket got nothing or primary frame, and secondary socket got secondary frame */
-      /* we need to resend TX packet */
-      if ( ((primrx == 0) && (secrx == RX_SEC)) ||
-           ((primrx == RX_PRIM) && (secrx == RX_SEC)) )
+      tried = TRUE;
+      /* one message per missing frame, in the order they were sent, more
+       * than EC_MAXBATCH are received by the next calls */
+      memset(msg, 0, sizeof(msg));
+      m = 0;
+      for (i = 0; (i < n) && (m < EC_MAXBATCH); i++)
       {
-         /* If both primary and secondary have partial connection retransmit the primary received
-          * frame over the secondary socket. The result from the secondary received frame is a combined
-          * frame that traversed all slaves in standard order. */
-         if ( (primrx == RX_PRIM) && (secrx == RX_SEC) )
+         if ((wkc[i] > EC_NOFRAME) || (port->rxbufstat[idx[i]] != EC_BUF_TX))
          {
-            /* copy primary rx to tx buffer */
-            memcpy(&(port->txbuf[idx][ETH_HEADERSIZE]), &(port->rxbuf[idx]), port->txbuflength[idx] - ETH_HEADERSIZE);
+            continue;
          }
-         osal_timer_start (&timer2, EC_TIMEOUTRET);
-         /* resend secondary tx */
-         ecx_outframe(port, idx, 1);
-         do
+         head = port->rxbuf[idx[i]] - ETH_HEADERSIZE;
+         iov[m][0].iov_base = head;
+         if (target[i] && length[i])
          {
-            /* retrieve frame */
-            wkc2 = ecx_inframe(port, idx, 1);
-         } while ((wkc2 <= EC_NOFRAME) && !osal_timer_is_expired(&timer2));
-         if (wkc2 > EC_NOFRAME)
+            iov[m][0].iov_len = hdr;
+            iov[m][1].iov_base = target[i];
+            iov[m][1].iov_len = length[i];
+            iov[m][2].iov_base = head + hdr + length[i];
+            iov[m][2].iov_len = sizeof(ec_bufT) - hdr - length[i];
+            msg[m].msg_hdr.msg_iovlen = 3;
+         }
+         else
+         {
+            iov[m][0].iov_len = sizeof(ec_bufT);
+            msg[m].msg_hdr.msg_iovlen = 1;
+         }
+         msg[m].msg_hdr.msg_iov = iov[m];
+         frameof[m++] = i;
+      }
+      if (!m)
+      {
+         /* nothing left to receive, frames were not sent */
+         break;
+      }
+      pthread_mutex_lock(&(port->rx_mutex));
+      got = recvmmsg(port->sockhandle, msg, m, MSG_WAITFORONE, NULL);
+      /* first check all, no rx buffer changes owner before */
+      for (j = 0; j < got; j++)
+      {
+         i = frameof[j];
+         head = iov[j][0].iov_base;
+         ehp = (ec_etherheadert *)head;
+         ecp = (ec_comt *)&head[ETH_HEADERSIZE];
+         len = msg[j].msg_len;
+         misplaced[j] = (len < port->txbuflength[idx[i]]) ||
+                        (ehp->etype != htons(ETH_P_ECAT)) ||
+                        (ecp->index != idx[i]) ||
+                        (ecp->command != port->txbuf[idx[i]][ETH_HEADERSIZE + EC_CMDOFFSET]);
+         if (misplaced[j])
+         {
+            /* put the other frame together in a spare */
+            frame = port->rxspare[j];
+            if (msg[j].msg_hdr.msg_iovlen == 3)
+            {
+               memcpy(frame, head, (len < hdr) ? len : hdr);
+               part = len - hdr;
+               if (part > length[i])
+               {
+                  part = length[i];
+               }
+               if (part > 0)
+               {
+                  memcpy(&frame[hdr], target[i], part);
+               }
+               part = len - hdr - length[i];
+               if (part > 0)
+               {
+                  memcpy(&frame[hdr + length[i]], &head[hdr + length[i]], part);
+               }
+               /* the target held the data of the tx frame */
+               memcpy(target[i], &(port->txbuf[idx[i]][hdr]), length[i]);
+            }
+            else
+            {
+               memcpy(frame, head, len);
+            }
+            continue;
+         }
+         ecx_captureframe(port, 0, head, len, EC_PCAPNG_INBOUND);
+         rxbuf = port->rxbuf[idx[i]];
+         part = etohs(ecp->elength) & 0x0fff;
+         wkc[i] = (rxbuf[part] + ((uint16)(rxbuf[part + 1]) << 8));
+         port->rxsa[idx[i]] = ntohs(ehp->sa1);
+         port->rxbufstat[idx[i]] = EC_BUF_COMPLETE;
+         placed[i] = (msg[j].msg_hdr.msg_iovlen == 3);
+         pending--;
+      }
+      /* other frames go to their index */
+      for (j = 0; j < got; j++)
+      {
+         if (misplaced[j])
          {
-            /* copy secondary result to primary rx buffer */
-            memcpy(&(port->rxbuf[idx]), &(port->redport->rxbuf[idx]), port->txbuflength[idx] - ETH_HEADERSIZE);
-            wkc = wkc2;
+            ecx_storeframe(&(port->stack), port->rxspare[j], &(port->rxspare[j]), -1);
          }
       }
+      pthread_mutex_unlock(&(port->rx_mutex));
+      if (got <= 0)
+      {
+         ecx_waitpkt(port, TRUE, FALSE, &timer);
+      }
    }
 
-   /* return WKC or EC_NOFRAME */
-   return wkc;
+   return n - pending;
 }
 
-/** Blocking receive frame function. Calls ec_waitinframe_red().
+/** Non blocking check for a frame stored by another receive, the cyclic
+ * receive or a receiver thread. Nothing is read from the sockets and in
+ * redundant mode the stored frames are merged without a repair resend.
  * @param[in] port        = port context struct
- * @param[in] idx       = requested index of frame
- * @param[in] timeout   = timeout in us
- * @return Workcounter if a frame is found with corresponding index, otherwise
- * EC_NOFRAME.
+ * @param[in] idx         = requested index of frame
+ * @param[in] timer       = absolute timeout time of frame
+ * @return Workcounter, EC_NOFRAME when timer expired without frame or
+ * EC_PENDING when the frame may still come
  */
-int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout)
+int ecx_pollinframe(ecx_portt *port, uint8 idx, osal_timert *timer)
 {
-   int wkc;
-   osal_timert timer;
+   boolean ready;
 
-   osal_timer_start (&timer, timeout);
-   wkc = ecx_waitinframe_red(port, idx, &timer);
+   ready = (__atomic_load_n(&(port->rxbufstat[idx]), __ATOMIC_ACQUIRE) == EC_BUF_RCVD);
+   if (ready && (port->redstate != ECT_RED_NONE))
+   {
+      ready = (__atomic_load_n(&(port->redport->rxbufstat[idx]), __ATOMIC_ACQUIRE) == EC_BUF_RCVD);
+   }
+   if (!ready && !osal_timer_is_expired(timer))
+   {
+      return EC_PENDING;
+   }
+   if (port->redstate != ECT_RED_NONE)
+   {
+      /* merge primary and secondary, a frame of one line only is also used */
+      return ecx_waitinframe_red(port, idx, timer, FALSE);
+   }
+   /* frame is in buffer, ecx_inframe() only completes it */
+   return ready ? ecx_inframe(port, idx, 0) : EC_NOFRAME;
+}
 
-   return wkc;
+/** Receiver thread body, reads all frames of one socket and stores them in
+ * the rx buffers of their index.
+ * @param[in] port        = port context struct
+ * @param[in] stacknumber = 0=primary 1=secondary stack
+ */
+static void ecx_receiver(ecx_portt *port, int stacknumber)
+{
+   const struct timespec pollwait = { 0, EC_RECEIVERPOLL * 1000 };
+   struct pollfd pfd;
+   ec_stackT *stack;
+   ec_etherheadert *ehp;
+   ec_comt *ecp;
+   uint8 *frame;
+   uint8 idxf;
+
+   if (!stacknumber)
+   {
+      stack = &(port->stack);
+   }
+   else
+   {
+      stack = &(port->redport->stack);
+   }
+   pfd.fd = *stack->sock;
+   pfd.events = POLLIN;
+   while (__atomic_load_n(&(port->receiver), __ATOMIC_ACQUIRE))
+   {
+      if (ecx_recvpkt(port, stacknumber, &frame))
+      {
+         ecx_storeframe(stack, frame, ecx_recvspare(stack), -1);
+         ehp = (ec_etherheadert *)frame;
+         ecp = (ec_comt *)&frame[ETH_HEADERSIZE];
+         idxf = ecp->index;
+         ecx_releasepkt(stack);
+         if ((ehp->etype == htons(ETH_P_ECAT)) && (idxf < port->maxbuf))
+         {
+            /* wake threads waiting for this index */
+            __atomic_add_fetch(&(port->rxevent[idxf]), 1, __ATOMIC_RELEASE);
+            syscall(SYS_futex, &(port->rxevent[idxf]), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+         }
+      }
+      else
+      {
+         /* sleep until the next frame, wake up now and then to see a stop */
+         ppoll(&pfd, 1, &pollwait, NULL);
+      }
+   }
+}
+
+static void *ecx_receiver_primary(void *arg)
+{
+   ecx_receiver((ecx_portt *)arg, 0);
+   return NULL;
+}
+
+static void *ecx_receiver_secondary(void *arg)
+{
+   ecx_receiver((ecx_portt *)arg, 1);
+   return NULL;
+}
+
+/** Start receiver threads of port, one per socket. From then on only the
+ * receiver threads read the sockets, waiting threads sleep until their frame
+ * is stored. Call after the NIC(s) are set up.
+ * @param[in] port        = port context struct
+ * @return >0 if succeeded
+ */
+int ecx_startreceiver(ecx_portt *port)
+{
+   if (port->receiver)
+   {
+      return 1;
+   }
+   __atomic_store_n(&(port->receiver), TRUE, __ATOMIC_RELEASE);
+   if (!osal_thread_create_rt(&(port->rxthread[0]), EC_RECEIVERSTACK,
+                              ecx_receiver_primary, port))
+   {
+      port->receiver = FALSE;
+      return 0;
+   }
+   if ((port->redstate != ECT_RED_NONE) &&
+       !osal_thread_create_rt(&(port->rxthread[1]), EC_RECEIVERSTACK,
+                              ecx_receiver_secondary, port))
+   {
+      __atomic_store_n(&(port->receiver), FALSE, __ATOMIC_RELEASE);
+      pthread_join(port->rxthread[0], NULL);
+      return 0;
+   }
+
+   return 1;
+}
+
+/** Stop receiver threads of port, waiting threads read the sockets again.
+ * @param[in] port        = port context struct
+ */
+void ecx_stopreceiver(ecx_portt *port)
+{
+   if (!port->receiver)
+   {
+      return;
+   }
+   __atomic_store_n(&(port->receiver), FALSE, __ATOMIC_RELEASE);
+   pthread_join(port->rxthread[0], NULL);
+   if (port->redstate != ECT_RED_NONE)
+   {
+      pthread_join(port->rxthread[1], NULL);
+   }
 }
 
 /** Blocking send and receive frame function. Used for non processdata frames.
@@ -590,7 +4013,7 @@ int ecx_srconfirm(ecx_portt *port, uint8 idx, int timeout)
          osal_timer_start (&timer2, EC_TIMEOUTRET);
       }
       /* get frame from primary or if in redundant mode possibly from secondary */
-      wkc = ecx_waitinframe_red(port, idx, &timer2);
+      wkc = ecx_waitinframe_red(port, idx, &timer2, TRUE);
    /* wait for answer with WKC>=0 or otherwise retry until timeout */
    } while ((wkc <= EC_NOFRAME) && !osal_timer_is_expired (&timer1));
 
@@ -603,6 +4026,71 @@ int ec_setupnic(const char *ifname, int secondary)
    return ecx_setupnic(&ecx_port, ifname, secondary);
 }
 
+int ec_setupnic_transport(const char *ifname, int secondary, int transport)
+{
+   return ecx_setupnic_transport(&ecx_port, ifname, secondary, transport);
+}
+
+int ec_setupnic_backend(const char *ifname, int secondary, const ec_backendT *backend)
+{
+   return ecx_setupnic_backend(&ecx_port, ifname, secondary, backend);
+}
+
+int ec_setwaitmode(int waitmode)
+{
+   return ecx_setwaitmode(&ecx_port, waitmode);
+}
+
+int ec_getfilterstats(uint64 *own, uint64 *malformed)
+{
+   return ecx_getfilterstats(&ecx_port, own, malformed);
+}
+
+int ec_settimestamping(int mode)
+{
+   return ecx_settimestamping(&ecx_port, mode);
+}
+
+int ec_setzerocopy(int enable)
+{
+   return ecx_setzerocopy(&ecx_port, enable);
+}
+
+int ec_getframetime(uint8 idx, int64 *txtime, int64 *rxtime)
+{
+   return ecx_getframetime(&ecx_port, idx, txtime, rxtime);
+}
+
+int ec_startcapture(const char *filename, size_t size)
+{
+   return ecx_startcapture(&ecx_port, filename, size);
+}
+
+int ec_stopcapture(void)
+{
+   return ecx_stopcapture(&ecx_port);
+}
+
+int ec_getcapturestats(uint64 *frames, uint64 *overwritten, uint64 *dropped)
+{
+   return ecx_getcapturestats(&ecx_port, frames, overwritten, dropped);
+}
+
+int ec_startreceiver(void)
+{
+   return ecx_startreceiver(&ecx_port);
+}
+
+void ec_stopreceiver(void)
+{
+   ecx_stopreceiver(&ecx_port);
+}
+
+int ec_setmaxbuf(int maxbuf)
+{
+   return ecx_setmaxbuf(&ecx_port, maxbuf);
+}
+
 int ec_closenic(void)
 {
    return ecx_closenic(&ecx_port);
@@ -18,23 +18,214 @@ extern "C"
 
 #include <pthread.h>
 
+/** number of 64 bit words in the free index bitmap */
+#define EC_MAXMASK         ((EC_MAXSLOTS + 63) / 64)
+
+/** max. number of frames per sendmmsg() and recvmmsg() call, and number of
+ * spare rx frames per port. Independent of the number of buffers set with
+ * ecx_setmaxbuf(), larger batches are sent and received in several calls. */
+#define EC_MAXBATCH        EC_MAXBUF
+
+/** NIC transports, selected with ecx_setupnic_transport() */
+enum
+{
+   /** RAW socket, one send() and recv() call per frame */
+   ECT_TRANSPORT_SOCKET,
+   /** RAW socket with memory mapped PACKET_RX_RING and PACKET_TX_RING */
+   ECT_TRANSPORT_MMAP,
+   /** AF_XDP socket, EtherCAT frames are redirected by an XDP program */
+   ECT_TRANSPORT_XDP,
+   /** in-process loopback, every frame sent is received unchanged, no NIC */
+   ECT_TRANSPORT_LOOPBACK,
+   /** replay of a pcapng capture, ifname is the capture file, no NIC */
+   ECT_TRANSPORT_REPLAY
+};
+
+/** Socket filter drop counters, read with ecx_getfilterstats() */
+enum
+{
+   /** our own outgoing frames */
+   ECT_FILTER_OWN,
+   /** frames too short or with inconsistent EtherCAT header */
+   ECT_FILTER_MALFORMED,
+   ECT_FILTER_COUNTERS
+};
+
+/** Frame wait modes, selected with ecx_setwaitmode() */
+enum
+{
+   /** spin on receive calls with a 1us socket receive timeout (default) */
+   ECT_WAIT_TIMEOUT,
+   /** non blocking receive calls, kernel busy polls the NIC queue */
+   ECT_WAIT_BUSYPOLL,
+   /** sleep in ppoll() until a frame arrives or the deadline expires */
+   ECT_WAIT_BLOCK
+};
+
+/** Packet timestamping modes, selected with ecx_settimestamping() */
+enum
+{
+   /** no timestamps (default) */
+   ECT_TSTAMP_OFF,
+   /** kernel software timestamps at driver transmit and receive */
+   ECT_TSTAMP_SOFTWARE,
+   /** NIC hardware timestamps, the NIC must support them */
+   ECT_TSTAMP_HARDWARE
+};
+
+/** memory mapped rx and tx ring of a socket */
+typedef struct
+{
+   /** mapped area, rx ring followed by tx ring */
+   uint8       *map;
+   /** length of mapped area */
+   size_t      maplen;
+   /** first frame of rx ring */
+   uint8       *rxring;
+   /** first frame of tx ring */
+   uint8       *txring;
+   /** number of frames in rx ring */
+   int         rxframes;
+   /** number of frames in tx ring */
+   int         txframes;
+   /** next rx ring frame to be read */
+   int         rxhead;
+   /** next tx ring frame to be filled */
+   int         txhead;
+   /** serialises tx ring access */
+   pthread_mutex_t tx_mutex;
+} ec_ringT;
+
+/** AF_XDP single producer single consumer ring, mapped from the kernel */
+typedef struct
+{
+   /** producer index */
+   uint32      *producer;
+   /** consumer index */
+   uint32      *consumer;
+   /** ring entries, uint64 UMEM addresses or struct xdp_desc */
+   void        *desc;
+   /** number of entries - 1 */
+   uint32      mask;
+   /** mapped area */
+   void        *map;
+   /** length of mapped area */
+   size_t      maplen;
+} ec_xskringT;
+
+/** AF_XDP socket with UMEM, XDP program and rings */
+typedef struct
+{
+   /** AF_XDP socket */
+   int         fd;
+   /** XSKMAP holding the socket */
+   int         mapfd;
+   /** XDP program redirecting EtherCAT frames to the socket */
+   int         progfd;
+   /** link attaching the program to the NIC */
+   int         linkfd;
+   /** UMEM area, rx frames of the indexes and the fill ring, tx frames and
+    * the tx buffers of the port */
+   uint8       *umem;
+   /** length of UMEM area */
+   size_t      umemlen;
+   /** first tx frame in UMEM */
+   uint32      txfirst;
+   /** tx buffers of the port in UMEM, NULL if they are not placed here */
+   ec_bufT     *txbuf;
+   /** length of tx buffers */
+   size_t      txlen;
+   /** heap tx buffers of the port, given back on close */
+   ec_bufT     *txheap;
+   /** page offset mask if bound in zero-copy mode, a tx frame in the tx
+    * buffers must not cross a page then, 0 in copy mode */
+   uint64      pagemask;
+   /** frame of the last receive, goes to the fill ring on release unless
+    * swapped with the rx buffer of an index */
+   uint8       *rxspare;
+   /** rx ring */
+   ec_xskringT rx;
+   /** tx ring */
+   ec_xskringT tx;
+   /** fill ring, free UMEM frames for rx */
+   ec_xskringT fill;
+   /** completion ring, transmitted UMEM frames */
+   ec_xskringT comp;
+   /** tx frames handed to the kernel */
+   uint32      txsent;
+   /** tx frames completed by the kernel */
+   uint32      txdone;
+   /** per tx buffer in UMEM, frames sent from it and not completed yet */
+   uint8       txbusy[EC_MAXSLOTS];
+   /** serialises tx ring access */
+   pthread_mutex_t tx_mutex;
+} ec_xskT;
+
+/** pcapng capture ring of a port, see ecx_startcapture() */
+typedef struct
+{
+   /** capture file */
+   int         fd;
+   /** mapped capture file */
+   uint8       *map;
+   /** length of mapped file */
+   size_t      maplen;
+   /** offset of first packet block, after section and interface blocks */
+   size_t      start;
+   /** offset of next packet block */
+   size_t      head;
+   /** offset of oldest packet block */
+   size_t      tail;
+   /** end of the blocks behind head, valid if wrapped */
+   size_t      end;
+   /** head wrapped to start, the oldest blocks are behind head */
+   int         wrapped;
+   /** capture running, frames are written */
+   int         active;
+   /** spinlock of the writing threads */
+   int         lock;
+   /** packet blocks in ring */
+   uint64      frames;
+   /** packet blocks overwritten by newer ones */
+   uint64      overwritten;
+   /** frames not captured because the ring was busy */
+   uint64      dropped;
+} ec_captureT;
+
+/** NIC backend operations, see struct ec_backend */
+typedef struct ec_backend ec_backendT;
+
 /** pointer structure to Tx and Rx stacks */
 typedef struct
 {
-   /** socket connection used */
+   /** NIC backend of stack */
+   const ec_backendT *backend;
+   /** private data of backend */
+   void        *backenddata;
+   /** socket connection used, polls readable when a frame can be received */
    int         *sock;
+   /** memory mapped ring, used by the mmap backend */
+   ec_ringT    *ring;
+   /** AF_XDP socket, used by the xdp backend */
+   ec_xskT     *xsk;
+   /** drop counters of socket filter, -1 if not available */
+   int         *filtermapfd;
+   /** number of frame buffers */
+   int         *maxbuf;
    /** tx buffer */
-   ec_bufT     (*txbuf)[EC_MAXBUF];
+   ec_bufT     **txbuf;
    /** tx buffer lengths */
-   int         (*txbuflength)[EC_MAXBUF];
-   /** temporary receive buffer */
-   ec_bufT     *tempbuf;
+   int         **txbuflength;
+   /** free frame buffers, received into and swapped into rx buffers */
+   uint8       **rxspare;
    /** rx buffers */
-   ec_bufT     (*rxbuf)[EC_MAXBUF];
+   uint8       ***rxbuf;
    /** rx buffer status fields */
-   int         (*rxbufstat)[EC_MAXBUF];
+   int         **rxbufstat;
    /** received MAC source address (middle word) */
-   int         (*rxsa)[EC_MAXBUF];
+   int         **rxsa;
+   /** primary stack, the backend may place the tx buffers in its memory */
+   int         primary;
 } ec_stackT;
 
 /** pointer structure to buffers for redundant port */
@@ -42,14 +233,22 @@ typedef struct
 {
    ec_stackT   stack;
    int         sockhandle;
-   /** rx buffers */
-   ec_bufT rxbuf[EC_MAXBUF];
+   /** memory mapped ring, used with ECT_TRANSPORT_MMAP */
+   ec_ringT    ring;
+   /** AF_XDP socket, used with ECT_TRANSPORT_XDP */
+   ec_xskT     xsk;
+   /** drop counters of socket filter, -1 if not available */
+   int         filtermapfd;
+   /** rx frame buffers incl. ethernet header, allocated at setup */
+   ec_bufT *rxpool;
+   /** rx buffers, EtherCAT part of the pool frame owned by each index */
+   uint8 **rxbuf;
    /** rx buffer status */
-   int rxbufstat[EC_MAXBUF];
+   int *rxbufstat;
    /** rx MAC source address */
-   int rxsa[EC_MAXBUF];
-   /** temporary rx buffer */
-   ec_bufT tempinbuf;
+   int *rxsa;
+   /** pool frames not owned by an index, frames are received into these */
+   uint8 *rxspare[EC_MAXBATCH];
 } ecx_redportt;
 
 /** pointer structure to buffers, vars and mutexes for port instantiation */
@@ -57,43 +256,120 @@ typedef struct
 {
    ec_stackT   stack;
    int         sockhandle;
-   /** rx buffers */
-   ec_bufT rxbuf[EC_MAXBUF];
+   /** memory mapped ring, used with ECT_TRANSPORT_MMAP */
+   ec_ringT    ring;
+   /** AF_XDP socket, used with ECT_TRANSPORT_XDP */
+   ec_xskT     xsk;
+   /** drop counters of socket filter, -1 if not available */
+   int         filtermapfd;
+   /** rx frame buffers incl. ethernet header, allocated at setup */
+   ec_bufT *rxpool;
+   /** rx buffers, EtherCAT part of the pool frame owned by each index */
+   uint8 **rxbuf;
    /** rx buffer status */
-   int rxbufstat[EC_MAXBUF];
+   int *rxbufstat;
    /** rx MAC source address */
-   int rxsa[EC_MAXBUF];
-   /** temporary rx buffer */
-   ec_bufT tempinbuf;
+   int *rxsa;
+   /** pool frames not owned by an index, frames are received into these */
+   uint8 *rxspare[EC_MAXBATCH];
    /** temporary rx buffer status */
    int tempinbufs;
-   /** transmit buffers */
-   ec_bufT txbuf[EC_MAXBUF];
+   /** transmit buffers, allocated at setup */
+   ec_bufT *txbuf;
    /** transmit buffer lengths */
-   int txbuflength[EC_MAXBUF];
+   int *txbuflength;
+   /** number of frame buffers, set with ecx_setmaxbuf() before setup */
+   int maxbuf;
    /** temporary tx buffer */
    ec_bufT txbuf2;
    /** temporary tx buffer length */
    int txbuflength2;
    /** last used frame index */
    uint8 lastidx;
+   /** free frame indexes, bit set if index is free, updated with CAS */
+   uint64 freemask[EC_MAXMASK];
    /** current redundancy state */
    int redstate;
+   /** lines of redundant port that returned no frame, not waited for */
+   int redlost;
+   /** frame wait mode, applies to primary and secondary socket */
+   int waitmode;
+   /** receiver threads running, see ecx_startreceiver() */
+   int receiver;
+   /** receiver thread of primary and secondary socket */
+   pthread_t rxthread[2];
+   /** per index count of frames stored by the receiver, futex of waiters */
+   uint32 rxevent[EC_MAXSLOTS];
+   /** packet timestamping of primary socket, see ecx_settimestamping() */
+   int tstamp;
+   /** process data received in place, see ecx_setzerocopy() */
+   int zerocopy;
+   /** per index transmit timestamp in ns, 0 if not known */
+   int64 txtime[EC_MAXSLOTS];
+   /** per index receive timestamp in ns, 0 if not known */
+   int64 rxtime[EC_MAXSLOTS];
+   /** pcapng capture of all frames, see ecx_startcapture() */
+   ec_captureT capture;
+   /** asynchronous datagrams, see ecx_startdatagram() */
+   ec_asyncT async[EC_MAXASYNC];
+   /** number of asynchronous datagrams not completed */
+   int asynccount;
    /** pointer to redundancy port and buffers */
    ecx_redportt *redport;
-   pthread_mutex_t getindex_mutex;
    pthread_mutex_t tx_mutex;
    pthread_mutex_t rx_mutex;
 } ecx_portt;
 
+/** NIC backend. A backend moves complete frames incl. ethernet header between
+ * a stack and the NIC, the port keeps the frame buffers, indexes, waiting and
+ * redundancy for all backends. Selected per stack at setup, see
+ * ecx_setupnic_backend().
+ */
+struct ec_backend
+{
+   /** name of backend */
+   const char  *name;
+   /** open NIC ifname for stack. *stack->sock must be a descriptor that polls
+    * readable when a frame can be received. Return >0 if succeeded. */
+   int         (*setup)(ec_stackT *stack, const char *ifname);
+   /** close what setup opened, also after a failed setup */
+   void        (*close)(ec_stackT *stack);
+   /** transmit frame without waiting for completion, return length or -1 */
+   int         (*send)(ec_stackT *stack, const void *frame, int length);
+   /** receive one frame without blocking longer than the wait mode of the
+    * port allows, return length, >0 if *frame points at the frame */
+   int         (*recv)(ecx_portt *port, ec_stackT *stack, uint8 **frame);
+   /** hand frame of recv back to the backend, NULL if recv receives into
+    * stack->rxspare[0] so that the frame can be swapped into place */
+   void        (*release)(ec_stackT *stack);
+};
+
 extern const uint16 priMAC[3];
 extern const uint16 secMAC[3];
+extern const ec_backendT ecx_socketbackend;
+extern const ec_backendT ecx_mmapbackend;
+extern const ec_backendT ecx_xdpbackend;
+extern const ec_backendT ecx_loopbackend;
+extern const ec_backendT ecx_replaybackend;
 
 #ifdef EC_VER1
 extern ecx_portt     ecx_port;
 extern ecx_redportt  ecx_redport;
 
 int ec_setupnic(const char * ifname, int secondary);
+int ec_setupnic_transport(const char * ifname, int secondary, int transport);
+int ec_setupnic_backend(const char * ifname, int secondary, const ec_backendT *backend);
+int ec_setmaxbuf(int maxbuf);
+int ec_setwaitmode(int waitmode);
+int ec_getfilterstats(uint64 *own, uint64 *malformed);
+int ec_settimestamping(int mode);
+int ec_setzerocopy(int enable);
+int ec_getframetime(uint8 idx, int64 *txtime, int64 *rxtime);
+int ec_startcapture(const char *filename, size_t size);
+int ec_stopcapture(void);
+int ec_getcapturestats(uint64 *frames, uint64 *overwritten, uint64 *dropped);
+int ec_startreceiver(void);
+void ec_stopreceiver(void);
 int ec_closenic(void);
 void ec_setbufstat(uint8 idx, int bufstat);
 uint8 ec_getindex(void);
@@ -105,12 +381,30 @@ int ec_srconfirm(uint8 idx,int timeout);
 
 void ec_setupheader(void *p);
 int ecx_setupnic(ecx_portt *port, const char * ifname, int secondary);
+int ecx_setupnic_transport(ecx_portt *port, const char * ifname, int secondary, int transport);
+int ecx_setupnic_backend(ecx_portt *port, const char * ifname, int secondary, const ec_backendT *backend);
+int ecx_setmaxbuf(ecx_portt *port, int maxbuf);
+int ecx_setwaitmode(ecx_portt *port, int waitmode);
+int ecx_getfilterstats(ecx_portt *port, uint64 *own, uint64 *malformed);
+int ecx_settimestamping(ecx_portt *port, int mode);
+int ecx_setzerocopy(ecx_portt *port, int enable);
+int ecx_getframetime(ecx_portt *port, uint8 idx, int64 *txtime, int64 *rxtime);
+int ecx_startcapture(ecx_portt *port, const char *filename, size_t size);
+int ecx_stopcapture(ecx_portt *port);
+int ecx_getcapturestats(ecx_portt *port, uint64 *frames, uint64 *overwritten, uint64 *dropped);
+int ecx_startreceiver(ecx_portt *port);
+void ecx_stopreceiver(ecx_portt *port);
 int ecx_closenic(ecx_portt *port);
 void ecx_setbufstat(ecx_portt *port, uint8 idx, int bufstat);
 uint8 ecx_getindex(ecx_portt *port);
 int ecx_outframe(ecx_portt *port, uint8 idx, int sock);
 int ecx_outframe_red(ecx_portt *port, uint8 idx);
+int ecx_outframe_red_batch(ecx_portt *port, const uint8 *idx, int n);
 int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout);
+int ecx_waitinframe_batch(ecx_portt *port, const uint8 *idx, int *wkc, int n, int timeout);
+int ecx_waitinframe_scatter(ecx_portt *port, const uint8 *idx, uint8 * const *target,
+   const uint16 *length, int *wkc, boolean *placed, int n, int timeout);
+int ecx_pollinframe(ecx_portt *port, uint8 idx, osal_timert *timer);
 int ecx_srconfirm(ecx_portt *port, uint8 idx,int timeout);
 
 #ifdef __cplusplus
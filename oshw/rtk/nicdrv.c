@@ -131,6 +131,8 @@ int ecx_setupnic(ecx_portt *port, const char *ifname, int secondary)
       port->sockhandle        = -1;
       port->lastidx           = 0;
       port->redstate          = ECT_RED_NONE;
+      memset(port->async, 0, sizeof(port->async));
+      port->asynccount = 0;
       port->stack.sock        = &(port->sockhandle);
       port->stack.txbuf       = &(port->txbuf);
       port->stack.txbuflength = &(port->txbuflength);
@@ -545,6 +547,125 @@ int ecx_waitinframe(ecx_portt *port, uint8 idx, int timeout)
    return wkc;
 }
 
+/** Transmit several buffers over socket (non blocking).
+ * @param[in] port        = port context struct
+ * @param[in] idx         = indexes in tx buffer array
+ * @param[in] n           = number of frames
+ * @return number of frames transmitted
+ */
+int ecx_outframe_red_batch(ecx_portt *port, const uint8 *idx, int n)
+{
+   int i, sent;
+
+   sent = 0;
+   for (i = 0; i < n; i++)
+   {
+      if (ecx_outframe_red(port, idx[i]) >= 0)
+      {
+         sent++;
+      }
+   }
+
+   return sent;
+}
+
+/** Blocking receive of several frames.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = requested indexes of frames
+ * @param[out] wkc        = per frame Workcounter, or EC_NOFRAME
+ * @param[in] n           = number of frames
+ * @param[in] timeout     = timeout in us
+ * @return number of frames received
+ */
+int ecx_waitinframe_batch(ecx_portt *port, const uint8 *idx, int *wkc, int n, int timeout)
+{
+   int i, received;
+
+   received = 0;
+   for (i = 0; i < n; i++)
+   {
+      wkc[i] = ecx_waitinframe(port, idx[i], timeout);
+      if (wkc[i] > EC_NOFRAME)
+      {
+         received++;
+      }
+   }
+
+   return received;
+}
+
+/** Blocking receive of several frames. This driver has no in place receive,
+ * the frames are received with ecx_waitinframe_batch() and the data stays in
+ * the rx buffers.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = requested indexes of frames
+ * @param[in] target      = per frame buffer of datagram data, not used
+ * @param[in] length      = per frame length of datagram data, not used
+ * @param[out] wkc        = per frame Workcounter, or EC_NOFRAME
+ * @param[out] placed     = per frame FALSE, the data is not in target
+ * @param[in] n           = number of frames
+ * @param[in] timeout     = timeout in us for all frames
+ * @return number of frames received
+ */
+int ecx_waitinframe_scatter(ecx_portt *port, const uint8 *idx, uint8 * const *target,
+   const uint16 *length, int *wkc, boolean *placed, int n, int timeout)
+{
+   int i;
+
+   (void)target;
+   (void)length;
+   for (i = 0; i < n; i++)
+   {
+      placed[i] = FALSE;
+   }
+
+   return ecx_waitinframe_batch(port, idx, wkc, n, timeout);
+}
+
+/** Non blocking receive of the frame of an asynchronous datagram. The
+ * socket is read once for it, see ecx_inframe(). In redundant mode the
+ * frames of both lines are waited for until timer expires.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = requested index of frame
+ * @param[in] timer       = absolute timeout time of frame
+ * @return Workcounter, EC_NOFRAME when timer expired without frame or
+ * EC_PENDING when the frame may still come
+ */
+int ecx_pollinframe(ecx_portt *port, uint8 idx, osal_timert *timer)
+{
+   int wkc;
+
+   if (port->redstate != ECT_RED_NONE)
+   {
+      return ecx_waitinframe_red(port, idx, *timer);
+   }
+   wkc = ecx_inframe(port, idx, 0);
+   if (wkc > EC_NOFRAME)
+   {
+      return wkc;
+   }
+
+   return osal_timer_is_expired(timer) ? EC_NOFRAME : EC_PENDING;
+}
+
+/** Read the timestamps of the last frame transmitted with index. This driver
+ * has no frame timestamps.
+ * @param[in] port        = port context struct
+ * @param[in] idx         = index of frame
+ * @param[out] txtime     = transmit timestamp in ns, 0
+ * @param[out] rxtime     = receive timestamp in ns, 0
+ * @return 0, the timestamps are not known
+ */
+int ecx_getframetime(ecx_portt *port, uint8 idx, int64 *txtime, int64 *rxtime)
+{
+   (void)port;
+   (void)idx;
+   *txtime = 0;
+   *rxtime = 0;
+
+   return 0;
+}
+
 /** Blocking send and receive frame function. Used for non processdata frames.
  * A datagram is build into a frame and transmitted via this function. It waits
  * for an answer and returns the workcounter. The function retries if time is
@@ -21,6 +21,8 @@
 #include "ethercatsoe.h"
 #include "ethercateoe.h"
 #include "ethercatconfig.h"
+#include "ethercatcyclic.h"
+#include "ethercatpdo.h"
 #include "ethercatprint.h"
 
 #endif /* _EC_ETHERCAT_H */
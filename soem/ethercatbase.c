@@ -12,6 +12,11 @@
  * logical addressed data transfers. All base transfers are blocking, so
  * wait for the frame to be returned to the master or timeout. If this is
  * not acceptable build your own datagrams and use the functions from nicdrv.c.
+ *
+ * Independent transfers can be collected in a datagram queue with
+ * ecx_queuedatagram(). ecx_senddatagrams() packs them in as few frames as
+ * possible, sends the frames together and scatters the results back to the
+ * databuffers of the datagrams, one round trip instead of one per datagram.
  */
 
 #include <stdio.h>
@@ -535,6 +540,379 @@ int ecx_LRWDC(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, uint16
    return wkc;
 }
 
+/** Check if a command returns data read from the slaves.
+ *
+ * @param[in]  com        = command
+ * @return TRUE if the datagram data of the answer is to be copied back
+ */
+static boolean ecx_readsback(uint8 com)
+{
+   switch (com)
+   {
+      case EC_CMD_NOP:
+         /* Fall-through */
+      case EC_CMD_APWR:
+         /* Fall-through */
+      case EC_CMD_FPWR:
+         /* Fall-through */
+      case EC_CMD_BWR:
+         /* Fall-through */
+      case EC_CMD_LWR:
+         return FALSE;
+      default:
+         return TRUE;
+   }
+}
+
+/** Initialise an empty datagram queue.
+ *
+ * @param[out] queue      = datagram queue
+ */
+void ecx_initdatagrams(ec_dgqueuet *queue)
+{
+   queue->n = 0;
+}
+
+/** Add a datagram to a datagram queue. The databuffer is read when the queue
+ * is sent and must stay valid until ecx_senddatagrams() returns, read and
+ * read/write commands fill it with the data returned by the slaves. For
+ * logical commands ADP and ADO are LO_WORD(LogAdr) and HI_WORD(LogAdr).
+ *
+ * @param[in,out] queue   = datagram queue
+ * @param[in]  com        = command, EC_CMD_xxx
+ * @param[in]  ADP        = Address Position
+ * @param[in]  ADO        = Address Offset
+ * @param[in]  length     = length of databuffer, up to EC_MAXLRWDATA
+ * @param[in,out] data    = databuffer of datagram
+ * @return number of the datagram in the queue, or -1 if queue is full
+ */
+int ecx_queuedatagram(ec_dgqueuet *queue, uint8 com, uint16 ADP, uint16 ADO, uint16 length, void *data)
+{
+   ec_dgqueueentryt *entry;
+
+   if ((queue->n >= EC_MAXDGQUEUE) || (length > EC_MAXLRWDATA))
+   {
+      return -1;
+   }
+   entry = &(queue->entry[queue->n]);
+   entry->com = com;
+   entry->ADP = ADP;
+   entry->ADO = ADO;
+   entry->length = length;
+   entry->data = data;
+   entry->wkc = EC_NOFRAME;
+   entry->rxpos = 0;
+
+   return queue->n++;
+}
+
+/** Pack datagrams of a queue in a frame, as many as fit in one frame.
+ *
+ * @param[in] port        = port context struct
+ * @param[in,out] queue   = datagram queue
+ * @param[in] first       = first datagram to pack
+ * @param[in] idx         = index of frame
+ * @return number of the first datagram not packed
+ */
+static int ecx_packdatagrams(ecx_portt *port, ec_dgqueuet *queue, int first, uint8 idx)
+{
+   ec_dgqueueentryt *entry;
+   int size, last, i;
+
+   /* the first datagram always fits, the others as long as the frame is not
+      larger than a frame with a single datagram of EC_MAXLRWDATA */
+   size = ETH_HEADERSIZE + EC_HEADERSIZE + EC_WKCSIZE + queue->entry[first].length;
+   last = first + 1;
+   while ((last < queue->n) &&
+          ((size + EC_HEADERSIZE - EC_ELENGTHSIZE + EC_WKCSIZE + queue->entry[last].length) <=
+           (int)(ETH_HEADERSIZE + EC_HEADERSIZE + EC_WKCSIZE + EC_MAXLRWDATA)))
+   {
+      size += EC_HEADERSIZE - EC_ELENGTHSIZE + EC_WKCSIZE + queue->entry[last].length;
+      last++;
+   }
+   for (i = first; i < last; i++)
+   {
+      entry = &(queue->entry[i]);
+      if (i == first)
+      {
+         ecx_setupdatagram(port, &(port->txbuf[idx]), entry->com, idx, entry->ADP, entry->ADO, entry->length, entry->data);
+         entry->rxpos = EC_HEADERSIZE;
+      }
+      else
+      {
+         entry->rxpos = ecx_adddatagram(port, &(port->txbuf[idx]), entry->com, idx, (i < (last - 1)),
+            entry->ADP, entry->ADO, entry->length, entry->data);
+      }
+   }
+
+   return last;
+}
+
+/** Copy the results of the datagrams of a returned frame to their databuffers.
+ *
+ * @param[in] port        = port context struct
+ * @param[in,out] queue   = datagram queue
+ * @param[in] first       = first datagram of frame
+ * @param[in] last        = first datagram not in frame
+ * @param[in] idx         = index of frame
+ */
+static void ecx_scatterdatagrams(ecx_portt *port, ec_dgqueuet *queue, int first, int last, uint8 idx)
+{
+   ec_dgqueueentryt *entry;
+   uint8 *rxbuf;
+   uint16 le_wkc;
+   int i;
+
+   rxbuf = port->rxbuf[idx];
+   for (i = first; i < last; i++)
+   {
+      entry = &(queue->entry[i]);
+      /* datagram header starts with the command */
+      if (rxbuf[entry->rxpos - EC_HEADERSIZE + EC_CMDOFFSET] != entry->com)
+      {
+         entry->wkc = EC_NOFRAME;
+         continue;
+      }
+      memcpy(&le_wkc, &(rxbuf[entry->rxpos + entry->length]), EC_WKCSIZE);
+      entry->wkc = etohs(le_wkc);
+      if ((entry->wkc > 0) && entry->length && ecx_readsback(entry->com))
+      {
+         memcpy(entry->data, &(rxbuf[entry->rxpos]), entry->length);
+      }
+   }
+}
+
+/** Send all datagrams of a queue and wait for their results. Blocking.
+ * The datagrams are packed in order in as few frames as possible, up to
+ * EC_MAXDGFRAMES frames are in flight together. A frame not returned is
+ * retried once with ecx_srconfirm().
+ *
+ * @param[in] port        = port context struct
+ * @param[in,out] queue   = datagram queue, Workcounter of each datagram is
+ *                          set in its entry
+ * @param[in] timeout     = timeout in us per frame, standard is EC_TIMEOUTRET
+ * @return sum of the Workcounters of all datagrams, or EC_NOFRAME if a frame
+ * was not returned
+ */
+int ecx_senddatagrams(ecx_portt *port, ec_dgqueuet *queue, int timeout)
+{
+   uint8 idx[EC_MAXDGFRAMES];
+   int first[EC_MAXDGFRAMES + 1];
+   int wkc[EC_MAXDGFRAMES];
+   int next, nframes, f, i, total;
+   boolean lost;
+
+   total = 0;
+   lost = FALSE;
+   next = 0;
+   while (next < queue->n)
+   {
+      nframes = 0;
+      while ((next < queue->n) && (nframes < EC_MAXDGFRAMES))
+      {
+         idx[nframes] = ecx_getindex(port);
+         first[nframes] = next;
+         next = ecx_packdatagrams(port, queue, next, idx[nframes]);
+         nframes++;
+      }
+      first[nframes] = next;
+      ecx_outframe_red_batch(port, idx, nframes);
+      ecx_waitinframe_batch(port, idx, wkc, nframes, timeout);
+      for (f = 0; f < nframes; f++)
+      {
+         if (wkc[f] <= EC_NOFRAME)
+         {
+            /* resend single frame */
+            wkc[f] = ecx_srconfirm(port, idx[f], timeout);
+         }
+         if (wkc[f] > EC_NOFRAME)
+         {
+            ecx_scatterdatagrams(port, queue, first[f], first[f + 1], idx[f]);
+         }
+         for (i = first[f]; i < first[f + 1]; i++)
+         {
+            if (queue->entry[i].wkc > EC_NOFRAME)
+            {
+               total += queue->entry[i].wkc;
+            }
+            else
+            {
+               lost = TRUE;
+            }
+         }
+         ecx_setbufstat(port, idx[f], EC_BUF_EMPTY);
+      }
+   }
+
+   return lost ? EC_NOFRAME : total;
+}
+
+/** Send a single datagram without waiting for it. Non blocking.
+ * The datagram is completed by ecx_completedatagrams(), called from
+ * ecx_receive_processdata() so the cyclic thread drives the completions, or
+ * by ecx_polldatagram(). The answer is stored by the receive of the cyclic
+ * thread or by a receiver thread, see ecx_startreceiver(), a datagram is not
+ * received without one of them. With a callback it is called once the
+ * datagram is done and the handle is released after it returns. Without a
+ * callback the result is collected with ecx_polldatagram(). The databuffer
+ * must stay valid until the datagram is done.
+ *
+ * @param[in] port        = port context struct
+ * @param[in]  com        = command, EC_CMD_xxx
+ * @param[in]  ADP        = Address Position
+ * @param[in]  ADO        = Address Offset
+ * @param[in]  length     = length of databuffer
+ * @param[in,out] data    = databuffer to be written, filled with the data read
+ * @param[in]  timeout    = timeout in us, standard is EC_TIMEOUTRET
+ * @param[in]  callback   = completion callback or NULL
+ * @param[in]  userdata   = passed to callback
+ * @return handle of datagram, or EC_ERROR if all EC_MAXASYNC are in flight
+ */
+int ecx_startdatagram(ecx_portt *port, uint8 com, uint16 ADP, uint16 ADO, uint16 length, void *data,
+   int timeout, ec_asynccbT callback, void *userdata)
+{
+   ec_asyncT *async;
+   int handle;
+
+   if (length > EC_MAXLRWDATA)
+   {
+      return EC_ERROR;
+   }
+   for (handle = 0; handle < EC_MAXASYNC; handle++)
+   {
+      if (osal_atomic_cas(&(port->async[handle].state), EC_ASYNC_FREE, EC_ASYNC_SETUP))
+      {
+         break;
+      }
+   }
+   if (handle >= EC_MAXASYNC)
+   {
+      return EC_ERROR;
+   }
+   async = &(port->async[handle]);
+   async->idx = ecx_getindex(port);
+   async->com = com;
+   async->length = length;
+   async->data = data;
+   async->wkc = EC_NOFRAME;
+   async->callback = callback;
+   async->userdata = userdata;
+   ecx_setupdatagram(port, &(port->txbuf[async->idx]), com, async->idx, ADP, ADO, length, data);
+   osal_timer_start(&(async->timer), timeout);
+   osal_atomic_add(&(port->asynccount), 1);
+   ecx_outframe_red(port, async->idx);
+   /* answer is stored by whoever receives, the status shows it */
+   osal_atomic_store(&(async->state), EC_ASYNC_PENDING);
+
+   return handle;
+}
+
+/** Complete an asynchronous datagram if its frame is in or its time is up.
+ *
+ * @param[in] port        = port context struct
+ * @param[in] handle      = handle of datagram
+ * @return TRUE if the datagram is done
+ */
+static boolean ecx_completedatagram(ecx_portt *port, int handle)
+{
+   ec_asyncT *async;
+   int wkc;
+
+   async = &(port->async[handle]);
+   if (!osal_atomic_cas(&(async->state), EC_ASYNC_PENDING, EC_ASYNC_BUSY))
+   {
+      return (osal_atomic_load(&(async->state)) == EC_ASYNC_DONE);
+   }
+   wkc = ecx_pollinframe(port, async->idx, &(async->timer));
+   if (wkc == EC_PENDING)
+   {
+      osal_atomic_store(&(async->state), EC_ASYNC_PENDING);
+      return FALSE;
+   }
+   if ((wkc > EC_NOFRAME) && (port->rxbuf[async->idx][EC_CMDOFFSET] != async->com))
+   {
+      wkc = EC_NOFRAME;
+   }
+   if ((wkc > 0) && async->length && ecx_readsback(async->com))
+   {
+      memcpy(async->data, &(port->rxbuf[async->idx][EC_HEADERSIZE]), async->length);
+   }
+   ecx_setbufstat(port, async->idx, EC_BUF_EMPTY);
+   async->wkc = wkc;
+   osal_atomic_add(&(port->asynccount), -1);
+   if (async->callback)
+   {
+      async->callback(handle, wkc, async->userdata);
+      osal_atomic_store(&(async->state), EC_ASYNC_FREE);
+   }
+   else
+   {
+      osal_atomic_store(&(async->state), EC_ASYNC_DONE);
+   }
+
+   return TRUE;
+}
+
+/** Complete all asynchronous datagrams whose frames are in or whose time
+ * is up, their callbacks are called from here. Non blocking, frames are not
+ * received, the receive of the cyclic thread or a receiver thread stores
+ * them.
+ *
+ * @param[in] port        = port context struct
+ * @return number of datagrams still in flight
+ */
+int ecx_completedatagrams(ecx_portt *port)
+{
+   int handle;
+
+   if (!osal_atomic_load(&(port->asynccount)))
+   {
+      return 0;
+   }
+   for (handle = 0; handle < EC_MAXASYNC; handle++)
+   {
+      ecx_completedatagram(port, handle);
+   }
+
+   return osal_atomic_load(&(port->asynccount));
+}
+
+/** Poll an asynchronous datagram without callback. Non blocking. Once done
+ * the result is returned and the handle released.
+ *
+ * @param[in] port        = port context struct
+ * @param[in] handle      = handle from ecx_startdatagram()
+ * @return Workcounter, EC_NOFRAME, EC_PENDING if not done yet or EC_ERROR if
+ * the handle is not in use
+ */
+int ecx_polldatagram(ecx_portt *port, int handle)
+{
+   ec_asyncT *async;
+   int wkc;
+
+   if ((handle < 0) || (handle >= EC_MAXASYNC))
+   {
+      return EC_ERROR;
+   }
+   async = &(port->async[handle]);
+   if (osal_atomic_load(&(async->state)) == EC_ASYNC_FREE)
+   {
+      /* released before or never started */
+      return EC_ERROR;
+   }
+   if (!ecx_completedatagram(port, handle))
+   {
+      return EC_PENDING;
+   }
+   wkc = async->wkc;
+   if (!osal_atomic_cas(&(async->state), EC_ASYNC_DONE, EC_ASYNC_FREE))
+   {
+      return EC_ERROR;
+   }
+
+   return wkc;
+}
+
 #ifdef EC_VER1
 int ec_setupdatagram(void *frame, uint8 com, uint8 idx, uint16 ADP, uint16 ADO, uint16 length, void *data)
 {
@@ -634,4 +1012,20 @@ int ec_LRWDC(uint32 LogAdr, uint16 length, void *data, uint16 DCrs, int64 *DCtim
 {
    return ecx_LRWDC(&ecx_port, LogAdr, length, data, DCrs, DCtime, timeout);
 }
+
+int ec_senddatagrams(ec_dgqueuet *queue, int timeout)
+{
+   return ecx_senddatagrams(&ecx_port, queue, timeout);
+}
+
+int ec_startdatagram(uint8 com, uint16 ADP, uint16 ADO, uint16 length, void *data,
+   int timeout, ec_asynccbT callback, void *userdata)
+{
+   return ecx_startdatagram(&ecx_port, com, ADP, ADO, length, data, timeout, callback, userdata);
+}
+
+int ec_polldatagram(int handle)
+{
+   return ecx_polldatagram(&ecx_port, handle);
+}
 #endif
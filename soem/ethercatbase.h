@@ -16,6 +16,39 @@ extern "C"
 {
 #endif
 
+/** maximum number of datagrams in a datagram queue */
+#define EC_MAXDGQUEUE      128
+/** maximum number of frames of a datagram queue in flight at the same time */
+#define EC_MAXDGFRAMES     4
+
+/** Datagram in a datagram queue */
+typedef struct ec_dgqueueentry
+{
+   /** command, EC_CMD_xxx */
+   uint8            com;
+   /** Address Position, or low word of the logical address */
+   uint16           ADP;
+   /** Address Offset, or high word of the logical address */
+   uint16           ADO;
+   /** length of datagram data */
+   uint16           length;
+   /** databuffer written to the slaves and filled with the data read */
+   void             *data;
+   /** Workcounter of the datagram after transfer or EC_NOFRAME */
+   int              wkc;
+   /** offset to the data in the rx frame, internal */
+   uint16           rxpos;
+} ec_dgqueueentryt;
+
+/** Queue of datagrams sent in as few frames as possible */
+typedef struct ec_dgqueue
+{
+   /** number of datagrams in queue */
+   int              n;
+   /** datagrams in order of queueing */
+   ec_dgqueueentryt entry[EC_MAXDGQUEUE];
+} ec_dgqueuet;
+
 int ecx_setupdatagram(ecx_portt *port, void *frame, uint8 com, uint8 idx, uint16 ADP, uint16 ADO, uint16 length, void *data);
 uint16 ecx_adddatagram(ecx_portt *port, void *frame, uint8 com, uint8 idx, boolean more, uint16 ADP, uint16 ADO, uint16 length, void *data);
 int ecx_BWR(ecx_portt *port, uint16 ADP,uint16 ADO,uint16 length,void *data,int timeout);
@@ -34,6 +67,13 @@ int ecx_LRW(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, int timeo
 int ecx_LRD(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, int timeout);
 int ecx_LWR(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, int timeout);
 int ecx_LRWDC(ecx_portt *port, uint32 LogAdr, uint16 length, void *data, uint16 DCrs, int64 *DCtime, int timeout);
+void ecx_initdatagrams(ec_dgqueuet *queue);
+int ecx_queuedatagram(ec_dgqueuet *queue, uint8 com, uint16 ADP, uint16 ADO, uint16 length, void *data);
+int ecx_senddatagrams(ecx_portt *port, ec_dgqueuet *queue, int timeout);
+int ecx_startdatagram(ecx_portt *port, uint8 com, uint16 ADP, uint16 ADO, uint16 length, void *data,
+   int timeout, ec_asynccbT callback, void *userdata);
+int ecx_completedatagrams(ecx_portt *port);
+int ecx_polldatagram(ecx_portt *port, int handle);
 
 #ifdef EC_VER1
 int ec_setupdatagram(void *frame, uint8 com, uint8 idx, uint16 ADP, uint16 ADO, uint16 length, void *data);
@@ -54,6 +94,10 @@ int ec_LRW(uint32 LogAdr, uint16 length, void *data, int timeout);
 int ec_LRD(uint32 LogAdr, uint16 length, void *data, int timeout);
 int ec_LWR(uint32 LogAdr, uint16 length, void *data, int timeout);
 int ec_LRWDC(uint32 LogAdr, uint16 length, void *data, uint16 DCrs, int64 *DCtime, int timeout);
+int ec_senddatagrams(ec_dgqueuet *queue, int timeout);
+int ec_startdatagram(uint8 com, uint16 ADP, uint16 ADO, uint16 length, void *data,
+   int timeout, ec_asynccbT callback, void *userdata);
+int ec_polldatagram(int handle);
 #endif
 
 #ifdef __cplusplus
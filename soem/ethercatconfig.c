@@ -31,11 +31,6 @@ typedef struct
    uint16 slave;
 } ecx_mapt_t;
 
-ecx_mapt_t ecx_mapt[EC_MAX_MAPT];
-#if EC_MAX_MAPT > 1
-OSAL_THREAD_HANDLE ecx_threadh[EC_MAX_MAPT];
-#endif
-
 #ifdef EC_VER1
 /** Slave configuration structure */
 typedef const struct
@@ -107,6 +102,8 @@ void ecx_init_context(ecx_contextt *context)
    /* clean ec_slave array */
    memset(context->slavelist, 0x00, sizeof(ec_slavet) * context->maxslave);
    memset(context->grouplist, 0x00, sizeof(ec_groupt) * context->maxgroup);
+   /* legacy index stack is the one of group 0 */
+   context->idxstack = &(context->grouplist[0].idxstack);
    /* clear slave eeprom cache, does not actually read any eeprom */
    ecx_siigetbyte(context, 0, EC_MAXEEPBUF);
    for(lp = 0; lp < context->maxgroup; lp++)
@@ -808,14 +805,14 @@ OSAL_THREAD_FUNC ecx_mapper_thread(void *param)
    ecx_mapt_t *maptp;
    maptp = param;
    ecx_map_coe_soe(maptp->context, maptp->slave, maptp->thread_n);
-   maptp->running = 0;
+   osal_atomic_store(&(maptp->running), 0);
 }
 
-static int ecx_find_mapt(void)
+static int ecx_find_mapt(ecx_mapt_t *mapt)
 {
    int p;
    p = 0;
-   while((p < EC_MAX_MAPT) && ecx_mapt[p].running)
+   while((p < EC_MAX_MAPT) && osal_atomic_load(&(mapt[p].running)))
    {
       p++;
    }
@@ -830,25 +827,30 @@ static int ecx_find_mapt(void)
 }
 #endif
 
-static int ecx_get_threadcount(void)
+static int ecx_get_threadcount(ecx_mapt_t *mapt)
 {
    int thrc, thrn;
    thrc = 0;
    for(thrn = 0 ; thrn < EC_MAX_MAPT ; thrn++)
    {
-      thrc += ecx_mapt[thrn].running;
+      thrc += osal_atomic_load(&(mapt[thrn].running));
    }
    return thrc;
 }
 
 static void ecx_config_find_mappings(ecx_contextt *context, uint8 group)
 {
+   /* mapper state is local, contexts can be configured from several threads */
+   ecx_mapt_t mapt[EC_MAX_MAPT];
+#if EC_MAX_MAPT > 1
+   OSAL_THREAD_HANDLE threadh[EC_MAX_MAPT];
+#endif
    int thrn, thrc;
    uint16 slave;
 
    for (thrn = 0; thrn < EC_MAX_MAPT; thrn++)
    {
-      ecx_mapt[thrn].running = 0;
+      mapt[thrn].running = 0;
    }
    /* find CoE and SoE mapping of slaves in multiple threads */
    for (slave = 1; slave <= *(context->slavecount); slave++)
@@ -857,16 +859,16 @@ static void ecx_config_find_mappings(ecx_contextt *context, uint8 group)
       {
 #if EC_MAX_MAPT > 1
             /* multi-threaded version */
-            while ((thrn = ecx_find_mapt()) < 0)
+            while ((thrn = ecx_find_mapt(mapt)) < 0)
             {
                osal_usleep(1000);
             }
-            ecx_mapt[thrn].context = context;
-            ecx_mapt[thrn].slave = slave;
-            ecx_mapt[thrn].thread_n = thrn;
-            ecx_mapt[thrn].running = 1;
-            osal_thread_create(&(ecx_threadh[thrn]), 128000,
-               &ecx_mapper_thread, &(ecx_mapt[thrn]));
+            mapt[thrn].context = context;
+            mapt[thrn].slave = slave;
+            mapt[thrn].thread_n = thrn;
+            mapt[thrn].running = 1;
+            osal_thread_create(&(threadh[thrn]), 128000,
+               &ecx_mapper_thread, &(mapt[thrn]));
 #else
             /* serialised version */
             ecx_map_coe_soe(context, slave, 0);
@@ -876,7 +878,7 @@ static void ecx_config_find_mappings(ecx_contextt *context, uint8 group)
    /* wait for all threads to finish */
    do
    {
-      thrc = ecx_get_threadcount();
+      thrc = ecx_get_threadcount(mapt);
       if (thrc)
       {
          osal_usleep(1000);
@@ -1361,6 +1363,9 @@ static int ecx_main_config_map_group(ecx_contextt *context, void *pIOmap, uint8
 
       EC_PRINT("IOmapSize %d\n", LogAddr - context->grouplist[group].logstartaddr);
 
+      /* layout of the cyclic frames is known now */
+      ecx_compile_processdata_group(context, group, FALSE);
+
       return (LogAddr - context->grouplist[group].logstartaddr);
    }
 
@@ -1533,6 +1538,9 @@ int ecx_config_overlap_map_group(ecx_contextt *context, void *pIOmap, uint8 grou
 
       EC_PRINT("IOmapSize %d\n", context->grouplist[group].Obytes + context->grouplist[group].Ibytes);
 
+      /* layout of the cyclic frames is known now */
+      ecx_compile_processdata_group(context, group, TRUE);
+
       return (context->grouplist[group].Obytes + context->grouplist[group].Ibytes);
    }
 
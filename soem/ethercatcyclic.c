@@ -0,0 +1,191 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Cyclic executor of the process data exchange.
+ *
+ * A real-time thread per group sleeps to absolute deadlines and exchanges the
+ * process data of the group each cycle, with hooks before the send and after
+ * the receive. With DC the deadlines follow the reference clock through a PI
+ * loop, so the frames pass the slaves at a fixed distance to their sync point.
+ */
+#include <string.h>
+#include "oshw.h"
+#include "osal.h"
+#include "ethercattype.h"
+#include "ethercatbase.h"
+#include "ethercatmain.h"
+#include "ethercatcyclic.h"
+
+/** Initialise a cyclic executor. The receive timeout is one cycle, the cycle
+ * is not locked to DC and has no hooks. Set the fields of the executor before
+ * ecx_startcyclic() to change that.
+ * @param[out] cyclic         = cyclic executor
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  cycletime      = cycle time in ns
+ */
+void ecx_initcyclic(ec_cyclict *cyclic, ecx_contextt *context, uint8 group, int64 cycletime)
+{
+   memset(cyclic, 0, sizeof(*cyclic));
+   cyclic->context = context;
+   cyclic->group = group;
+   cyclic->cycletime = cycletime;
+   /* frames are back within a cycle or lost */
+   cyclic->timeout = (int)(cycletime / 1000);
+   if (cyclic->timeout < 1)
+   {
+      cyclic->timeout = 1;
+   }
+}
+
+/** Correction of the next deadline from the DC time of the last cycle. The
+ * distance of the cycle start to the sync point is driven to dcshift.
+ * @param[in]  cyclic         = cyclic executor
+ * @param[in]  DCtime         = DC time of reference clock when the frame passed
+ * @return offset to add to the next deadline in ns
+ */
+static int64 ecx_cyclicsync(ec_cyclict *cyclic, int64 DCtime)
+{
+   int64 delta;
+
+   delta = (DCtime - cyclic->dcshift) % cyclic->cycletime;
+   if (delta > (cyclic->cycletime / 2))
+   {
+      delta -= cyclic->cycletime;
+   }
+   if (delta > 0)
+   {
+      cyclic->dcintegral++;
+   }
+   if (delta < 0)
+   {
+      cyclic->dcintegral--;
+   }
+   cyclic->dcdelta = delta;
+
+   return -(delta / EC_CYCLICPDIV) - (cyclic->dcintegral / EC_CYCLICIDIV);
+}
+
+/** Cyclic thread of an executor.
+ * @param[in]  param          = cyclic executor
+ */
+static OSAL_THREAD_FUNC_RT ecx_cyclicthread(void *param)
+{
+   ec_cyclict *cyclic;
+   ecx_contextt *context;
+   int64 deadline, now;
+
+   cyclic = param;
+   context = cyclic->context;
+   deadline = osal_monotonic_time() + cyclic->cycletime;
+   while (!osal_atomic_load(&(cyclic->stop)))
+   {
+      osal_sleep_until(deadline);
+      now = osal_monotonic_time();
+      if ((now - deadline) > cyclic->maxlatency)
+      {
+         cyclic->maxlatency = now - deadline;
+      }
+      if (cyclic->presend)
+      {
+         cyclic->presend(cyclic);
+      }
+      if (cyclic->overlap)
+      {
+         ecx_send_overlap_processdata_group(context, cyclic->group);
+      }
+      else
+      {
+         ecx_send_processdata_group(context, cyclic->group);
+      }
+      cyclic->wkc = ecx_receive_processdata_group(context, cyclic->group, cyclic->timeout);
+      if (cyclic->postreceive)
+      {
+         cyclic->postreceive(cyclic);
+      }
+      cyclic->cycles++;
+      deadline += cyclic->cycletime;
+      if (cyclic->dcsync && context->grouplist[cyclic->group].hasdc &&
+          (cyclic->wkc > EC_NOFRAME))
+      {
+         deadline += ecx_cyclicsync(cyclic, *(context->DCtime));
+      }
+      /* a cycle that ran into the next deadlines skips them */
+      now = osal_monotonic_time();
+      while (deadline <= now)
+      {
+         deadline += cyclic->cycletime;
+         cyclic->overruns++;
+      }
+   }
+   osal_atomic_store(&(cyclic->running), FALSE);
+}
+
+/** Start the cyclic thread of an executor with real-time priority.
+ * @param[in]  cyclic         = cyclic executor
+ * @return >0 if the thread was started, real-time priority is requested but
+ * not guaranteed
+ */
+int ecx_startcyclic(ec_cyclict *cyclic)
+{
+   if (cyclic->running || (cyclic->cycletime <= 0))
+   {
+      return 0;
+   }
+   /* reap a thread that exited without a stop */
+   if (cyclic->joinable)
+   {
+      osal_thread_join(&(cyclic->thread));
+      cyclic->joinable = FALSE;
+   }
+   cyclic->stop = FALSE;
+   cyclic->running = TRUE;
+   if (!osal_thread_create_rt(&(cyclic->thread), EC_CYCLICSTACK, &ecx_cyclicthread, cyclic))
+   {
+      cyclic->running = FALSE;
+      return 0;
+   }
+   cyclic->joinable = TRUE;
+
+   return 1;
+}
+
+/** Stop the cyclic thread of an executor. Waits for the running cycle to
+ * finish and joins the thread.
+ * @param[in]  cyclic         = cyclic executor
+ * @return >0 if the thread stopped
+ */
+int ecx_stopcyclic(ec_cyclict *cyclic)
+{
+   osal_timert timer;
+
+   osal_atomic_store(&(cyclic->stop), TRUE);
+   osal_timer_start(&timer, (uint32)(cyclic->cycletime / 1000) + EC_CYCLICSTOPWAIT);
+   while (osal_atomic_load(&(cyclic->running)))
+   {
+      if (osal_timer_is_expired(&timer))
+      {
+         /* still joinable, a later stop or start reaps it */
+         return 0;
+      }
+      osal_usleep(100);
+   }
+   if (cyclic->joinable)
+   {
+      osal_thread_join(&(cyclic->thread));
+      cyclic->joinable = FALSE;
+   }
+
+   return 1;
+}
+
+#ifdef EC_VER1
+void ec_initcyclic(ec_cyclict *cyclic, uint8 group, int64 cycletime)
+{
+   ecx_initcyclic(cyclic, &ecx_context, group, cycletime);
+}
+#endif
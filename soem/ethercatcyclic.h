@@ -0,0 +1,92 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Headerfile for ethercatcyclic.c
+ */
+
+#ifndef _EC_ECATCYCLIC_H
+#define _EC_ECATCYCLIC_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** stack size of the cyclic thread */
+#define EC_CYCLICSTACK     (128 * 1024)
+/** divisor of the proportional part of the DC sync loop */
+#define EC_CYCLICPDIV      100
+/** divisor of the integral part of the DC sync loop */
+#define EC_CYCLICIDIV      20
+/** time in us a stop waits for the cyclic thread on top of one cycle */
+#define EC_CYCLICSTOPWAIT  1000000
+
+typedef struct ec_cyclic ec_cyclict;
+
+/** Hook of the cyclic executor, called from the cyclic thread */
+typedef void (*ec_cyclichookt)(ec_cyclict *cyclic);
+
+/** Cyclic executor of the process data exchange of a group. A real-time
+ * thread sleeps to absolute deadlines, optionally locked to the DC reference
+ * clock, and sends and receives the group each cycle. */
+struct ec_cyclic
+{
+   /** context of group */
+   ecx_contextt     *context;
+   /** group cycled */
+   uint8            group;
+   /** group is mapped with ecx_config_overlap_map_group() */
+   boolean          overlap;
+   /** cycle time in ns */
+   int64            cycletime;
+   /** receive timeout in us */
+   int              timeout;
+   /** lock the cycle to the DC reference clock if the group has DC */
+   boolean          dcsync;
+   /** cycle start relative to the DC sync point in ns */
+   int64            dcshift;
+   /** called before the process data is sent, NULL if none */
+   ec_cyclichookt   presend;
+   /** called after the process data is received, NULL if none */
+   ec_cyclichookt   postreceive;
+   /** application data for the hooks */
+   void             *userdata;
+   /** Workcounter of the last cycle */
+   int              wkc;
+   /** cycles run */
+   uint64           cycles;
+   /** deadlines missed as a cycle ran into the next one */
+   uint64           overruns;
+   /** largest wake up after the deadline in ns */
+   int64            maxlatency;
+   /** distance of the last cycle start to the DC sync point in ns */
+   int64            dcdelta;
+   /** internal, integral of the DC sync loop */
+   int64            dcintegral;
+   /** internal, set while the cyclic thread runs */
+   int              running;
+   /** internal, set to stop the cyclic thread */
+   int              stop;
+   /** internal, handle of the cyclic thread */
+   OSAL_THREAD_HANDLE thread;
+   /** internal, set while the thread handle is not joined */
+   int              joinable;
+};
+
+#ifdef EC_VER1
+void ec_initcyclic(ec_cyclict *cyclic, uint8 group, int64 cycletime);
+#endif
+
+void ecx_initcyclic(ec_cyclict *cyclic, ecx_contextt *context, uint8 group, int64 cycletime);
+int ecx_startcyclic(ec_cyclict *cyclic);
+int ecx_stopcyclic(ec_cyclict *cyclic);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EC_ECATCYCLIC_H */
@@ -8,6 +8,7 @@
  * Distributed Clock EtherCAT functions.
  *
  */
+#include <string.h>
 #include "oshw.h"
 #include "osal.h"
 #include "ethercattype.h"
@@ -255,7 +256,9 @@ boolean ecx_configdc(ecx_contextt *context)
    uint16 parenthold = 0;
    uint16 prevDCslave = 0;
    int32 ht, dt1, dt2, dt3;
+   int32 rt[4];
    int64 hrt;
+   ec_dgqueuet queue;
    uint8 entryport;
    int8 nlist;
    int8 plist[4];
@@ -293,20 +296,25 @@ boolean ecx_configdc(ecx_contextt *context)
          parenthold = 0;
          prevDCslave = i;
          slaveh = context->slavelist[i].configadr;
-         (void)ecx_FPRD(context->port, slaveh, ECT_REG_DCTIME0, sizeof(ht), &ht, EC_TIMEOUTRET);
-         context->slavelist[i].DCrtA = etohl(ht);
-         /* 64bit latched DCrecvTimeA of each specific slave */
-         (void)ecx_FPRD(context->port, slaveh, ECT_REG_DCSOF, sizeof(hrt), &hrt, EC_TIMEOUTRET);
+         /* latched port receive times and 64bit latched DCrecvTimeA of each
+            specific slave, all read in one frame */
+         memset(rt, 0, sizeof(rt));
+         hrt = 0;
+         ecx_initdatagrams(&queue);
+         ecx_queuedatagram(&queue, EC_CMD_FPRD, slaveh, ECT_REG_DCTIME0, sizeof(rt[0]), &rt[0]);
+         ecx_queuedatagram(&queue, EC_CMD_FPRD, slaveh, ECT_REG_DCSOF, sizeof(hrt), &hrt);
+         ecx_queuedatagram(&queue, EC_CMD_FPRD, slaveh, ECT_REG_DCTIME1, sizeof(rt[1]), &rt[1]);
+         ecx_queuedatagram(&queue, EC_CMD_FPRD, slaveh, ECT_REG_DCTIME2, sizeof(rt[2]), &rt[2]);
+         ecx_queuedatagram(&queue, EC_CMD_FPRD, slaveh, ECT_REG_DCTIME3, sizeof(rt[3]), &rt[3]);
+         (void)ecx_senddatagrams(context->port, &queue, EC_TIMEOUTRET);
+         context->slavelist[i].DCrtA = etohl(rt[0]);
          /* use it as offset in order to set local time around 0 + mastertime */
          hrt = htoell(-etohll(hrt) + mastertime64);
          /* save it in the offset register */
          (void)ecx_FPWR(context->port, slaveh, ECT_REG_DCSYSOFFSET, sizeof(hrt), &hrt, EC_TIMEOUTRET);
-         (void)ecx_FPRD(context->port, slaveh, ECT_REG_DCTIME1, sizeof(ht), &ht, EC_TIMEOUTRET);
-         context->slavelist[i].DCrtB = etohl(ht);
-         (void)ecx_FPRD(context->port, slaveh, ECT_REG_DCTIME2, sizeof(ht), &ht, EC_TIMEOUTRET);
-         context->slavelist[i].DCrtC = etohl(ht);
-         (void)ecx_FPRD(context->port, slaveh, ECT_REG_DCTIME3, sizeof(ht), &ht, EC_TIMEOUTRET);
-         context->slavelist[i].DCrtD = etohl(ht);
+         context->slavelist[i].DCrtB = etohl(rt[1]);
+         context->slavelist[i].DCrtC = etohl(rt[2]);
+         context->slavelist[i].DCrtD = etohl(rt[3]);
 
          /* make list of active ports and their time stamps */
          nlist = 0;
@@ -322,7 +322,7 @@ int ecx_EOEsend(ecx_contextt *context, uint16 slave, uint8 port, int psize, void
    boolean  NotLast;
    int wkc, maxdata, txframesize, txframeoffset;
    const uint8 * buf = p;
-   static uint8_t txframeno = 0;
+   uint8 txframeno;
 
    ec_clearmbx(&MbxOut);
    EOEp = (ec_EOEt *)&MbxOut;
@@ -362,8 +362,10 @@ int ecx_EOEsend(ecx_contextt *context, uint16 slave, uint8 port, int psize, void
       else
       {
          frameinfo2 = frameinfo2 | (EOE_HDR_FRAME_OFFSET_SET(((psize + 31) >> 5)));
-         txframeno++;
+         /* frame number is counted per slave */
+         context->slavelist[slave].eoe_frameno++;
       }
+      txframeno = context->slavelist[slave].eoe_frameno;
       frameinfo2 = frameinfo2 | EOE_HDR_FRAME_NO_SET(txframeno);
 
       /* get new mailbox count value, used as session handle */
@@ -76,7 +76,6 @@ static uint8            ec_esibuf[EC_MAXEEPBUF];
 static uint32           ec_esimap[EC_MAXEEPBITMAP];
 /** current slave for EEPROM cache buffer */
 static ec_eringt        ec_elist;
-static ec_idxstackT     ec_idxstack;
 
 /** SyncManager Communication Type struct to store data of one slave */
 static ec_SMcommtypet   ec_SMcommtype[EC_MAX_MAPT];
@@ -108,7 +107,7 @@ ecx_contextt  ecx_context = {
     &ec_esimap[0],      // .esimap        =
     0,                  // .esislave      =
     &ec_elist,          // .elist         =
-    &ec_idxstack,       // .idxstack      =
+    &ec_group[0].idxstack, // .idxstack   =
     &EcatError,         // .ecaterror     =
     &ec_DCtime,         // .DCtime        =
     &ec_SMcommtype[0],  // .SMcommtype    =
@@ -286,6 +285,7 @@ static void ecx_mbxemergencyerror(ecx_contextt *context, uint16 Slave,uint16 Err
  */
 int ecx_init(ecx_contextt *context, const char * ifname)
 {
+   context->idxstack = &(context->grouplist[0].idxstack);
    return ecx_setupnic(context->port, ifname, FALSE);
 }
 
@@ -301,6 +301,7 @@ int ecx_init_redundant(ecx_contextt *context, ecx_redportt *redport, const char
    int rval, zbuf;
    ec_etherheadert *ehp;
 
+   context->idxstack = &(context->grouplist[0].idxstack);
    context->port->redport = redport;
    ecx_setupnic(context->port, ifname, FALSE);
    rval = ecx_setupnic(context->port, if2name, TRUE);
@@ -681,38 +682,16 @@ uint32 ecx_siiPDO(ecx_contextt *context, uint16 slave, ec_eepromPDOt* PDO, uint8
 
 int ecx_FPRD_multi(ecx_contextt *context, int n, uint16 *configlst, ec_alstatust *slstatlst, int timeout)
 {
-   int wkc;
-   uint8 idx;
-   ecx_portt *port;
-   uint16 sldatapos[MAX_FPRD_MULTI];
+   ec_dgqueuet queue;
    int slcnt;
 
-   port = context->port;
-   idx = ecx_getindex(port);
-   slcnt = 0;
-   ecx_setupdatagram(port, &(port->txbuf[idx]), EC_CMD_FPRD, idx,
-      *(configlst + slcnt), ECT_REG_ALSTAT, sizeof(ec_alstatust), slstatlst + slcnt);
-   sldatapos[slcnt] = EC_HEADERSIZE;
-   while(++slcnt < (n - 1))
-   {
-      sldatapos[slcnt] = ecx_adddatagram(port, &(port->txbuf[idx]), EC_CMD_FPRD, idx, TRUE,
-                            *(configlst + slcnt), ECT_REG_ALSTAT, sizeof(ec_alstatust), slstatlst + slcnt);
-   }
-   if(slcnt < n)
+   ecx_initdatagrams(&queue);
+   for (slcnt = 0 ; slcnt < n ; slcnt++)
    {
-      sldatapos[slcnt] = ecx_adddatagram(port, &(port->txbuf[idx]), EC_CMD_FPRD, idx, FALSE,
-                            *(configlst + slcnt), ECT_REG_ALSTAT, sizeof(ec_alstatust), slstatlst + slcnt);
+      ecx_queuedatagram(&queue, EC_CMD_FPRD, *(configlst + slcnt), ECT_REG_ALSTAT,
+         sizeof(ec_alstatust), slstatlst + slcnt);
    }
-   wkc = ecx_srconfirm(port, idx, timeout);
-   if (wkc >= 0)
-   {
-      for(slcnt = 0 ; slcnt < n ; slcnt++)
-      {
-         memcpy(slstatlst + slcnt, &(port->rxbuf[idx][sldatapos[slcnt]]), sizeof(ec_alstatust));
-      }
-   }
-   ecx_setbufstat(port, idx, EC_BUF_EMPTY);
-   return wkc;
+   return ecx_senddatagrams(context->port, &queue, timeout);
 }
 
 /** Read all slave states in ec_slave.
@@ -1643,35 +1622,35 @@ uint32 ecx_readeeprom2(ecx_contextt *context, uint16 slave, int timeout)
 }
 
 /** Push index of segmented LRD/LWR/LRW combination.
- * @param[in]  context        = context struct
+ * @param[in]  idxstack       = index stack of group
  * @param[in] idx         = Used datagram index.
  * @param[in] data        = Pointer to process data segment.
  * @param[in] length      = Length of data segment in bytes.
  * @param[in] DCO         = Offset position of DC frame.
  */
-static void ecx_pushindex(ecx_contextt *context, uint8 idx, void *data, uint16 length, uint16 DCO)
+static void ecx_pushindex(ec_idxstackT *idxstack, uint8 idx, void *data, uint16 length, uint16 DCO)
 {
-   if(context->idxstack->pushed < EC_MAXBUF)
+   if(idxstack->pushed < EC_MAXSLOTS)
    {
-      context->idxstack->idx[context->idxstack->pushed] = idx;
-      context->idxstack->data[context->idxstack->pushed] = data;
-      context->idxstack->length[context->idxstack->pushed] = length;
-      context->idxstack->dcoffset[context->idxstack->pushed] = DCO;
-      context->idxstack->pushed++;
+      idxstack->idx[idxstack->pushed] = idx;
+      idxstack->data[idxstack->pushed] = data;
+      idxstack->length[idxstack->pushed] = length;
+      idxstack->dcoffset[idxstack->pushed] = DCO;
+      idxstack->pushed++;
    }
 }
 
 /** Pull index of segmented LRD/LWR/LRW combination.
- * @param[in]  context        = context struct
+ * @param[in]  idxstack       = index stack of group
  * @return Stack location, -1 if stack is empty.
  */
-static int ecx_pullindex(ecx_contextt *context)
+static int ecx_pullindex(ec_idxstackT *idxstack)
 {
    int rval = -1;
-   if(context->idxstack->pulled < context->idxstack->pushed)
+   if(idxstack->pulled < idxstack->pushed)
    {
-      rval = context->idxstack->pulled;
-      context->idxstack->pulled++;
+      rval = idxstack->pulled;
+      idxstack->pulled++;
    }
 
    return rval;
@@ -1680,44 +1659,90 @@ static int ecx_pullindex(ecx_contextt *context)
 /** 
  * Clear the idx stack.
  * 
- * @param context           = context struct
+ * @param idxstack          = index stack of group
  */
-static void ecx_clearindex(ecx_contextt *context)  {
+static void ecx_clearindex(ec_idxstackT *idxstack)  {
 
-   context->idxstack->pushed = 0;
-   context->idxstack->pulled = 0;
+   idxstack->pushed = 0;
+   idxstack->pulled = 0;
 
 }
 
-/** Transmit processdata to slaves.
- * Uses LRW, or LRD/LWR if LRW is not allowed (blockLRW).
- * Both the input and output processdata are transmitted.
- * The outputs with the actual data, the inputs have a placeholder.
- * The inputs are gathered with the receive processdata function.
- * In contrast to the base LRW function this function is non-blocking.
- * If the processdata does not fit in one datagram, multiple are used.
- * In order to recombine the slave response, a stack is used.
+/** Add a precompiled frame to a group.
+ *
+ * @param[in]  context        = context struct
+ * @param[in]  grp            = group
+ * @param[in]  com            = command, LRD, LWR or LRW
+ * @param[in]  LogAdr         = logical address of datagram
+ * @param[in]  length         = length of datagram
+ * @param[in]  txdata         = outputs copied into the frame
+ * @param[in]  rxdata         = process data buffer of the inputs
+ * @param[in]  dc             = TRUE to add the FRMW DC datagram
+ */
+static void ecx_addframetemplate(ecx_contextt *context, ec_groupt *grp, uint8 com, uint32 LogAdr,
+   uint16 length, uint8 *txdata, uint8 *rxdata, boolean dc)
+{
+   ec_frametemplatet *tpl;
+
+   if (grp->nframes >= EC_MAXGROUPFRAMES)
+   {
+      return;
+   }
+   tpl = &(grp->frame[grp->nframes++]);
+   /* same layout as ecx_setupdatagram() and ecx_adddatagram() build */
+   memset(tpl, 0, sizeof(*tpl));
+   tpl->header.elength = htoes(EC_ECATTYPE + EC_HEADERSIZE + length);
+   tpl->header.command = com;
+   tpl->header.ADP = htoes(LO_WORD(LogAdr));
+   tpl->header.ADO = htoes(HI_WORD(LogAdr));
+   tpl->header.dlength = htoes(length);
+   tpl->txdata = (com == EC_CMD_LRD) ? NULL : txdata;
+   tpl->rxdata = rxdata;
+   tpl->length = length;
+   tpl->txlength = ETH_HEADERSIZE + EC_HEADERSIZE + EC_WKCSIZE + length;
+   if (dc)
+   {
+      /* FPRMW in second datagram */
+      tpl->header.elength = htoes(etohs(tpl->header.elength) + EC_HEADERSIZE + sizeof(int64));
+      tpl->header.dlength = htoes(length | EC_DATAGRAMFOLLOWS);
+      tpl->dcheader.command = EC_CMD_FRMW;
+      tpl->dcheader.ADP = htoes(context->slavelist[grp->DCnext].configadr);
+      tpl->dcheader.ADO = htoes(ECT_REG_DCSYSTIME);
+      tpl->dcheader.dlength = htoes(sizeof(int64));
+      tpl->DCO = (uint16)(tpl->txlength + EC_HEADERSIZE - EC_ELENGTHSIZE - ETH_HEADERSIZE);
+      tpl->txlength += EC_HEADERSIZE - EC_ELENGTHSIZE + EC_WKCSIZE + sizeof(int64);
+   }
+}
+
+/** Precompile the frames of the cyclic process data exchange of a group.
+ * The layout of the frames does not change after the group is mapped, the
+ * cyclic send only copies the outputs into the frames and sets the index.
+ * Called by the map functions, the send recompiles when the DC setup of
+ * the group or the IOmap mode changed since.
+ *
  * @param[in]  context        = context struct
  * @param[in]  group          = group number
- * @param[in]  use_overlap_io = flag if overlapped iomap is used
- * @return >0 if processdata is transmitted.
+ * @param[in]  use_overlap_io = TRUE for overlapping IOmap
+ * @return number of frames per cycle
  */
-static int ecx_main_send_processdata(ecx_contextt *context, uint8 group, boolean use_overlap_io)
+int ecx_compile_processdata_group(ecx_contextt *context, uint8 group, boolean use_overlap_io)
 {
+   ec_groupt *grp;
    uint32 LogAdr;
-   uint16 w1, w2;
    int length;
    uint16 sublength;
-   uint8 idx;
-   int wkc;
    uint8* data;
    boolean first=FALSE;
    uint16 currentsegment = 0;
    uint32 iomapinputoffset;
-   uint16 DCO;
 
-   wkc = 0;
-   if(context->grouplist[group].hasdc)
+   grp = &(context->grouplist[group]);
+   grp->nframes = 0;
+   grp->frameoverlap = use_overlap_io;
+   grp->framedc = grp->hasdc;
+   grp->framedcadr = grp->hasdc ? context->slavelist[grp->DCnext].configadr : 0;
+   grp->framescompiled = TRUE;
+   if(grp->hasdc)
    {
       first = TRUE;
    }
@@ -1726,152 +1751,690 @@ static int ecx_main_send_processdata(ecx_contextt *context, uint8 group, boolean
    if(use_overlap_io == TRUE)
    {
       /* For overlap IOmap make the frame EQ big to biggest part */
-      length = (context->grouplist[group].Obytes > context->grouplist[group].Ibytes) ?
-         context->grouplist[group].Obytes : context->grouplist[group].Ibytes;
+      length = (grp->Obytes > grp->Ibytes) ? grp->Obytes : grp->Ibytes;
       /* Save the offset used to compensate where to save inputs when frame returns */
-      iomapinputoffset = context->grouplist[group].Obytes;
+      iomapinputoffset = grp->Obytes;
    }
    else
    {
-      length = context->grouplist[group].Obytes + context->grouplist[group].Ibytes;
+      length = grp->Obytes + grp->Ibytes;
       iomapinputoffset = 0;
    }
-   
-   LogAdr = context->grouplist[group].logstartaddr;
+
+   LogAdr = grp->logstartaddr;
    if(length)
    {
-
-      wkc = 1;
       /* LRW blocked by one or more slaves ? */
-      if(context->grouplist[group].blockLRW)
+      if(grp->blockLRW)
       {
          /* if inputs available generate LRD */
-         if(context->grouplist[group].Ibytes)
+         if(grp->Ibytes)
          {
-            currentsegment = context->grouplist[group].Isegment;
-            data = context->grouplist[group].inputs;
-            length = context->grouplist[group].Ibytes;
-            LogAdr += context->grouplist[group].Obytes;
+            currentsegment = grp->Isegment;
+            data = grp->inputs;
+            length = grp->Ibytes;
+            LogAdr += grp->Obytes;
             /* segment transfer if needed */
             do
             {
-               if(currentsegment == context->grouplist[group].Isegment)
+               if(currentsegment == grp->Isegment)
                {
-                  sublength = (uint16)(context->grouplist[group].IOsegment[currentsegment++] - context->grouplist[group].Ioffset);
+                  sublength = (uint16)(grp->IOsegment[currentsegment++] - grp->Ioffset);
                }
                else
                {
-                  sublength = (uint16)context->grouplist[group].IOsegment[currentsegment++];
+                  sublength = (uint16)grp->IOsegment[currentsegment++];
                }
-               /* get new index */
-               idx = ecx_getindex(context->port);
-               w1 = LO_WORD(LogAdr);
-               w2 = HI_WORD(LogAdr);
-               DCO = 0;
-               ecx_setupdatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_LRD, idx, w1, w2, sublength, data);
-               if(first)
-               {
-                  /* FPRMW in second datagram */
-                  DCO = ecx_adddatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_FRMW, idx, FALSE,
-                                           context->slavelist[context->grouplist[group].DCnext].configadr,
-                                           ECT_REG_DCSYSTIME, sizeof(int64), context->DCtime);
-                  first = FALSE;
-               }
-               /* send frame */
-               ecx_outframe_red(context->port, idx);
-               /* push index and data pointer on stack */
-               ecx_pushindex(context, idx, data, sublength, DCO);
+               ecx_addframetemplate(context, grp, EC_CMD_LRD, LogAdr, sublength, data, data, first);
+               first = FALSE;
                length -= sublength;
                LogAdr += sublength;
                data += sublength;
-            } while (length && (currentsegment < context->grouplist[group].nsegments));
+            } while (length && (currentsegment < grp->nsegments));
          }
          /* if outputs available generate LWR */
-         if(context->grouplist[group].Obytes)
+         if(grp->Obytes)
          {
-            data = context->grouplist[group].outputs;
-            length = context->grouplist[group].Obytes;
-            LogAdr = context->grouplist[group].logstartaddr;
+            data = grp->outputs;
+            length = grp->Obytes;
+            LogAdr = grp->logstartaddr;
             currentsegment = 0;
             /* segment transfer if needed */
             do
             {
-               sublength = (uint16)context->grouplist[group].IOsegment[currentsegment++];
+               sublength = (uint16)grp->IOsegment[currentsegment++];
                if((length - sublength) < 0)
                {
                   sublength = (uint16)length;
                }
-               /* get new index */
-               idx = ecx_getindex(context->port);
-               w1 = LO_WORD(LogAdr);
-               w2 = HI_WORD(LogAdr);
-               DCO = 0;
-               ecx_setupdatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_LWR, idx, w1, w2, sublength, data);
-               if(first)
-               {
-                  /* FPRMW in second datagram */
-                  DCO = ecx_adddatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_FRMW, idx, FALSE,
-                                           context->slavelist[context->grouplist[group].DCnext].configadr,
-                                           ECT_REG_DCSYSTIME, sizeof(int64), context->DCtime);
-                  first = FALSE;
-               }
-               /* send frame */
-               ecx_outframe_red(context->port, idx);
-               /* push index and data pointer on stack */
-               ecx_pushindex(context, idx, data, sublength, DCO);
+               ecx_addframetemplate(context, grp, EC_CMD_LWR, LogAdr, sublength, data, data, first);
+               first = FALSE;
                length -= sublength;
                LogAdr += sublength;
                data += sublength;
-            } while (length && (currentsegment < context->grouplist[group].nsegments));
+            } while (length && (currentsegment < grp->nsegments));
          }
       }
       /* LRW can be used */
       else
       {
-         if (context->grouplist[group].Obytes)
+         if (grp->Obytes)
          {
-            data = context->grouplist[group].outputs;
+            data = grp->outputs;
          }
          else
          {
-            data = context->grouplist[group].inputs;
+            data = grp->inputs;
             /* Clear offset, don't compensate for overlapping IOmap if we only got inputs */
             iomapinputoffset = 0;
          }
          /* segment transfer if needed */
          do
          {
-            sublength = (uint16)context->grouplist[group].IOsegment[currentsegment++];
-            /* get new index */
-            idx = ecx_getindex(context->port);
-            w1 = LO_WORD(LogAdr);
-            w2 = HI_WORD(LogAdr);
-            DCO = 0;
-            ecx_setupdatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_LRW, idx, w1, w2, sublength, data);
-            if(first)
-            {
-               /* FPRMW in second datagram */
-               DCO = ecx_adddatagram(context->port, &(context->port->txbuf[idx]), EC_CMD_FRMW, idx, FALSE,
-                                        context->slavelist[context->grouplist[group].DCnext].configadr,
-                                        ECT_REG_DCSYSTIME, sizeof(int64), context->DCtime);
-               first = FALSE;
-            }
-            /* send frame */
-            ecx_outframe_red(context->port, idx);
-            /* push index and data pointer on stack.
-             * the iomapinputoffset compensate for where the inputs are stored 
+            sublength = (uint16)grp->IOsegment[currentsegment++];
+            /* the iomapinputoffset compensate for where the inputs are stored
              * in the IOmap if we use an overlapping IOmap. If a regular IOmap
              * is used it should always be 0.
              */
-            ecx_pushindex(context, idx, (data + iomapinputoffset), sublength, DCO);      
+            ecx_addframetemplate(context, grp, EC_CMD_LRW, LogAdr, sublength, data,
+               data + iomapinputoffset, first);
+            first = FALSE;
             length -= sublength;
             LogAdr += sublength;
             data += sublength;
-         } while (length && (currentsegment < context->grouplist[group].nsegments));
+         } while (length && (currentsegment < grp->nsegments));
       }
    }
 
-   return wkc;
+   return grp->nframes;
+}
+
+/** Attach a process image to a group. Application threads then read the
+ * inputs and write the outputs of the group through the image, while the
+ * cyclic thread publishes the inputs after each receive and takes over the
+ * outputs before each send. Call it after the group is mapped, the image
+ * starts with the content of the IOmap.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[out] image          = image to attach, NULL to detach
+ * @param[in]  buffer         = buffer for inputs and outputs of the image
+ * @param[in]  size           = size of buffer, at least Ibytes + Obytes of group
+ * @return >0 if attached
+ */
+int ecx_attachimage(ecx_contextt *context, uint8 group, ec_imaget *image, uint8 *buffer, int size)
+{
+   ec_groupt *grp;
+
+   grp = &(context->grouplist[group]);
+   if (!image)
+   {
+      grp->image = NULL;
+      return 1;
+   }
+   if (!buffer || (size < (int)(grp->Ibytes + grp->Obytes)))
+   {
+      return 0;
+   }
+   memset(image, 0, sizeof(*image));
+   image->Ibytes = grp->Ibytes;
+   image->Obytes = grp->Obytes;
+   image->inputs = buffer;
+   image->outputs = buffer + grp->Ibytes;
+   if (grp->Ibytes)
+   {
+      memcpy(image->inputs, grp->inputs, grp->Ibytes);
+   }
+   if (grp->Obytes)
+   {
+      memcpy(image->outputs, grp->outputs, grp->Obytes);
+   }
+   osal_atomic_storeptr(&(grp->image), image);
+
+   return 1;
+}
+
+/** Read inputs of the last published cycle. The bytes read are consistent,
+ * all from the same cycle. Never blocks the cyclic thread, a read that
+ * overlapped a publish is repeated.
+ * @param[in]  image          = process image
+ * @param[in]  offset         = offset in inputs of group
+ * @param[out] data           = buffer for inputs
+ * @param[in]  length         = number of bytes to read
+ * @return number of the cycle read, 1 for the content at attach, 0 if offset
+ * and length are out of range
+ */
+uint32 ecx_readinputs(ec_imaget *image, uint32 offset, void *data, uint32 length)
+{
+   uint32 seq;
+
+   if ((offset > image->Ibytes) || (length > image->Ibytes - offset))
+   {
+      return 0;
+   }
+   do
+   {
+      seq = osal_atomic_load(&(image->inseq));
+      if (seq & 1)
+      {
+         continue;
+      }
+      memcpy(data, image->inputs + offset, length);
+      osal_atomic_fence();
+   } while ((seq & 1) || (seq != (uint32)osal_atomic_load(&(image->inseq))));
+
+   return (seq >> 1) + 1;
+}
+
+/** Write outputs for the next cycle. All bytes written by one call are sent
+ * in the same cycle. Only other application threads are waited for, the
+ * cyclic thread skips a cycle instead of waiting.
+ * @param[in]  image          = process image
+ * @param[in]  offset         = offset in outputs of group
+ * @param[in]  data           = outputs
+ * @param[in]  length         = number of bytes to write
+ */
+void ecx_writeoutputs(ec_imaget *image, uint32 offset, const void *data, uint32 length)
+{
+   if ((offset > image->Obytes) || (length > image->Obytes - offset))
+   {
+      return;
+   }
+   while (osal_atomic_exchange(&(image->outlock), 1))
+   {
+      osal_usleep(1);
+   }
+   memcpy(image->outputs + offset, data, length);
+   osal_atomic_store(&(image->outdirty), TRUE);
+   osal_atomic_store(&(image->outlock), 0);
+}
+
+/** Read inputs of a slave from the process image of its group.
+ * Slaves with less than 8 input bits are read as one byte.
+ * @param[in]  context        = context struct
+ * @param[in]  slave          = slave number
+ * @param[out] data           = buffer for the inputs of the slave
+ * @return number of the cycle read, 0 if the group has no image
+ */
+uint32 ecx_readslaveinputs(ecx_contextt *context, uint16 slave, void *data)
+{
+   ec_slavet *sl;
+   ec_groupt *grp;
+   ec_imaget *image;
+
+   sl = &(context->slavelist[slave]);
+   grp = &(context->grouplist[sl->group]);
+   image = osal_atomic_loadptr(&(grp->image));
+   if (!image || !sl->inputs)
+   {
+      return 0;
+   }
+   return ecx_readinputs(image, (uint32)(sl->inputs - grp->inputs), data,
+                         sl->Ibytes ? sl->Ibytes : (sl->Ibits > 0));
+}
+
+/** Write outputs of a slave to the process image of its group.
+ * Slaves with less than 8 output bits are written as one byte, the bits of
+ * other slaves in that byte included.
+ * @param[in]  context        = context struct
+ * @param[in]  slave          = slave number
+ * @param[in]  data           = outputs of the slave
+ */
+void ecx_writeslaveoutputs(ecx_contextt *context, uint16 slave, const void *data)
+{
+   ec_slavet *sl;
+   ec_groupt *grp;
+   ec_imaget *image;
+
+   sl = &(context->slavelist[slave]);
+   grp = &(context->grouplist[sl->group]);
+   image = osal_atomic_loadptr(&(grp->image));
+   if (!image || !sl->outputs)
+   {
+      return;
+   }
+   ecx_writeoutputs(image, (uint32)(sl->outputs - grp->outputs), data,
+                    sl->Obytes ? sl->Obytes : (sl->Obits > 0));
+}
+
+/** Take over the outputs of the application into the IOmap, unless an
+ * application thread is writing them.
+ * @param[in]  grp            = group of image
+ * @param[in]  image          = process image
+ */
+static void ecx_takeoutputs(ec_groupt *grp, ec_imaget *image)
+{
+   if (!osal_atomic_load(&(image->outdirty)))
+   {
+      return;
+   }
+   if (osal_atomic_exchange(&(image->outlock), 1))
+   {
+      image->outskipped++;
+      return;
+   }
+   memcpy(grp->outputs, image->outputs, image->Obytes);
+   osal_atomic_store(&(image->outdirty), FALSE);
+   osal_atomic_store(&(image->outlock), 0);
+}
+
+/** Publish the inputs of the IOmap to the application.
+ * @param[in]  grp            = group of image
+ * @param[in]  image          = process image
+ */
+static void ecx_publishinputs(ec_groupt *grp, ec_imaget *image)
+{
+   uint32 seq;
+
+   seq = image->inseq;
+   osal_atomic_store(&(image->inseq), seq + 1);
+   osal_atomic_fence();
+   memcpy(image->inputs, grp->inputs, image->Ibytes);
+   osal_atomic_store(&(image->inseq), seq + 2);
+}
+
+/** Attach a statistics block to a group. From then on each send and receive
+ * of the group updates it. The block may be in shared memory, an other
+ * process reads it with ecx_readstats().
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[out] stats          = statistics block, NULL to detach
+ * @return >0 if attached
+ */
+int ecx_attachstats(ecx_contextt *context, uint8 group, ec_groupstatst *stats)
+{
+   if (stats)
+   {
+      memset(stats, 0, sizeof(*stats));
+      stats->size = sizeof(*stats);
+   }
+   osal_atomic_storeptr(&(context->grouplist[group].stats), stats);
+
+   return 1;
+}
+
+/** Take a consistent copy of a statistics block. Never blocks the cyclic
+ * thread, a copy that overlapped an update is repeated.
+ * @param[in]  stats          = statistics block
+ * @param[out] copy           = copy of block
+ * @return >0 if copied, 0 if the block is not of this version
+ */
+int ecx_readstats(const ec_groupstatst *stats, ec_groupstatst *copy)
+{
+   uint32 seq;
+
+   if ((uint32)osal_atomic_load(&(stats->size)) != sizeof(*stats))
+   {
+      return 0;
+   }
+   do
+   {
+      seq = osal_atomic_load(&(stats->seq));
+      if (seq & 1)
+      {
+         continue;
+      }
+      memcpy(copy, stats, sizeof(*copy));
+      osal_atomic_fence();
+   } while ((seq & 1) || (seq != (uint32)osal_atomic_load(&(stats->seq))));
+
+   return 1;
+}
+
+/** Histogram bucket of a latency. Below 8 ns each value has its bucket,
+ * above each power of two is split in 8 buckets.
+ * @param[in]  ns             = latency in ns
+ * @return bucket
+ */
+static int ecx_statsbucket(int64 ns)
+{
+   int k;
+
+   if (ns < 8)
+   {
+      return (ns < 0) ? 0 : (int)ns;
+   }
+   if (ns >= (1LL << 31))
+   {
+      return EC_STATSBUCKETS - 1;
+   }
+   k = 63 - __builtin_clzll((uint64)ns);
+   return (k - 2) * 8 + (int)((ns >> (k - 3)) & 7);
+}
+
+/** Latency below which a share of the cycles stayed, from the histogram.
+ * The value is the upper end of its bucket, at most 1/8 above the latency.
+ * @param[in]  stats          = statistics block or copy of it
+ * @param[in]  permille       = share of cycles in 1/1000, 500 for the median
+ * @return latency in ns, 0 without cycles
+ */
+int64 ecx_statspercentile(const ec_groupstatst *stats, int permille)
+{
+   uint64 total, target, sum;
+   int b, k;
+
+   total = 0;
+   for (b = 0; b < EC_STATSBUCKETS; b++)
+   {
+      total += stats->histogram[b];
+   }
+   if (!total)
+   {
+      return 0;
+   }
+   target = (total * (uint64)permille + 999) / 1000;
+   if (!target)
+   {
+      target = 1;
+   }
+   sum = 0;
+   for (b = 0; b < EC_STATSBUCKETS - 1; b++)
+   {
+      sum += stats->histogram[b];
+      if (sum >= target)
+      {
+         break;
+      }
+   }
+   if (b < 8)
+   {
+      return b;
+   }
+   k = b / 8 + 2;
+   return ((int64)(9 + (b & 7)) << (k - 3)) - 1;
+}
+
+/** Update the statistics block of a group after a receive.
+ * @param[in]  grp            = group
+ * @param[in]  stats          = statistics block
+ * @param[in]  wire           = wire time per frame, 0 if not known
+ * @param[in]  n              = number of frames
+ * @param[in]  wkc            = Workcounter of the cycle, EC_NOFRAME if none
+ * @param[in]  lost           = frames not received within the timeout
+ * @param[in]  retried        = lost frames sent once more
+ * @param[in]  recovered      = lost frames answered when sent once more
+ * @param[in]  salvaged       = lost frames replaced by a late frame
+ */
+static void ecx_updatestats(ec_groupt *grp, ec_groupstatst *stats, const int64 *wire,
+   int n, int wkc, int lost, int retried, int recovered, int salvaged)
+{
+   int64 latency;
+   uint32 seq;
+   int f;
+
+   latency = osal_monotonic_time() - stats->sendtime;
+   seq = stats->seq;
+   osal_atomic_store(&(stats->seq), seq + 1);
+   osal_atomic_fence();
+   if (!stats->cycles || (latency < stats->minlatency))
+   {
+      stats->minlatency = latency;
+   }
+   if (latency > stats->maxlatency)
+   {
+      stats->maxlatency = latency;
+   }
+   stats->cycles++;
+   stats->latency = latency;
+   stats->totallatency += latency;
+   stats->histogram[ecx_statsbucket(latency)]++;
+   if (stats->latelimit && (latency > stats->latelimit))
+   {
+      stats->latecycles++;
+   }
+   if ((wkc <= EC_NOFRAME) || (wkc < (grp->outputsWKC * 2 + grp->inputsWKC)))
+   {
+      stats->wkcfaults++;
+   }
+   stats->lostframes += lost;
+   stats->retries += retried;
+   stats->recovered += recovered;
+   stats->salvaged += salvaged;
+   stats->nframes = (n < EC_MAXGROUPFRAMES) ? n : EC_MAXGROUPFRAMES;
+   for (f = 0; f < (int)stats->nframes; f++)
+   {
+      stats->frametime[f] = wire[f];
+      if (wire[f] > stats->framemax[f])
+      {
+         stats->framemax[f] = wire[f];
+      }
+   }
+   osal_atomic_store(&(stats->seq), seq + 2);
+}
+
+/** Set the policy of a group for process data frames that miss the receive
+ * timeout. With EC_LATE_RETRY they are sent once more and waited for up to
+ * retrytimeout, when the cycle has time left for it. With EC_LATE_SALVAGE
+ * their index is kept for one cycle, a late arrival then stands in for the
+ * same frame if that is missing in the next cycle, as inputs one cycle old
+ * are better than none. Call it after the group is mapped.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  policy         = EC_LATE_DROP or EC_LATE_SALVAGE and EC_LATE_RETRY
+ * @param[in]  retrytimeout   = time in us frames sent once more are waited for
+ * @return >0 if set
+ */
+int ecx_setlatepolicy(ecx_contextt *context, uint8 group, int policy, int retrytimeout)
+{
+   ec_groupt *grp;
+   int j;
+
+   grp = &(context->grouplist[group]);
+   if (!(policy & EC_LATE_SALVAGE))
+   {
+      /* frames kept so far are given back */
+      for (j = 0; j < grp->nlate; j++)
+      {
+         ecx_setbufstat(context->port, grp->lateidx[j], EC_BUF_EMPTY);
+      }
+      grp->nlate = 0;
+   }
+   grp->latepolicy = policy;
+   grp->retrytimeout = (policy & EC_LATE_RETRY) ? retrytimeout : 0;
+
+   return 1;
+}
+
+/** Send the frames missing at the end of a receive once more and wait for
+ * them.
+ * @param[in]  context        = context struct
+ * @param[in]  grp            = group
+ * @param[in]  idx            = indexes of the frames of the cycle
+ * @param[in,out] wkclist     = Workcounter per frame
+ * @param[in]  n              = number of frames
+ * @param[out] recovered      = frames answered
+ * @return number of frames sent once more
+ */
+static int ecx_retryframes(ecx_contextt *context, ec_groupt *grp, const uint8 *idx,
+   int *wkclist, int n, int *recovered)
+{
+   uint8 retryidx[EC_MAXGROUPFRAMES];
+   int retrypos[EC_MAXGROUPFRAMES];
+   int retrywkc[EC_MAXGROUPFRAMES];
+   int i, m;
+
+   *recovered = 0;
+   m = 0;
+   for (i = 0; (i < n) && (m < EC_MAXGROUPFRAMES); i++)
+   {
+      if (wkclist[i] <= EC_NOFRAME)
+      {
+         retryidx[m] = idx[i];
+         retrypos[m++] = i;
+      }
+   }
+   if (!m)
+   {
+      return 0;
+   }
+   /* the frames are still in their tx buffers */
+   m = ecx_outframe_red_batch(context->port, retryidx, m);
+   ecx_waitinframe_batch(context->port, retryidx, retrywkc, m, grp->retrytimeout);
+   for (i = 0; i < m; i++)
+   {
+      if (retrywkc[i] > EC_NOFRAME)
+      {
+         wkclist[retrypos[i]] = retrywkc[i];
+         (*recovered)++;
+      }
+   }
+
+   return m;
+}
+
+/** Find the late arrival of a frame kept in the last cycle.
+ * @param[in]  context        = context struct
+ * @param[in]  lateidx        = indexes of frames kept
+ * @param[in,out] latedata    = process data buffer of frames kept, cleared if found
+ * @param[in]  nlate          = number of frames kept
+ * @param[in]  data           = process data buffer of missing frame
+ * @param[out] wkc            = Workcounter of late frame
+ * @return index of late frame, -1 if none
+ */
+static int ecx_salvageframe(ecx_contextt *context, const uint8 *lateidx, void **latedata,
+   int nlate, void *data, int *wkc)
+{
+   osal_timert timer;
+   int j;
+
+   /* expired timer, only look at what is already received */
+   osal_timer_start(&timer, 0);
+   for (j = 0; j < nlate; j++)
+   {
+      if (latedata[j] == data)
+      {
+         *wkc = ecx_pollinframe(context->port, lateidx[j], &timer);
+         if (*wkc > EC_NOFRAME)
+         {
+            latedata[j] = NULL;
+            return lateidx[j];
+         }
+      }
+   }
+
+   return -1;
+}
+
+/** Copy the inputs of a salvaged frame to the IOmap. The frame was sent in
+ * the cycle before, its outputs are those of that cycle and are not copied.
+ * @param[in]  grp            = group of frame
+ * @param[in]  data           = process data of the frame segment
+ * @param[in]  length         = length of the segment
+ * @param[in]  rxbuf          = received frame
+ */
+static void ecx_salvageinputs(ec_groupt *grp, uint8 *data, uint16 length, const uint8 *rxbuf)
+{
+   uint8 *start, *end;
+
+   start = data;
+   end = data + length;
+   if (start < grp->inputs)
+   {
+      start = grp->inputs;
+   }
+   if (end > grp->inputs + grp->Ibytes)
+   {
+      end = grp->inputs + grp->Ibytes;
+   }
+   if (start < end)
+   {
+      memcpy(start, &(rxbuf[EC_HEADERSIZE + (start - data)]), end - start);
+   }
+}
+
+/** Transmit processdata to slaves.
+ * Uses LRW, or LRD/LWR if LRW is not allowed (blockLRW).
+ * Both the input and output processdata are transmitted.
+ * The outputs with the actual data, the inputs have a placeholder.
+ * The inputs are gathered with the receive processdata function.
+ * In contrast to the base LRW function this function is non-blocking.
+ * If the processdata does not fit in one datagram, multiple are used.
+ * In order to recombine the slave response, the stack of the group is used,
+ * so groups can be cycled from their own threads at their own rate. All frames
+ * are transmitted together after the stack is filled. The frames are
+ * copies of the templates of ecx_compile_processdata_group() with the
+ * outputs, the index and the DC time filled in.
+ * @param[in]  context        = context struct
+ * @param[in]  group          = group number
+ * @param[in]  use_overlap_io = flag if overlapped iomap is used
+ * @return >0 if processdata is transmitted.
+ */
+static int ecx_main_send_processdata(ecx_contextt *context, uint8 group, boolean use_overlap_io)
+{
+   ec_groupt *grp;
+   ec_frametemplatet *tpl;
+   ec_comt *datagramP;
+   uint8 *frameP;
+   uint8 idx;
+   int f, pos;
+   uint16 firstpush;
+
+   grp = &(context->grouplist[group]);
+   if (grp->image)
+   {
+      ecx_takeoutputs(grp, grp->image);
+   }
+   /* DC is usually configured after mapping, recompile once it changed */
+   if (!grp->framescompiled || (grp->frameoverlap != use_overlap_io) ||
+       (grp->framedc != grp->hasdc) ||
+       (grp->hasdc && (grp->framedcadr != context->slavelist[grp->DCnext].configadr)))
+   {
+      ecx_compile_processdata_group(context, group, use_overlap_io);
+   }
+   if (!grp->nframes)
+   {
+      return 0;
+   }
+
+   firstpush = grp->idxstack.pushed;
+   for (f = 0; f < grp->nframes; f++)
+   {
+      tpl = &(grp->frame[f]);
+      /* get new index */
+      idx = ecx_getindex(context->port);
+      frameP = (uint8 *)&(context->port->txbuf[idx]);
+      /* Ethernet header is preset and fixed in frame buffers */
+      datagramP = (ec_comt *)&frameP[ETH_HEADERSIZE];
+      memcpy(datagramP, &(tpl->header), EC_HEADERSIZE);
+      datagramP->index = idx;
+      pos = ETH_HEADERSIZE + EC_HEADERSIZE;
+      if (tpl->txdata)
+      {
+         memcpy(&frameP[pos], tpl->txdata, tpl->length);
+      }
+      else
+      {
+         /* no data to write. initialise data so frame is in a known state */
+         memset(&frameP[pos], 0, tpl->length);
+      }
+      pos += tpl->length;
+      /* set WKC to zero */
+      frameP[pos++] = 0x00;
+      frameP[pos++] = 0x00;
+      if (tpl->DCO)
+      {
+         /* DC datagram header follows the WKC, without elength */
+         datagramP = (ec_comt *)&frameP[pos - EC_ELENGTHSIZE];
+         memcpy(&frameP[pos], &(tpl->dcheader.command), EC_HEADERSIZE - EC_ELENGTHSIZE);
+         datagramP->index = idx;
+         pos += EC_HEADERSIZE - EC_ELENGTHSIZE;
+         memcpy(&frameP[pos], context->DCtime, sizeof(int64));
+         pos += sizeof(int64);
+         frameP[pos++] = 0x00;
+         frameP[pos++] = 0x00;
+      }
+      context->port->txbuflength[idx] = tpl->txlength;
+      /* push index and data pointer on stack */
+      ecx_pushindex(&(grp->idxstack), idx, tpl->rxdata, tpl->length, tpl->DCO);
+   }
+   /* send all frames of this cycle in one batch */
+   if (grp->stats)
+   {
+      grp->stats->sendtime = osal_monotonic_time();
+   }
+   ecx_outframe_red_batch(context->port, &(grp->idxstack.idx[firstpush]),
+                          grp->idxstack.pushed - firstpush);
+
+   return 1;
 }
 
 /** Transmit processdata to slaves.
@@ -1912,6 +2475,12 @@ int ecx_send_processdata_group(ecx_contextt *context, uint8 group)
  * Second part from ec_send_processdata().
  * Received datagrams are recombined with the processdata with help from the stack.
  * If a datagram contains input processdata it copies it to the processdata structure.
+ * All frames of the group are received together before they are processed,
+ * frames of other groups are left to the receive of their group.
+ * LRW data is received in place and not copied if the driver supports it,
+ * see ecx_setzerocopy() of the Linux driver.
+ * Frames that miss the timeout are handled by the policy of ecx_setlatepolicy().
+ * The inputs are then published to the process image of the group, if any.
  * @param[in]  context        = context struct
  * @param[in]  group          = group number
  * @param[in]  timeout        = Timeout in us.
@@ -1920,55 +2489,154 @@ int ecx_send_processdata_group(ecx_contextt *context, uint8 group)
 int ecx_receive_processdata_group(ecx_contextt *context, uint8 group, int timeout)
 {
    uint8 idx;
-   int pos;
+   int pos, first;
    int wkc = 0, wkc2;
+   int i, j, n, late;
+   int lost, retried, recovered, salvaged;
+   ec_groupt *grp;
+   uint8 lateidx[EC_MAXGROUPFRAMES];
+   void *latedata[EC_MAXGROUPFRAMES];
+   int nlate;
+   boolean salvage;
+   int wkclist[EC_MAXSLOTS];
+   uint8 *target[EC_MAXSLOTS];
+   boolean placed[EC_MAXSLOTS];
    uint16 le_wkc = 0;
    int valid_wkc = 0;
    int64 le_DCtime;
    ec_idxstackT *idxstack;
-   ec_bufT *rxbuf;
-
-   /* just to prevent compiler warning for unused group */
-   wkc2 = group;
-
-   idxstack = context->idxstack;
-   rxbuf = context->port->rxbuf;
+   ec_groupstatst *stats;
+   int64 wire[EC_MAXGROUPFRAMES];
+   int64 txtime, rxtime;
+   uint8 *rxbuf;
+
+   grp = &(context->grouplist[group]);
+   idxstack = &(grp->idxstack);
+   stats = grp->stats;
+   /* receive the same number of frames as send */
+   first = idxstack->pulled;
+   n = idxstack->pushed - first;
+   /* LRW data of a not overlapping IOmap may be received in place */
+   for (i = 0; i < n; i++)
+   {
+      idx = idxstack->idx[first + i];
+      target[i] = NULL;
+      if (!grp->frameoverlap &&
+          (context->port->txbuf[idx][ETH_HEADERSIZE + EC_CMDOFFSET] == EC_CMD_LRW))
+      {
+         target[i] = idxstack->data[first + i];
+      }
+   }
+   ecx_waitinframe_scatter(context->port, &(idxstack->idx[first]), target,
+                           &(idxstack->length[first]), wkclist, placed, n, timeout);
+   retried = 0;
+   recovered = 0;
+   salvaged = 0;
+   if ((grp->latepolicy & EC_LATE_RETRY) && (grp->retrytimeout > 0))
+   {
+      retried = ecx_retryframes(context, grp, &(idxstack->idx[first]), wkclist, n, &recovered);
+   }
+   /* frames kept in the last cycle, salvaged below or given back */
+   nlate = grp->nlate;
+   for (j = 0; j < nlate; j++)
+   {
+      lateidx[j] = grp->lateidx[j];
+      latedata[j] = grp->latedata[j];
+   }
+   grp->nlate = 0;
+   /* frames recovered were lost in the first wait */
+   lost = recovered;
    /* get first index */
-   pos = ecx_pullindex(context);
-   /* read the same number of frames as send */
+   pos = ecx_pullindex(idxstack);
    while (pos >= 0)
    {
       idx = idxstack->idx[pos];
-      wkc2 = ecx_waitinframe(context->port, idx, timeout);
+      wkc2 = wkclist[pos - first];
+      salvage = FALSE;
+      if (wkc2 <= EC_NOFRAME)
+      {
+         lost++;
+         if ((grp->latepolicy & EC_LATE_SALVAGE) && (grp->nlate < EC_MAXGROUPFRAMES))
+         {
+            /* keep index, the frame may still come in */
+            grp->lateidx[grp->nlate] = idx;
+            grp->latedata[grp->nlate++] = idxstack->data[pos];
+         }
+         else
+         {
+            ecx_setbufstat(context->port, idx, EC_BUF_EMPTY);
+         }
+         late = ecx_salvageframe(context, lateidx, latedata, nlate, idxstack->data[pos], &wkc2);
+         if (late < 0)
+         {
+            /* nothing to process and nothing to release */
+            pos = ecx_pullindex(idxstack);
+            continue;
+         }
+         idx = (uint8)late;
+         placed[pos - first] = FALSE;
+         salvage = TRUE;
+         salvaged++;
+      }
+      /* rx buffer of index, the driver may swap it on receive */
+      rxbuf = context->port->rxbuf[idx];
       /* check if there is input data in frame */
       if (wkc2 > EC_NOFRAME)
       {
-         if((rxbuf[idx][EC_CMDOFFSET]==EC_CMD_LRD) || (rxbuf[idx][EC_CMDOFFSET]==EC_CMD_LRW))
+         if (salvage)
+         {
+            /* only the inputs are taken and its WKC added, the outputs and
+             * DC time are those of the cycle before */
+            if (idxstack->dcoffset[pos] > 0)
+            {
+               /* WKC of the process data datagram, not of the DC one after it */
+               memcpy(&le_wkc, &(rxbuf[EC_HEADERSIZE + idxstack->length[pos]]), EC_WKCSIZE);
+               wkc2 = etohs(le_wkc);
+            }
+            if (rxbuf[EC_CMDOFFSET] == EC_CMD_LWR)
+            {
+               wkc += wkc2 * 2;
+               valid_wkc = 1;
+            }
+            else if ((rxbuf[EC_CMDOFFSET] == EC_CMD_LRD) || (rxbuf[EC_CMDOFFSET] == EC_CMD_LRW))
+            {
+               ecx_salvageinputs(grp, idxstack->data[pos], idxstack->length[pos], rxbuf);
+               wkc += wkc2;
+               valid_wkc = 1;
+            }
+         }
+         else if((rxbuf[EC_CMDOFFSET]==EC_CMD_LRD) || (rxbuf[EC_CMDOFFSET]==EC_CMD_LRW))
          {
             if(idxstack->dcoffset[pos] > 0)
             {
-               memcpy(idxstack->data[pos], &(rxbuf[idx][EC_HEADERSIZE]), idxstack->length[pos]);
-               memcpy(&le_wkc, &(rxbuf[idx][EC_HEADERSIZE + idxstack->length[pos]]), EC_WKCSIZE);
+               if (!placed[pos - first])
+               {
+                  memcpy(idxstack->data[pos], &(rxbuf[EC_HEADERSIZE]), idxstack->length[pos]);
+               }
+               memcpy(&le_wkc, &(rxbuf[EC_HEADERSIZE + idxstack->length[pos]]), EC_WKCSIZE);
                wkc = etohs(le_wkc);
-               memcpy(&le_DCtime, &(rxbuf[idx][idxstack->dcoffset[pos]]), sizeof(le_DCtime));
+               memcpy(&le_DCtime, &(rxbuf[idxstack->dcoffset[pos]]), sizeof(le_DCtime));
                *(context->DCtime) = etohll(le_DCtime);
             }
             else
             {
                /* copy input data back to process data buffer */
-               memcpy(idxstack->data[pos], &(rxbuf[idx][EC_HEADERSIZE]), idxstack->length[pos]);
+               if (!placed[pos - first])
+               {
+                  memcpy(idxstack->data[pos], &(rxbuf[EC_HEADERSIZE]), idxstack->length[pos]);
+               }
                wkc += wkc2;
             }
             valid_wkc = 1;
          }
-         else if(rxbuf[idx][EC_CMDOFFSET]==EC_CMD_LWR)
+         else if(rxbuf[EC_CMDOFFSET]==EC_CMD_LWR)
          {
             if(idxstack->dcoffset[pos] > 0)
             {
-               memcpy(&le_wkc, &(rxbuf[idx][EC_HEADERSIZE + idxstack->length[pos]]), EC_WKCSIZE);
+               memcpy(&le_wkc, &(rxbuf[EC_HEADERSIZE + idxstack->length[pos]]), EC_WKCSIZE);
                /* output WKC counts 2 times when using LRW, emulate the same for LWR */
                wkc = etohs(le_wkc) * 2;
-               memcpy(&le_DCtime, &(rxbuf[idx][idxstack->dcoffset[pos]]), sizeof(le_DCtime));
+               memcpy(&le_DCtime, &(rxbuf[idxstack->dcoffset[pos]]), sizeof(le_DCtime));
                *(context->DCtime) = etohll(le_DCtime);
             }
             else
@@ -1979,19 +2647,47 @@ int ecx_receive_processdata_group(ecx_contextt *context, uint8 group, int timeou
             valid_wkc = 1;
          }
       }
+      if (stats && (pos - first < EC_MAXGROUPFRAMES))
+      {
+         /* wire time is only known with packet timestamps */
+         wire[pos - first] = 0;
+         if (ecx_getframetime(context->port, idx, &txtime, &rxtime) && txtime && rxtime)
+         {
+            wire[pos - first] = rxtime - txtime;
+         }
+      }
       /* release buffer */
       ecx_setbufstat(context->port, idx, EC_BUF_EMPTY);
       /* get next index */
-      pos = ecx_pullindex(context);
+      pos = ecx_pullindex(idxstack);
    }
 
-   ecx_clearindex(context);
+   ecx_clearindex(idxstack);
+   /* late frames not needed are given back */
+   for (j = 0; j < nlate; j++)
+   {
+      if (latedata[j])
+      {
+         ecx_setbufstat(context->port, lateidx[j], EC_BUF_EMPTY);
+      }
+   }
+   /* asynchronous datagrams returned with the process data are done */
+   ecx_completedatagrams(context->port);
 
+   if (stats && n)
+   {
+      ecx_updatestats(grp, stats, wire, n, valid_wkc ? wkc : EC_NOFRAME,
+                      lost, retried, recovered, salvaged);
+   }
    /* if no frames has arrived */
    if (valid_wkc == 0)
    {
       return EC_NOFRAME;
    }
+   if (grp->image)
+   {
+      ecx_publishinputs(grp, grp->image);
+   }
    return wkc;
 }
 
@@ -2412,4 +3108,38 @@ int ec_receive_processdata(int timeout)
 {
    return ec_receive_processdata_group(0, timeout);
 }
+int ec_attachimage(uint8 group, ec_imaget *image, uint8 *buffer, int size)
+{
+   return ecx_attachimage(&ecx_context, group, image, buffer, size);
+}
+
+uint32 ec_readinputs(ec_imaget *image, uint32 offset, void *data, uint32 length)
+{
+   return ecx_readinputs(image, offset, data, length);
+}
+
+void ec_writeoutputs(ec_imaget *image, uint32 offset, const void *data, uint32 length)
+{
+   ecx_writeoutputs(image, offset, data, length);
+}
+
+uint32 ec_readslaveinputs(uint16 slave, void *data)
+{
+   return ecx_readslaveinputs(&ecx_context, slave, data);
+}
+
+void ec_writeslaveoutputs(uint16 slave, const void *data)
+{
+   ecx_writeslaveoutputs(&ecx_context, slave, data);
+}
+
+int ec_attachstats(uint8 group, ec_groupstatst *stats)
+{
+   return ecx_attachstats(&ecx_context, group, stats);
+}
+
+int ec_setlatepolicy(uint8 group, int policy, int retrytimeout)
+{
+   return ecx_setlatepolicy(&ecx_context, group, policy, retrytimeout);
+}
 #endif
@@ -24,7 +24,7 @@ extern "C"
 /** max. number of slaves in array */
 #define EC_MAXSLAVE       200
 /** max. number of groups */
-#define EC_MAXGROUP       2
+#define EC_MAXGROUP       8
 /** max. number of IO segments per group */
 #define EC_MAXIOSEGMENTS  64
 /** max. mailbox size */
@@ -165,6 +165,8 @@ typedef struct ec_slave
    uint16           mbx_proto;
    /** Counter value of mailbox link layer protocol 1..7 */
    uint8            mbx_cnt;
+   /** EoE frame number of the last frame sent */
+   uint8            eoe_frameno;
    /** has DC capability */
    boolean          hasdc;
    /** Physical type; Ebus, EtherNet combinations */
@@ -235,6 +237,120 @@ typedef struct ec_slave
    char             name[EC_MAXNAME + 1];
 } ec_slavet;
 
+/** max. number of precompiled frames of a group, LRD and LWR per segment */
+#define EC_MAXGROUPFRAMES (2 * EC_MAXIOSEGMENTS)
+
+/** Precompiled frame of the cyclic process data exchange of a group */
+typedef struct ec_frametemplate
+{
+   /** EtherCAT header of the process data datagram, index set on send */
+   ec_comt          header;
+   /** header of the FRMW DC datagram, index set on send */
+   ec_comt          dcheader;
+   /** outputs copied into the frame, NULL for LRD */
+   uint8            *txdata;
+   /** process data buffer of the inputs, pushed on the index stack */
+   uint8            *rxdata;
+   /** length of process data in datagram */
+   uint16           length;
+   /** offset of DC datagram data in rx frame, 0 without DC datagram */
+   uint16           DCO;
+   /** length of frame incl. ethernet header */
+   int              txlength;
+} ec_frametemplatet;
+
+/** stack structure to store segmented LRD/LWR/LRW constructs */
+typedef struct ec_idxstack
+{
+   uint16  pushed;
+   uint16  pulled;
+   uint8   idx[EC_MAXSLOTS];
+   void    *data[EC_MAXSLOTS];
+   uint16  length[EC_MAXSLOTS];
+   uint16  dcoffset[EC_MAXSLOTS];
+} ec_idxstackT;
+
+/** Process image of a group exchanged with application threads, see
+ * ecx_attachimage(). Inputs are published under a sequence counter after
+ * each receive, outputs are taken over before each send when no application
+ * thread writes them. The cyclic thread never waits on the image. */
+typedef struct ec_image
+{
+   /** inputs of the last cycle */
+   uint8            *inputs;
+   /** outputs written by the application */
+   uint8            *outputs;
+   /** input bytes of the group */
+   uint32           Ibytes;
+   /** output bytes of the group */
+   uint32           Obytes;
+   /** sequence of the inputs, odd while they are updated */
+   uint32           inseq;
+   /** set while a thread accesses the outputs */
+   int              outlock;
+   /** outputs written since they were taken over */
+   int              outdirty;
+   /** cycles the outputs were not taken over as they were locked */
+   uint32           outskipped;
+} ec_imaget;
+
+/** frames missing at the end of a receive are released, see ecx_setlatepolicy() */
+#define EC_LATE_DROP      0x00
+/** frames missing at the end of a receive are kept for a late arrival, that
+ * stands in for the same frame if it is missing in the next cycle */
+#define EC_LATE_SALVAGE   0x01
+/** frames missing at the end of a receive are sent once more */
+#define EC_LATE_RETRY     0x02
+
+/** buckets of the latency histogram, 8 per power of two up to 2^31 ns */
+#define EC_STATSBUCKETS   232
+
+/** Statistics of the cyclic exchange of a group, see ecx_attachstats().
+ * Only the cyclic thread writes it, readers take a consistent copy with
+ * ecx_readstats(). It holds no pointers, so it can be placed in shared
+ * memory and read by an other process. */
+typedef struct ec_groupstats
+{
+   /** size of the block, checked by readers in other processes */
+   uint32           size;
+   /** sequence, odd while the block is updated */
+   uint32           seq;
+   /** cycles received */
+   uint64           cycles;
+   /** cycles with a WKC below outputsWKC * 2 + inputsWKC */
+   uint64           wkcfaults;
+   /** frames not received within the timeout */
+   uint64           lostframes;
+   /** cycles with a latency above latelimit */
+   uint64           latecycles;
+   /** lost frames sent once more, see EC_LATE_RETRY */
+   uint64           retries;
+   /** lost frames answered when sent once more */
+   uint64           recovered;
+   /** lost frames replaced by the late frame of the cycle before, see EC_LATE_SALVAGE */
+   uint64           salvaged;
+   /** latency above which a cycle is late in ns, 0 for none */
+   int64            latelimit;
+   /** send to receive latency of the last cycle in ns */
+   int64            latency;
+   /** smallest latency in ns */
+   int64            minlatency;
+   /** largest latency in ns */
+   int64            maxlatency;
+   /** sum of all latencies in ns */
+   int64            totallatency;
+   /** frames of the last cycle */
+   uint32           nframes;
+   /** wire time per frame of the last cycle in ns, with ecx_settimestamping() */
+   int64            frametime[EC_MAXGROUPFRAMES];
+   /** largest wire time per frame in ns */
+   int64            framemax[EC_MAXGROUPFRAMES];
+   /** latency histogram, see ecx_statspercentile() */
+   uint32           histogram[EC_STATSBUCKETS];
+   /** internal, time the frames of the cycle were sent */
+   int64            sendtime;
+} ec_groupstatst;
+
 /** for list of ethercat slave groups */
 typedef struct ec_group
 {
@@ -270,6 +386,34 @@ typedef struct ec_group
    boolean          docheckstate;
    /** IO segmentation list. Datagrams must not break SM in two. */
    uint32           IOsegment[EC_MAXIOSEGMENTS];
+   /** frames are compiled, see ecx_compile_processdata_group() */
+   boolean          framescompiled;
+   /** frames are compiled for overlapping IOmap */
+   boolean          frameoverlap;
+   /** frames are compiled with DC datagram */
+   boolean          framedc;
+   /** configured address of DC slave the frames are compiled for */
+   uint16           framedcadr;
+   /** number of precompiled frames */
+   uint16           nframes;
+   /** precompiled frames of the cyclic exchange */
+   ec_frametemplatet frame[EC_MAXGROUPFRAMES];
+   /** process image exchanged with application threads, NULL if none */
+   ec_imaget        *image;
+   /** frames of the group in flight, groups are cycled independently */
+   ec_idxstackT     idxstack;
+   /** statistics of the cyclic exchange, NULL if none */
+   ec_groupstatst   *stats;
+   /** policy for frames missing at the end of a receive, EC_LATE_ flags */
+   int              latepolicy;
+   /** time in us frames sent once more are waited for */
+   int              retrytimeout;
+   /** frames of the last cycle kept for a late arrival */
+   uint16           nlate;
+   /** index of frames kept for a late arrival */
+   uint8            lateidx[EC_MAXGROUPFRAMES];
+   /** process data buffer of frames kept for a late arrival */
+   void             *latedata[EC_MAXGROUPFRAMES];
 } ec_groupt;
 
 /** SII FMMU structure */
@@ -332,17 +476,6 @@ typedef struct PACKED ec_alstatus
 } ec_alstatust;
 PACKED_END
 
-/** stack structure to store segmented LRD/LWR/LRW constructs */
-typedef struct ec_idxstack
-{
-   uint8   pushed;
-   uint8   pulled;
-   uint8   idx[EC_MAXBUF];
-   void    *data[EC_MAXBUF];
-   uint16  length[EC_MAXBUF];
-   uint16  dcoffset[EC_MAXBUF];
-} ec_idxstackT;
-
 /** ringbuf for error storage */
 typedef struct ec_ering
 {
@@ -404,7 +537,8 @@ struct ecx_context
    uint16         esislave;
    /** internal, reference to error list */
    ec_eringt      *elist;
-   /** internal, reference to processdata stack buffer info */
+   /** index stack of group 0, set by ecx_init() and ecx_config_init(), each
+    * group has its own in grouplist[n].idxstack (DEPRECATED) */
    ec_idxstackT   *idxstack;
    /** reference to ecaterror state */
    boolean        *ecaterror;
@@ -480,6 +614,13 @@ int ec_receive_processdata_group(uint8 group, int timeout);
 int ec_send_processdata(void);
 int ec_send_overlap_processdata(void);
 int ec_receive_processdata(int timeout);
+int ec_attachimage(uint8 group, ec_imaget *image, uint8 *buffer, int size);
+uint32 ec_readinputs(ec_imaget *image, uint32 offset, void *data, uint32 length);
+void ec_writeoutputs(ec_imaget *image, uint32 offset, const void *data, uint32 length);
+uint32 ec_readslaveinputs(uint16 slave, void *data);
+void ec_writeslaveoutputs(uint16 slave, const void *data);
+int ec_attachstats(uint8 group, ec_groupstatst *stats);
+int ec_setlatepolicy(uint8 group, int policy, int retrytimeout);
 #endif
 
 ec_adaptert * ec_find_adapters(void);
@@ -522,7 +663,17 @@ int ecx_receive_processdata_group(ecx_contextt *context, uint8 group, int timeou
 int ecx_send_processdata(ecx_contextt *context);
 int ecx_send_overlap_processdata(ecx_contextt *context);
 int ecx_receive_processdata(ecx_contextt *context, int timeout);
+int ecx_compile_processdata_group(ecx_contextt *context, uint8 group, boolean use_overlap_io);
 int ecx_send_processdata_group(ecx_contextt *context, uint8 group);
+int ecx_attachimage(ecx_contextt *context, uint8 group, ec_imaget *image, uint8 *buffer, int size);
+uint32 ecx_readinputs(ec_imaget *image, uint32 offset, void *data, uint32 length);
+void ecx_writeoutputs(ec_imaget *image, uint32 offset, const void *data, uint32 length);
+uint32 ecx_readslaveinputs(ecx_contextt *context, uint16 slave, void *data);
+void ecx_writeslaveoutputs(ecx_contextt *context, uint16 slave, const void *data);
+int ecx_attachstats(ecx_contextt *context, uint8 group, ec_groupstatst *stats);
+int ecx_readstats(const ec_groupstatst *stats, ec_groupstatst *copy);
+int64 ecx_statspercentile(const ec_groupstatst *stats, int permille);
+int ecx_setlatepolicy(ecx_contextt *context, uint8 group, int policy, int retrytimeout);
 
 #ifdef __cplusplus
 }
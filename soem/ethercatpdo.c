@@ -0,0 +1,441 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Typed access to the process data by the PDO mapping.
+ *
+ * The PDO mapping of a slave is read in a table of the objects mapped, with
+ * their place in the outputs or inputs, the same way the mapping is found by
+ * the configuration: by CoE if the slave has it, else from the SII. A handle
+ * made from the table once locates an object in the IOmap, so that cyclic
+ * code gets and sets it without lookup and without knowing the layout of the
+ * slave.
+ */
+#include <string.h>
+#include "oshw.h"
+#include "osal.h"
+#include "ethercattype.h"
+#include "ethercatbase.h"
+#include "ethercatmain.h"
+#include "ethercatcoe.h"
+#include "ethercatpdo.h"
+
+/** Data type of an object of which only the bit length is known.
+ * @param[in]  bitlength      = length of object in bits
+ * @return ECT_ type, 0 if none fits
+ */
+static uint16 ecx_pdotype(uint16 bitlength)
+{
+   switch (bitlength)
+   {
+      case 1:
+         return ECT_BOOLEAN;
+      case 8:
+         return ECT_UNSIGNED8;
+      case 16:
+         return ECT_UNSIGNED16;
+      case 24:
+         return ECT_UNSIGNED24;
+      case 32:
+         return ECT_UNSIGNED32;
+      case 64:
+         return ECT_UNSIGNED64;
+      default:
+         if (bitlength < 8)
+         {
+            return (uint16)(ECT_BIT1 + bitlength - 1);
+         }
+   }
+
+   return 0;
+}
+
+/** Add an object to a PDO table.
+ * @param[in,out] table       = PDO table
+ * @param[in]  index          = object index, 0 for a gap
+ * @param[in]  subindex       = object subindex
+ * @param[in]  output         = TRUE if mapped in the outputs
+ * @param[in]  datatype       = ECT_ type, 0 if not known
+ * @param[in]  bitlength      = length of object in bits
+ * @param[in,out] bitoffset   = offset of object, moved past it
+ */
+static void ecx_addpdoentry(ec_pdotablet *table, uint16 index, uint8 subindex, uint8 output,
+   uint16 datatype, uint16 bitlength, uint32 *bitoffset)
+{
+   ec_pdoentryt *entry;
+
+   if (table->nentries < EC_MAXPDOENTRY)
+   {
+      entry = &(table->entry[table->nentries++]);
+      entry->index = index;
+      entry->subindex = subindex;
+      entry->output = output;
+      entry->datatype = datatype ? datatype : ecx_pdotype(bitlength);
+      entry->bitlength = bitlength;
+      entry->bitoffset = *bitoffset;
+   }
+   *bitoffset += bitlength;
+}
+
+/** Walk the PDOs of a SII PDO category. Entries of the PDOs assigned to SM
+ * are added to table, or with bitoffset NULL the data types of the entries in
+ * table are set from the category.
+ * @param[in]  context        = context struct
+ * @param[in]  slave          = slave number
+ * @param[in]  t              = 0=TXPDO (inputs) 1=RXPDO (outputs) category
+ * @param[in]  sm             = SM of PDOs added
+ * @param[in,out] table       = PDO table
+ * @param[in,out] bitoffset   = offset of next object added, NULL to set types
+ */
+static void ecx_siipdowalk(ecx_contextt *context, uint16 slave, uint8 t, uint8 sm,
+   ec_pdotablet *table, uint32 *bitoffset)
+{
+   int16 start;
+   uint16 a, w, c, e, er, eindex;
+   uint8 esub, etype, elength, esm;
+   int i;
+
+   start = ecx_siifind(context, slave, ECT_SII_PDO + t);
+   if (start <= 0)
+   {
+      return;
+   }
+   a = (uint16)start;
+   w = ecx_siigetbyte(context, slave, a++);
+   w += (ecx_siigetbyte(context, slave, a++) << 8);
+   /* every PDO is 4 words and 4 words per entry */
+   for (c = 0; (c + 4) <= w; c += 4 * (e + 1))
+   {
+      a += 2;
+      e = ecx_siigetbyte(context, slave, a++);
+      esm = ecx_siigetbyte(context, slave, a++);
+      a += 4;
+      for (er = 0; er < e; er++)
+      {
+         eindex = ecx_siigetbyte(context, slave, a++);
+         eindex += (ecx_siigetbyte(context, slave, a++) << 8);
+         esub = ecx_siigetbyte(context, slave, a++);
+         a++;
+         etype = ecx_siigetbyte(context, slave, a++);
+         elength = ecx_siigetbyte(context, slave, a++);
+         a += 2;
+         if (!bitoffset)
+         {
+            for (i = 0; i < table->nentries; i++)
+            {
+               if (eindex && etype && (table->entry[i].index == eindex) &&
+                   (table->entry[i].subindex == esub) && (table->entry[i].output == t))
+               {
+                  table->entry[i].datatype = etype;
+               }
+            }
+         }
+         else if (esm == sm)
+         {
+            ecx_addpdoentry(table, eindex, esub, t, etype, elength, bitoffset);
+         }
+      }
+   }
+}
+
+/** Read the objects of the PDOs assigned to a SM by CoE.
+ * @param[in]  context        = context struct
+ * @param[in]  slave          = slave number
+ * @param[in]  sm             = SM number
+ * @param[in]  output         = TRUE if SM has outputs
+ * @param[in,out] table       = PDO table
+ * @param[in,out] bitoffset   = offset of next object
+ * @return >0 if the assignment was read
+ */
+static int ecx_readpdoassign(ecx_contextt *context, uint16 slave, uint8 sm, uint8 output,
+   ec_pdotablet *table, uint32 *bitoffset)
+{
+   uint16 rdat, pdo;
+   uint8 npdo, nentry, p, e;
+   uint32 rdat2;
+   int wkc, rdl;
+
+   rdl = sizeof(npdo); npdo = 0;
+   wkc = ecx_SDOread(context, slave, ECT_SDO_PDOASSIGN + sm, 0x00, FALSE, &rdl, &npdo, EC_TIMEOUTRXM);
+   if (wkc <= 0)
+   {
+      return 0;
+   }
+   for (p = 1; p <= npdo; p++)
+   {
+      rdl = sizeof(rdat); rdat = 0;
+      wkc = ecx_SDOread(context, slave, ECT_SDO_PDOASSIGN + sm, p, FALSE, &rdl, &rdat, EC_TIMEOUTRXM);
+      pdo = etohs(rdat);
+      if ((wkc <= 0) || !pdo)
+      {
+         continue;
+      }
+      rdl = sizeof(nentry); nentry = 0;
+      ecx_SDOread(context, slave, pdo, 0x00, FALSE, &rdl, &nentry, EC_TIMEOUTRXM);
+      for (e = 1; e <= nentry; e++)
+      {
+         rdl = sizeof(rdat2); rdat2 = 0;
+         wkc = ecx_SDOread(context, slave, pdo, e, FALSE, &rdl, &rdat2, EC_TIMEOUTRXM);
+         rdat2 = etohl(rdat2);
+         /* index, subindex and bit length of object mapped */
+         if ((wkc > 0) && (LO_BYTE(rdat2) < 0xff))
+         {
+            ecx_addpdoentry(table, (uint16)(rdat2 >> 16), (uint8)(rdat2 >> 8), output,
+                            0, LO_BYTE(rdat2), bitoffset);
+         }
+      }
+   }
+
+   return 1;
+}
+
+/** Read the PDO mapping of a slave in a table of the objects mapped. Call it
+ * after the slave is mapped, the SM types found by the configuration select
+ * the SMs read. The mapping is read by CoE if the slave has CoE, else from the
+ * SII, as the configuration does. The data types of objects are taken from
+ * the SII if it has them, else they follow from the bit length as unsigned.
+ * @param[in]  context        = context struct
+ * @param[in]  slave          = slave number
+ * @param[out] table          = PDO table
+ * @return number of entries in table
+ */
+int ecx_readpdotable(ecx_contextt *context, uint16 slave, ec_pdotablet *table)
+{
+   ec_slavet *csl;
+   uint32 bitoffset;
+   uint8 sm, output, eectl;
+   int dir;
+
+   csl = &(context->slavelist[slave]);
+   eectl = csl->eep_pdi;
+   table->slave = slave;
+   table->nentries = 0;
+   if (csl->mbx_proto & ECT_MBXPROT_COE)
+   {
+      /* outputs first, both in the order of the SMs */
+      for (dir = 0; dir < 2; dir++)
+      {
+         output = (dir == 0);
+         bitoffset = 0;
+         for (sm = 2; sm < EC_MAXSM; sm++)
+         {
+            if (csl->SMtype[sm] == (output ? 3 : 4))
+            {
+               ecx_readpdoassign(context, slave, sm, output, table, &bitoffset);
+            }
+         }
+      }
+      /* PDO entries in the SII have the data types */
+      ecx_siipdowalk(context, slave, TRUE, 0, table, NULL);
+      ecx_siipdowalk(context, slave, FALSE, 0, table, NULL);
+   }
+   if (!table->nentries)
+   {
+      for (dir = 0; dir < 2; dir++)
+      {
+         output = (dir == 0);
+         bitoffset = 0;
+         for (sm = 0; sm < EC_MAXSM; sm++)
+         {
+            if (csl->SMtype[sm] == (output ? 3 : 4))
+            {
+               ecx_siipdowalk(context, slave, output, sm, table, &bitoffset);
+            }
+         }
+      }
+   }
+   if (eectl)
+   {
+      ecx_eeprom2pdi(context, slave); /* if eeprom control was previously pdi then restore */
+   }
+
+   return table->nentries;
+}
+
+/** Find an object in a PDO table.
+ * @param[in]  table          = PDO table
+ * @param[in]  index          = object index
+ * @param[in]  subindex       = object subindex
+ * @return entry of object, NULL if not mapped
+ */
+const ec_pdoentryt *ecx_findpdoentry(const ec_pdotablet *table, uint16 index, uint8 subindex)
+{
+   int i;
+
+   for (i = 0; i < table->nentries; i++)
+   {
+      if (index && (table->entry[i].index == index) && (table->entry[i].subindex == subindex))
+      {
+         return &(table->entry[i]);
+      }
+   }
+
+   return NULL;
+}
+
+/** Make the handle of a mapped object, after the IOmap of the slave is set
+ * up. The handle stays valid as long as the IOmap.
+ * @param[in]  context        = context struct
+ * @param[in]  table          = PDO table of slave
+ * @param[in]  index          = object index
+ * @param[in]  subindex       = object subindex
+ * @param[out] handle         = handle of object, data is NULL if not mapped
+ * @return >0 if the object is mapped
+ */
+int ecx_pdohandle(ecx_contextt *context, const ec_pdotablet *table, uint16 index,
+   uint8 subindex, ec_pdohandlet *handle)
+{
+   const ec_pdoentryt *entry;
+   ec_slavet *csl;
+   uint8 *start;
+   uint32 bits, startbit;
+
+   memset(handle, 0, sizeof(*handle));
+   entry = ecx_findpdoentry(table, index, subindex);
+   if (!entry || !entry->bitlength || (entry->bitlength > 64))
+   {
+      return 0;
+   }
+   csl = &(context->slavelist[table->slave]);
+   start = entry->output ? csl->outputs : csl->inputs;
+   bits = entry->output ? csl->Obits : csl->Ibits;
+   startbit = entry->output ? csl->Ostartbit : csl->Istartbit;
+   if (!start || ((entry->bitoffset + entry->bitlength) > bits))
+   {
+      return 0;
+   }
+   startbit += entry->bitoffset;
+   /* an object not byte aligned is read in 64 bits */
+   if (((startbit & 7) + entry->bitlength) > 64)
+   {
+      return 0;
+   }
+   handle->data = start + (startbit >> 3);
+   handle->bitshift = (uint8)(startbit & 7);
+   handle->output = entry->output;
+   handle->bitlength = entry->bitlength;
+   handle->datatype = entry->datatype;
+
+   return 1;
+}
+
+/** Get a mapped object from the IOmap.
+ * @param[in]  handle         = handle of object
+ * @return value of object, zero extended
+ */
+uint64 ecx_pdoget(const ec_pdohandlet *handle)
+{
+   uint64 value;
+   uint32 v32;
+   uint16 v16;
+   int i;
+
+   if (!handle->bitshift)
+   {
+      switch (handle->bitlength)
+      {
+         case 8:
+            return handle->data[0];
+         case 16:
+            memcpy(&v16, handle->data, sizeof(v16));
+            return etohs(v16);
+         case 32:
+            memcpy(&v32, handle->data, sizeof(v32));
+            return etohl(v32);
+         case 64:
+            memcpy(&value, handle->data, sizeof(value));
+            return etohll(value);
+      }
+   }
+   /* bits of object are spread over the bytes */
+   value = 0;
+   for (i = (handle->bitshift + handle->bitlength - 1) >> 3; i >= 0; i--)
+   {
+      value = (value << 8) | handle->data[i];
+   }
+   value >>= handle->bitshift;
+   if (handle->bitlength < 64)
+   {
+      value &= ((uint64)1 << handle->bitlength) - 1;
+   }
+
+   return value;
+}
+
+/** Get a signed mapped object from the IOmap.
+ * @param[in]  handle         = handle of object
+ * @return value of object, sign extended
+ */
+int64 ecx_pdogetsigned(const ec_pdohandlet *handle)
+{
+   uint64 value;
+
+   value = ecx_pdoget(handle);
+   if ((handle->bitlength < 64) && (value >> (handle->bitlength - 1)))
+   {
+      value |= ~(uint64)0 << handle->bitlength;
+   }
+
+   return (int64)value;
+}
+
+/** Set a mapped object in the IOmap. The bytes an object not byte aligned
+ * shares with other objects are read and written back, objects sharing a
+ * byte are set from one thread.
+ * @param[in]  handle         = handle of object
+ * @param[in]  value          = value of object, bits above its length are ignored
+ */
+void ecx_pdoset(const ec_pdohandlet *handle, uint64 value)
+{
+   uint64 mask;
+   uint32 v32;
+   uint16 v16;
+   uint8 b;
+   int i, n;
+
+   if (!handle->bitshift)
+   {
+      switch (handle->bitlength)
+      {
+         case 8:
+            handle->data[0] = (uint8)value;
+            return;
+         case 16:
+            v16 = htoes((uint16)value);
+            memcpy(handle->data, &v16, sizeof(v16));
+            return;
+         case 32:
+            v32 = htoel((uint32)value);
+            memcpy(handle->data, &v32, sizeof(v32));
+            return;
+         case 64:
+            value = htoell(value);
+            memcpy(handle->data, &value, sizeof(value));
+            return;
+      }
+   }
+   mask = (handle->bitlength < 64) ? ((uint64)1 << handle->bitlength) - 1 : ~(uint64)0;
+   mask <<= handle->bitshift;
+   value = (value << handle->bitshift) & mask;
+   n = (handle->bitshift + handle->bitlength + 7) >> 3;
+   for (i = 0; i < n; i++)
+   {
+      b = (uint8)(mask >> (i * 8));
+      handle->data[i] = (uint8)((handle->data[i] & ~b) | (uint8)(value >> (i * 8)));
+   }
+}
+
+#ifdef EC_VER1
+int ec_readpdotable(uint16 slave, ec_pdotablet *table)
+{
+   return ecx_readpdotable(&ecx_context, slave, table);
+}
+
+int ec_pdohandle(const ec_pdotablet *table, uint16 index, uint8 subindex, ec_pdohandlet *handle)
+{
+   return ecx_pdohandle(&ecx_context, table, index, subindex, handle);
+}
+#endif
@@ -0,0 +1,83 @@
+/*
+ * Licensed under the GNU General Public License version 2 with exceptions. See
+ * LICENSE file in the project root for full license information
+ */
+
+/** \file
+ * \brief
+ * Headerfile for ethercatpdo.c
+ */
+
+#ifndef _EC_ECATPDO_H
+#define _EC_ECATPDO_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** max. number of mapped objects in the PDO table of a slave */
+#define EC_MAXPDOENTRY     128
+
+/** Object mapped in the process data of a slave */
+typedef struct
+{
+   /** object index, 0 for a gap */
+   uint16           index;
+   /** object subindex */
+   uint8            subindex;
+   /** TRUE if mapped in the outputs, FALSE if in the inputs */
+   uint8            output;
+   /** data type of object, ECT_ type, from the SII or else by bit length */
+   uint16           datatype;
+   /** length of object in bits */
+   uint16           bitlength;
+   /** offset of object in bits from the start of the slave outputs or inputs */
+   uint32           bitoffset;
+} ec_pdoentryt;
+
+/** Table of the objects mapped in the process data of a slave, in the order
+ * of the IOmap */
+typedef struct
+{
+   /** slave number */
+   uint16           slave;
+   /** number of entries */
+   uint16           nentries;
+   /** mapped objects, outputs first */
+   ec_pdoentryt     entry[EC_MAXPDOENTRY];
+} ec_pdotablet;
+
+/** Handle of a mapped object, to get and set it in the IOmap without lookup */
+typedef struct
+{
+   /** first byte of object in the IOmap, NULL if not mapped */
+   uint8            *data;
+   /** bit of the first byte the object starts at */
+   uint8            bitshift;
+   /** TRUE if mapped in the outputs */
+   uint8            output;
+   /** length of object in bits, up to 64 */
+   uint16           bitlength;
+   /** data type of object, ECT_ type */
+   uint16           datatype;
+} ec_pdohandlet;
+
+#ifdef EC_VER1
+int ec_readpdotable(uint16 slave, ec_pdotablet *table);
+int ec_pdohandle(const ec_pdotablet *table, uint16 index, uint8 subindex, ec_pdohandlet *handle);
+#endif
+
+int ecx_readpdotable(ecx_contextt *context, uint16 slave, ec_pdotablet *table);
+const ec_pdoentryt *ecx_findpdoentry(const ec_pdotablet *table, uint16 index, uint8 subindex);
+int ecx_pdohandle(ecx_contextt *context, const ec_pdotablet *table, uint16 index,
+   uint8 subindex, ec_pdohandlet *handle);
+uint64 ecx_pdoget(const ec_pdohandlet *handle);
+int64 ecx_pdogetsigned(const ec_pdohandlet *handle);
+void ecx_pdoset(const ec_pdohandlet *handle, uint64 value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EC_ECATPDO_H */
@@ -55,7 +55,8 @@ typedef struct
    char                errordescription[EC_MAXERRORNAME + 1];
 } ec_mbxerrorlist_t;
 
-char estring[EC_MAXERRORNAME];
+/* per thread, so masters in different threads do not overwrite each other */
+static OSAL_THREAD_LOCAL char estring[EC_MAXERRORNAME];
 
 /** SDO error list definition */
 const ec_sdoerrorlist_t ec_sdoerrorlist[] = {
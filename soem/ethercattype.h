@@ -47,6 +47,8 @@ extern "C"
 #define EC_SLAVECOUNTEXCEEDED -4
 /** return value request timeout */
 #define EC_TIMEOUT            -5
+/** return value request not completed yet */
+#define EC_PENDING            -6
 /** maximum EtherCAT frame length in bytes */
 #define EC_MAXECATFRAME    1518
 /** maximum EtherCAT LRW frame length in bytes */
@@ -60,6 +62,9 @@ extern "C"
 #define EC_ECATTYPE        0x1000
 /** number of frame buffers per channel (tx, rx1 rx2) */
 #define EC_MAXBUF          16
+/** max. number of frame buffers per channel of ports that allocate their
+ * buffers at setup, limited by the 8 bit datagram index */
+#define EC_MAXSLOTS        256
 /** timeout value in us for tx frame to return to rx */
 #define EC_TIMEOUTRET      2000
 /** timeout value in us for safe data transfer, max. triple retry */
@@ -186,6 +191,45 @@ typedef enum
    EC_BUF_COMPLETE     = 0x04
 } ec_bufstate;
 
+/** max. number of asynchronous datagrams in flight per port */
+#define EC_MAXASYNC        8
+
+/** Completion callback of an asynchronous datagram, called from the thread
+ * that completes it, see ecx_startdatagram() */
+typedef void (*ec_asynccbT)(int handle, int wkc, void *userdata);
+
+/** asynchronous datagram slot states */
+enum
+{
+   EC_ASYNC_FREE = 0,
+   EC_ASYNC_SETUP,
+   EC_ASYNC_PENDING,
+   EC_ASYNC_BUSY,
+   EC_ASYNC_DONE
+};
+
+/** Asynchronous datagram in flight */
+typedef struct
+{
+   /** slot state, EC_ASYNC_xxx, changed with CAS */
+   int         state;
+   /** index of the frame */
+   uint8       idx;
+   /** command of the datagram */
+   uint8       com;
+   /** length of datagram data */
+   uint16      length;
+   /** databuffer filled with the data read */
+   void        *data;
+   /** Workcounter or EC_NOFRAME once done */
+   int         wkc;
+   /** frame is given up when expired */
+   osal_timert timer;
+   /** completion callback, NULL if polled */
+   ec_asynccbT callback;
+   void        *userdata;
+} ec_asyncT;
+
 /** Ethercat data types */
 typedef enum
 {
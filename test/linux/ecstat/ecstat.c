@@ -0,0 +1,98 @@
+/** \file
+ * \brief Cycle statistics monitor for Simple Open EtherCAT master
+ *
+ * Usage: ecstat STATS [interval] [count]
+ * STATS is the shared memory object a master exports the statistics of a
+ * group in, f.e. /simbench for simbench -s /simbench. Every interval ms,
+ * 1000 by default, a consistent copy is taken without stopping the cycle and
+ * the cycles, faults and latencies since the last line are printed. With
+ * count the monitor stops after count lines.
+ *
+ * A master exports a group by mapping the object and attaching it:
+ *
+ *   fd = shm_open("/name", O_CREAT | O_RDWR, 0644);
+ *   ftruncate(fd, sizeof(ec_groupstatst));
+ *   stats = mmap(NULL, sizeof(ec_groupstatst), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+ *   ecx_attachstats(context, group, stats);
+ */
+
+#include "ethercat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static ec_groupstatst now;
+static ec_groupstatst last;
+
+static void
+print_frames(const ec_groupstatst *stats)
+{
+    uint32 f;
+
+    for (f = 0; f < stats->nframes; ++f) {
+        if (stats->frametime[f]) {
+            printf("    frame %2u wire %8.1f max %8.1f usec\n", f,
+                   stats->frametime[f] / 1e3, stats->framemax[f] / 1e3);
+        }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    const ec_groupstatst *stats;
+    uint64 cycles;
+    int fd, interval, count, line;
+
+    if (argc < 2) {
+        printf("Usage: ecstat STATS [interval] [count]\n"
+               "STATS is the shared memory object of the statistics, f.e. /simbench\n"
+               "interval in ms defaults to 1000, without count it runs until stopped\n");
+        return 1;
+    }
+    interval = argc > 2 ? atoi(argv[2]) : 1000;
+    count = argc > 3 ? atoi(argv[3]) : 0;
+    if (interval < 1) {
+        interval = 1;
+    }
+    fd = shm_open(argv[1], O_RDONLY, 0);
+    if (fd < 0) {
+        printf("Cannot open '%s'\n", argv[1]);
+        return 1;
+    }
+    stats = mmap(NULL, sizeof(*stats), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (stats == MAP_FAILED) {
+        printf("Cannot map '%s'\n", argv[1]);
+        return 1;
+    }
+
+    printf("  %10s %8s %8s %8s %8s %8s %8s %8s %8s %8s\n", "cycles", "wkcerr", "lost",
+           "recov", "salv", "late", "min", "p50", "p99", "max");
+    for (line = 0; !count || line < count; ++line) {
+        usleep(interval * 1000);
+        if (!ecx_readstats(stats, &now)) {
+            printf("'%s' holds no statistics of this version\n", argv[1]);
+            break;
+        }
+        cycles = now.cycles - last.cycles;
+        /* min and max are over the whole run, the percentiles as well */
+        printf("  %10llu %8llu %8llu %8llu %8llu %8llu %8.1f %8.1f %8.1f %8.1f\n",
+               (unsigned long long)cycles,
+               (unsigned long long)(now.wkcfaults - last.wkcfaults),
+               (unsigned long long)(now.lostframes - last.lostframes),
+               (unsigned long long)(now.recovered - last.recovered),
+               (unsigned long long)(now.salvaged - last.salvaged),
+               (unsigned long long)(now.latecycles - last.latecycles),
+               now.minlatency / 1e3, ecx_statspercentile(&now, 500) / 1e3,
+               ecx_statspercentile(&now, 990) / 1e3, now.maxlatency / 1e3);
+        print_frames(&now);
+        memcpy(&last, &now, sizeof(last));
+    }
+    munmap((void *)stats, sizeof(*stats));
+
+    return 0;
+}
@@ -0,0 +1,268 @@
+/** \file
+ * \brief Frame index allocator benchmark for Simple Open EtherCAT master
+ *
+ * Usage: idxbench IFNAME [threads] [ops] [hold] [maxbuf]
+ * IFNAME is any interface the port can be opened on, f.e. "lo", no frames
+ * are sent. maxbuf is the number of frame indexes of the port.
+ *
+ * Every thread repeatedly allocates hold frame indexes with ecx_getindex()
+ * and releases them with ecx_setbufstat(), as the cyclic and mailbox threads
+ * of a master do. The lock-free allocator of the port is compared with the
+ * previous PI mutex allocator, reproduced here. Reported are the throughput
+ * of all threads, the latency of one allocation and the number of indexes
+ * handed out twice.
+ */
+
+#include "ethercat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define BENCH_MAXTHREADS    16
+#define BENCH_SAMPLES       100000
+
+typedef struct {
+    const char *    name;
+    uint8           (*getindex)(void);
+    void            (*release)(uint8 idx);
+} Allocator;
+
+typedef struct {
+    const Allocator *allocator;
+    int             ops;
+    int             hold;
+    int64 *         samples;
+    int             nsamples;
+    pthread_t       thread;
+} Worker;
+
+typedef struct {
+    double          mops;
+    int64           avg;
+    int64           p50;
+    int64           p99;
+    int64           max;
+    int             dups;
+} Result;
+
+static ecx_portt port;
+
+/* owner count of every index, more than one is a double allocation */
+static int owners[EC_MAXSLOTS];
+static int dups;
+
+/* previous allocator, linear scan under a priority inheritance mutex */
+static pthread_mutex_t mutex;
+static int mutexstat[EC_MAXSLOTS];
+static int mutexlastidx;
+
+static int64
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+cmp_int64(const void *a, const void *b)
+{
+    int64 x = *(const int64 *)a;
+    int64 y = *(const int64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+static uint8
+mutex_getindex(void)
+{
+    int idx;
+    int cnt;
+
+    pthread_mutex_lock(&mutex);
+    idx = mutexlastidx + 1;
+    if (idx >= port.maxbuf) {
+        idx = 0;
+    }
+    cnt = 0;
+    while ((mutexstat[idx] != EC_BUF_EMPTY) && (cnt < port.maxbuf)) {
+        idx++;
+        cnt++;
+        if (idx >= port.maxbuf) {
+            idx = 0;
+        }
+    }
+    mutexstat[idx] = EC_BUF_ALLOC;
+    mutexlastidx = idx;
+    pthread_mutex_unlock(&mutex);
+
+    return idx;
+}
+
+static void
+mutex_release(uint8 idx)
+{
+    mutexstat[idx] = EC_BUF_EMPTY;
+}
+
+static uint8
+port_getindex(void)
+{
+    return ecx_getindex(&port);
+}
+
+static void
+port_release(uint8 idx)
+{
+    ecx_setbufstat(&port, idx, EC_BUF_EMPTY);
+}
+
+static const Allocator allocators[] = {
+    { "mutex",  mutex_getindex, mutex_release },
+    { "atomic", port_getindex,  port_release },
+};
+
+static void *
+worker_thread(void *arg)
+{
+    Worker *worker = arg;
+    uint8 idx[EC_MAXSLOTS];
+    int64 start;
+    int i, h;
+
+    for (i = 0; i < worker->ops; i += worker->hold) {
+        for (h = 0; h < worker->hold; ++h) {
+            start = now_ns();
+            idx[h] = worker->allocator->getindex();
+            if (worker->nsamples < BENCH_SAMPLES) {
+                worker->samples[worker->nsamples++] = now_ns() - start;
+            }
+            if (__atomic_add_fetch(&owners[idx[h]], 1, __ATOMIC_RELAXED) > 1) {
+                __atomic_add_fetch(&dups, 1, __ATOMIC_RELAXED);
+            }
+        }
+        for (h = 0; h < worker->hold; ++h) {
+            __atomic_sub_fetch(&owners[idx[h]], 1, __ATOMIC_RELAXED);
+            worker->allocator->release(idx[h]);
+        }
+    }
+
+    return NULL;
+}
+
+static void
+bench_run(const Allocator *allocator, int threads, int ops, int hold,
+          Result *result)
+{
+    Worker workers[BENCH_MAXTHREADS];
+    int64 *samples;
+    int64 start, elapsed, total;
+    int t, n;
+
+    memset(owners, 0, sizeof(owners));
+    dups = 0;
+    samples = malloc(sizeof(*samples) * BENCH_SAMPLES * threads);
+    start = now_ns();
+    for (t = 0; t < threads; ++t) {
+        workers[t].allocator = allocator;
+        workers[t].ops = ops;
+        workers[t].hold = hold;
+        workers[t].samples = &samples[t * BENCH_SAMPLES];
+        workers[t].nsamples = 0;
+        pthread_create(&workers[t].thread, NULL, worker_thread, &workers[t]);
+    }
+    n = 0;
+    for (t = 0; t < threads; ++t) {
+        pthread_join(workers[t].thread, NULL);
+        memmove(&samples[n], workers[t].samples,
+                sizeof(*samples) * workers[t].nsamples);
+        n += workers[t].nsamples;
+    }
+    elapsed = now_ns() - start;
+
+    qsort(samples, n, sizeof(*samples), cmp_int64);
+    total = 0;
+    for (t = 0; t < n; ++t) {
+        total += samples[t];
+    }
+    result->mops = (double)threads * ops * 1000.0 / elapsed;
+    result->avg = total / n;
+    result->p50 = samples[n / 2];
+    result->p99 = samples[((int64)n * 99) / 100];
+    result->max = samples[n - 1];
+    result->dups = dups;
+    free(samples);
+}
+
+int
+main(int argc, char *argv[])
+{
+    pthread_mutexattr_t mutexattr;
+    Result result;
+    int threads, ops, hold, maxbuf;
+    size_t i;
+
+    if (argc < 2) {
+        printf("Usage: idxbench IFNAME [threads] [ops] [hold] [maxbuf]\n"
+               "threads defaults to 4, ops per thread to 1000000\n"
+               "hold is the number of indexes a thread holds at once, "
+               "default 2\n"
+               "maxbuf is the number of indexes, default %d, up to %d\n",
+               EC_MAXBUF, EC_MAXSLOTS);
+        return 1;
+    }
+    threads = argc > 2 ? atoi(argv[2]) : 4;
+    ops = argc > 3 ? atoi(argv[3]) : 1000000;
+    hold = argc > 4 ? atoi(argv[4]) : 2;
+    maxbuf = argc > 5 ? atoi(argv[5]) : EC_MAXBUF;
+    if (threads < 1) {
+        threads = 1;
+    } else if (threads > BENCH_MAXTHREADS) {
+        threads = BENCH_MAXTHREADS;
+    }
+    if (hold < 1) {
+        hold = 1;
+    }
+    if (!ecx_setmaxbuf(&port, maxbuf)) {
+        printf("maxbuf must be 1 to %d\n", EC_MAXSLOTS);
+        return 1;
+    }
+    /* more indexes in use than exist would make both allocators reuse */
+    if (threads * hold > maxbuf) {
+        hold = maxbuf / threads;
+        if (hold < 1) {
+            printf("At most %d threads\n", maxbuf);
+            return 1;
+        }
+    }
+    if (ops < hold) {
+        ops = hold;
+    }
+
+    if (!ecx_setupnic(&port, argv[1], FALSE)) {
+        printf("Cannot open port on '%s'\n", argv[1]);
+        return 1;
+    }
+    pthread_mutexattr_init(&mutexattr);
+    pthread_mutexattr_setprotocol(&mutexattr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&mutex, &mutexattr);
+
+    printf("%d threads, %d allocations each, %d of %d held at once, "
+           "times in nsec\n", threads, ops, hold, port.maxbuf);
+    printf("%-8s %8s %8s %8s %8s %8s %6s\n",
+           "alloc", "Mops/s", "avg", "p50", "p99", "max", "dups");
+    for (i = 0; i < sizeof(allocators) / sizeof(allocators[0]); ++i) {
+        bench_run(&allocators[i], threads, ops, hold, &result);
+        printf("%-8s %8.2f %8lld %8lld %8lld %8lld %6d\n", allocators[i].name,
+               result.mops, (long long)result.avg, (long long)result.p50,
+               (long long)result.p99, (long long)result.max, result.dups);
+    }
+
+    ecx_closenic(&port);
+    pthread_mutex_destroy(&mutex);
+
+    return 0;
+}
@@ -0,0 +1,348 @@
+/** \file
+ * \brief Benchmark of independent masters in one process for Simple Open
+ * EtherCAT master
+ *
+ * Usage: multibench [-p PERIOD] SLAVES SECONDS IFNAME:PEERIF [IFNAME:PEERIF ...]
+ * Every IFNAME:PEERIF pair, the two ends of a veth pair, gets its own
+ * simulated segment of SLAVES drives served on PEERIF and its own master
+ * context on IFNAME. All contexts are configured at the same time, one
+ * thread each, then the cyclic exchange is run for SECONDS with the first
+ * port only, the first two ports and so on up to all ports. Every cyclic
+ * thread is pinned to its own CPU and runs at SCHED_FIFO when permitted.
+ *
+ * Without -p the cycles are free running and the cycles per second of every
+ * port and of all ports together are reported. When the library is
+ * reentrant and there are enough CPUs the total scales linearly with the
+ * number of ports. With -p every thread cycles at PERIOD usec with
+ * clock_nanosleep and the overruns are counted instead.
+ *
+ * Create the veth pairs with:
+ *   ip link add ecat0 type veth peer name ecat1
+ *   ip link add ecat2 type veth peer name ecat3
+ *   ip link set ecat0 up; ip link set ecat1 up
+ *   ip link set ecat2 up; ip link set ecat3 up
+ */
+
+#define _GNU_SOURCE
+#include "ethercat.h"
+#include "ecsim.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_MAXPORT       16
+#define BENCH_MAXSLAVE      ECSIM_MAXSLAVE
+#define BENCH_IOMAPSIZE     (BENCH_MAXSLAVE * (ECSIM_RXPDOSIZE + ECSIM_TXPDOSIZE))
+#define BENCH_PRIORITY      40
+
+typedef struct {
+    ecx_contextt    context;
+    uint8           map[BENCH_IOMAPSIZE];
+    ecx_portt       port;
+    ec_slavet       slavelist[BENCH_MAXSLAVE + 1];
+    int             slavecount;
+    ec_groupt       grouplist[EC_MAXGROUP];
+    uint8           esibuf[EC_MAXEEPBUF];
+    uint32          esimap[EC_MAXEEPBITMAP];
+    ec_eringt       elist;
+    boolean         ecaterror;
+    int64           DCtime;
+    ec_SMcommtypet  SMcommtype[EC_MAX_MAPT];
+    ec_PDOassignt   PDOassign[EC_MAX_MAPT];
+    ec_PDOdesct     PDOdesc[EC_MAX_MAPT];
+    ec_eepromSMt    eepSM;
+    ec_eepromFMMUt  eepFMMU;
+} Fieldbus;
+
+typedef struct {
+    Fieldbus        fieldbus;
+    SimSegment     *sim;
+    char            ifname[32];
+    char            peerif[32];
+    int             cpu;
+    int             nslaves;
+    boolean         configured;
+    int64           seconds;
+    int64           period;
+    int64           cycles;
+    int64           wkcerrors;
+    int64           overruns;
+    int64           maxlate;
+    boolean         realtime;
+} Runner;
+
+static Runner *runners[BENCH_MAXPORT];
+
+static int64
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+fieldbus_initialize(Fieldbus *fb)
+{
+    ecx_contextt *context;
+
+    memset(fb, 0, sizeof(*fb));
+    context = &fb->context;
+    context->port = &fb->port;
+    context->slavelist = fb->slavelist;
+    context->slavecount = &fb->slavecount;
+    context->maxslave = BENCH_MAXSLAVE + 1;
+    context->grouplist = fb->grouplist;
+    context->maxgroup = EC_MAXGROUP;
+    context->esibuf = fb->esibuf;
+    context->esimap = fb->esimap;
+    context->esislave = 0;
+    context->elist = &fb->elist;
+    context->idxstack = &fb->grouplist[0].idxstack;
+    context->ecaterror = &fb->ecaterror;
+    context->DCtime = &fb->DCtime;
+    context->SMcommtype = fb->SMcommtype;
+    context->PDOassign = fb->PDOassign;
+    context->PDOdesc = fb->PDOdesc;
+    context->eepSM = &fb->eepSM;
+    context->eepFMMU = &fb->eepFMMU;
+    context->manualstatechange = 0;
+}
+
+static int
+fieldbus_roundtrip(Fieldbus *fb)
+{
+    ecx_send_processdata(&fb->context);
+    return ecx_receive_processdata(&fb->context, EC_TIMEOUTRET);
+}
+
+/* Pin the calling thread to cpu and with realtime raise it to SCHED_FIFO if
+ * permitted */
+static boolean
+runner_pin(int cpu, boolean realtime)
+{
+    struct sched_param param;
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (!realtime) {
+        return FALSE;
+    }
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = BENCH_PRIORITY;
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+/* Bring the segment of one runner to OP, concurrently with the others */
+static void *
+runner_configure(void *arg)
+{
+    Runner *r = arg;
+    Fieldbus *fb = &r->fieldbus;
+    ecx_contextt *context = &fb->context;
+    int i;
+
+    runner_pin(r->cpu, FALSE);
+    if (ecx_config_init(context, FALSE) != r->nslaves) {
+        printf("%s: found %d slaves, expected %d\n", r->ifname, fb->slavecount,
+               r->nslaves);
+        return NULL;
+    }
+    ecx_config_map_group(context, fb->map, 0);
+    ecx_configdc(context);
+    ecx_statecheck(context, 0, EC_STATE_SAFE_OP, EC_TIMEOUTSTATE * 4);
+    if (fb->slavelist[0].state != EC_STATE_SAFE_OP) {
+        printf("%s: not all slaves reached SAFE-OP\n", r->ifname);
+        return NULL;
+    }
+    fieldbus_roundtrip(fb);
+    fb->slavelist[0].state = EC_STATE_OPERATIONAL;
+    ecx_writestate(context, 0);
+    for (i = 0; i < 10; ++i) {
+        fieldbus_roundtrip(fb);
+        ecx_statecheck(context, 0, EC_STATE_OPERATIONAL, EC_TIMEOUTSTATE / 10);
+        if (fb->slavelist[0].state == EC_STATE_OPERATIONAL) {
+            break;
+        }
+    }
+    if (fb->slavelist[0].state != EC_STATE_OPERATIONAL) {
+        printf("%s: not all slaves reached OP\n", r->ifname);
+        return NULL;
+    }
+    r->configured = TRUE;
+
+    return NULL;
+}
+
+/* Cyclic exchange of one runner for r->seconds */
+static void *
+runner_cycle(void *arg)
+{
+    Runner *r = arg;
+    Fieldbus *fb = &r->fieldbus;
+    ec_groupt *grp = &fb->grouplist[0];
+    struct timespec next;
+    int64 start, end, wake, late;
+    int expected;
+
+    r->realtime = runner_pin(r->cpu, TRUE);
+    r->cycles = 0;
+    r->wkcerrors = 0;
+    r->overruns = 0;
+    r->maxlate = 0;
+    expected = grp->outputsWKC * 2 + grp->inputsWKC;
+    start = now_ns();
+    end = start + r->seconds * 1000000000;
+    wake = start;
+    while (now_ns() < end) {
+        if (r->period) {
+            wake += r->period;
+            next.tv_sec = wake / 1000000000;
+            next.tv_nsec = wake % 1000000000;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+            late = now_ns() - wake;
+            if (late > r->maxlate) {
+                r->maxlate = late;
+            }
+        }
+        if (fieldbus_roundtrip(fb) != expected) {
+            r->wkcerrors++;
+        }
+        r->cycles++;
+        if (r->period && (now_ns() > wake + r->period)) {
+            r->overruns++;
+        }
+    }
+
+    return NULL;
+}
+
+/* Run the cyclic exchange on the first nports runners at the same time */
+static void
+bench_run(int nports, int seconds, int period)
+{
+    pthread_t threads[BENCH_MAXPORT];
+    Runner *r;
+    double total;
+    int i;
+
+    for (i = 0; i < nports; ++i) {
+        runners[i]->seconds = seconds;
+        runners[i]->period = (int64)period * 1000;
+        pthread_create(&threads[i], NULL, runner_cycle, runners[i]);
+    }
+    for (i = 0; i < nports; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    total = 0;
+    printf("%d port%s\n", nports, nports > 1 ? "s" : "");
+    for (i = 0; i < nports; ++i) {
+        r = runners[i];
+        total += (double)r->cycles / seconds;
+        printf("  %-12s cpu %-3d %-5s %10.0f cycles/s %8lld wkcerr",
+               r->ifname, r->cpu, r->realtime ? "fifo" : "other",
+               (double)r->cycles / seconds, (long long)r->wkcerrors);
+        if (period) {
+            printf(" %8lld overruns %8.1f usec max late",
+                   (long long)r->overruns, r->maxlate / 1e3);
+        }
+        printf("\n");
+    }
+    printf("  %-28s %10.0f cycles/s\n", "total", total);
+}
+
+int
+main(int argc, char *argv[])
+{
+    pthread_t threads[BENCH_MAXPORT];
+    Runner *r;
+    char *sep;
+    int nslaves, seconds, period, nports, ncpu, i, ok;
+
+    period = 0;
+    if (argc > 2 && !strcmp(argv[1], "-p")) {
+        period = atoi(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 4) {
+        printf("Usage: multibench [-p PERIOD] SLAVES SECONDS IFNAME:PEERIF [IFNAME:PEERIF ...]\n"
+               "SLAVES is the number of simulated drives per port, up to %d\n"
+               "IFNAME and PEERIF are the two ends of a veth pair, up to %d pairs\n"
+               "-p cycles every PERIOD usec instead of free running\n",
+               ECSIM_MAXSLAVE, BENCH_MAXPORT);
+        return 1;
+    }
+    nslaves = atoi(argv[1]);
+    seconds = atoi(argv[2]);
+    if (seconds < 1) {
+        seconds = 1;
+    }
+    nports = argc - 3;
+    if (nports > BENCH_MAXPORT) {
+        nports = BENCH_MAXPORT;
+    }
+    ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < nports) {
+        printf("%d ports on %d cpus, the ports share cpus\n", nports, ncpu);
+    }
+
+    ok = TRUE;
+    for (i = 0; i < nports; ++i) {
+        r = calloc(1, sizeof(*r));
+        runners[i] = r;
+        snprintf(r->ifname, sizeof(r->ifname), "%s", argv[3 + i]);
+        sep = strchr(r->ifname, ':');
+        if (!sep) {
+            printf("Port '%s' is not IFNAME:PEERIF\n", argv[3 + i]);
+            return 1;
+        }
+        *sep = '\0';
+        snprintf(r->peerif, sizeof(r->peerif), "%s", sep + 1);
+        r->cpu = i % ncpu;
+        r->nslaves = nslaves;
+        r->sim = ecsim_create(nslaves);
+        fieldbus_initialize(&r->fieldbus);
+        if (!r->sim || !ecsim_start(r->sim, r->peerif)) {
+            printf("Cannot open segment on '%s'\n", r->peerif);
+            return 1;
+        }
+        if (!ecx_setupnic(&r->fieldbus.port, r->ifname, FALSE)) {
+            printf("Cannot open port '%s'\n", r->ifname);
+            return 1;
+        }
+    }
+
+    printf("configuration of %d ports of %d slaves\n", nports, nslaves);
+    for (i = 0; i < nports; ++i) {
+        pthread_create(&threads[i], NULL, runner_configure, runners[i]);
+    }
+    for (i = 0; i < nports; ++i) {
+        pthread_join(threads[i], NULL);
+        ok = ok && runners[i]->configured;
+    }
+
+    if (ok) {
+        for (i = 1; i <= nports; ++i) {
+            bench_run(i, seconds, period);
+        }
+    }
+
+    for (i = 0; i < nports; ++i) {
+        r = runners[i];
+        r->fieldbus.slavelist[0].state = EC_STATE_INIT;
+        ecx_writestate(&r->fieldbus.context, 0);
+        ecx_closenic(&r->fieldbus.port);
+        ecsim_destroy(r->sim);
+        free(r);
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,426 @@
+/** \file
+ * \brief NIC transport benchmark for Simple Open EtherCAT master
+ *
+ * Usage: nicbench IFNAME PEERIF [transport] [cycles] [frames] [wait] [tstamp]
+ * IFNAME is the master side of a veth pair, PEERIF the other end.
+ * frames is the number of frames in flight per cycle, up to EC_MAXSLOTS.
+ * transport is socket, mmap, xdp, batch, rxthread, loopback or all (default
+ * all). batch uses the plain socket with the batched sendmmsg()/recvmmsg()
+ * port API, rxthread the plain socket read by a receiver thread. loopback
+ * returns the frames in-process without NIC and measures the master stack
+ * alone, its working counters are not incremented.
+ * wait is timeout, busy, block or all (default timeout) and selects the
+ * frame wait mode of the port.
+ * tstamp is off, software or hardware (default off). With timestamps the
+ * average time between the transmit and receive stamp of a frame is shown
+ * as wire time, the cycle time minus wire time is spent in the host.
+ *
+ * A thread on PEERIF returns every EtherCAT frame with the working counters
+ * incremented, as a segment of slaves would. Each cycle sends the given
+ * number of LRW frames and waits for all of them; the cycle times and the
+ * CPU use of the benchmark thread of every transport and wait mode are
+ * reported side by side. Transports without timestamps show no wire time.
+ *
+ * Create the veth pair with:
+ *   ip link add ecat0 type veth peer name ecat1
+ *   ip link set ecat0 up
+ *   ip link set ecat1 up
+ */
+
+#include "ethercat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+
+#define BENCH_DATASIZE      64
+#define BENCH_WARMUP        100
+
+typedef struct {
+    const char *    name;
+    int             transport;
+    boolean         batch;
+    boolean         receiver;
+} Transport;
+
+typedef struct {
+    const char *    name;
+    int             mode;
+} WaitMode;
+
+typedef struct {
+    int64           min;
+    int64           avg;
+    int64           p50;
+    int64           p99;
+    int64           max;
+    int             lost;
+    double          cpu;
+    int64           wire;
+} Result;
+
+typedef struct {
+    const char *    ifname;
+    int             sock;
+    volatile int    running;
+    pthread_t       thread;
+} Echo;
+
+static const Transport transports[] = {
+    { "socket",   ECT_TRANSPORT_SOCKET, FALSE, FALSE },
+    { "mmap",     ECT_TRANSPORT_MMAP,   FALSE, FALSE },
+    { "xdp",      ECT_TRANSPORT_XDP,    FALSE, FALSE },
+    { "batch",    ECT_TRANSPORT_SOCKET, TRUE,  FALSE },
+    { "rxthread", ECT_TRANSPORT_SOCKET, FALSE, TRUE },
+    { "loopback", ECT_TRANSPORT_LOOPBACK, FALSE, FALSE },
+};
+
+static const WaitMode waitmodes[] = {
+    { "timeout", ECT_WAIT_TIMEOUT },
+    { "busy",    ECT_WAIT_BUSYPOLL },
+    { "block",   ECT_WAIT_BLOCK },
+};
+
+static const WaitMode tstampmodes[] = {
+    { "off",      ECT_TSTAMP_OFF },
+    { "software", ECT_TSTAMP_SOFTWARE },
+    { "hardware", ECT_TSTAMP_HARDWARE },
+};
+
+static ecx_portt port;
+
+/* sum and number of wire times of the frames of a run */
+static int64 wiretotal;
+static int wirecount;
+
+static int64
+clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int64
+now_ns(void)
+{
+    return clock_ns(CLOCK_MONOTONIC);
+}
+
+static int
+cmp_int64(const void *a, const void *b)
+{
+    int64 x = *(const int64 *)a;
+    int64 y = *(const int64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Increment the WKC of every datagram in the frame, as if one slave
+ * processed each of them. */
+static void
+echo_process(uint8 *frame, int length)
+{
+    int pos, dlength, hdrsize;
+    uint16 wkc;
+    ec_comt *datagram;
+
+    /* datagram header without the frame length word */
+    hdrsize = (int)(EC_HEADERSIZE - EC_ELENGTHSIZE);
+    pos = (int)(ETH_HEADERSIZE + EC_ELENGTHSIZE);
+    while (pos + hdrsize <= length) {
+        datagram = (ec_comt *)&frame[pos - EC_ELENGTHSIZE];
+        dlength = etohs(datagram->dlength);
+        pos += hdrsize + (dlength & 0x07ff);
+        if (pos + (int)EC_WKCSIZE > length) {
+            break;
+        }
+        memcpy(&wkc, &frame[pos], EC_WKCSIZE);
+        wkc = htoes(etohs(wkc) + 1);
+        memcpy(&frame[pos], &wkc, EC_WKCSIZE);
+        pos += EC_WKCSIZE;
+        if (!(dlength & EC_DATAGRAMFOLLOWS)) {
+            break;
+        }
+    }
+}
+
+static void *
+echo_thread(void *arg)
+{
+    Echo *echo = arg;
+    uint8 frame[EC_BUFSIZE];
+    int length;
+
+    while (echo->running) {
+        length = recv(echo->sock, frame, sizeof(frame), 0);
+        if (length > (int)(ETH_HEADERSIZE + EC_HEADERSIZE)) {
+            echo_process(frame, length);
+            send(echo->sock, frame, length, 0);
+        }
+    }
+
+    return NULL;
+}
+
+static boolean
+echo_start(Echo *echo, const char *ifname)
+{
+    struct ifreq ifr;
+    struct sockaddr_ll sll;
+    struct timeval timeout;
+
+    echo->ifname = ifname;
+    echo->sock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ECAT));
+    if (echo->sock < 0) {
+        return FALSE;
+    }
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 100000;
+    setsockopt(echo->sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    if (ioctl(echo->sock, SIOCGIFINDEX, &ifr) < 0) {
+        close(echo->sock);
+        return FALSE;
+    }
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_ifindex = ifr.ifr_ifindex;
+    sll.sll_protocol = htons(ETH_P_ECAT);
+    if (bind(echo->sock, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+        close(echo->sock);
+        return FALSE;
+    }
+    echo->running = 1;
+    if (pthread_create(&echo->thread, NULL, echo_thread, echo) != 0) {
+        close(echo->sock);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+echo_stop(Echo *echo)
+{
+    echo->running = 0;
+    pthread_join(echo->thread, NULL);
+    close(echo->sock);
+}
+
+/* Add wire time of a returned frame, if its timestamps are known. */
+static void
+bench_wire(uint8 idx)
+{
+    int64 txtime, rxtime;
+
+    if (ecx_getframetime(&port, idx, &txtime, &rxtime)) {
+        wiretotal += rxtime - txtime;
+        wirecount++;
+    }
+}
+
+/* One cycle: send all frames, then wait for each of them. */
+static int
+bench_cycle(int frames, uint8 *data, boolean batch)
+{
+    uint8 idx[EC_MAXSLOTS];
+    int wkc[EC_MAXSLOTS];
+    int f, lost;
+
+    for (f = 0; f < frames; ++f) {
+        idx[f] = ecx_getindex(&port);
+        ecx_setupdatagram(&port, &(port.txbuf[idx[f]]), EC_CMD_LRW, idx[f],
+                          0, 0, BENCH_DATASIZE, data);
+        if (!batch) {
+            ecx_outframe_red(&port, idx[f]);
+        }
+    }
+    lost = 0;
+    if (batch) {
+        ecx_outframe_red_batch(&port, idx, frames);
+        lost = frames - ecx_waitinframe_batch(&port, idx, wkc, frames,
+                                              EC_TIMEOUTRET);
+        for (f = 0; f < frames; ++f) {
+            if (wkc[f] > EC_NOFRAME) {
+                bench_wire(idx[f]);
+            }
+            ecx_setbufstat(&port, idx[f], EC_BUF_EMPTY);
+        }
+        return lost;
+    }
+    for (f = 0; f < frames; ++f) {
+        if (ecx_waitinframe(&port, idx[f], EC_TIMEOUTRET) <= EC_NOFRAME) {
+            ++lost;
+        } else {
+            bench_wire(idx[f]);
+        }
+        ecx_setbufstat(&port, idx[f], EC_BUF_EMPTY);
+    }
+
+    return lost;
+}
+
+static boolean
+bench_run(const char *ifname, const Transport *transport,
+          const WaitMode *waitmode, int tstamp, int cycles, int frames,
+          Result *result)
+{
+    uint8 data[BENCH_DATASIZE];
+    int64 *samples;
+    int64 start, total, cpustart, wallstart;
+    int i;
+
+    memset(&port, 0, sizeof(port));
+    /* one frame buffer per frame in flight */
+    if (frames > EC_MAXBUF) {
+        ecx_setmaxbuf(&port, frames);
+    }
+    if (!ecx_setupnic_transport(&port, ifname, FALSE, transport->transport)) {
+        printf("%-8s setup failed\n", transport->name);
+        return FALSE;
+    }
+    if (!ecx_setwaitmode(&port, waitmode->mode)) {
+        printf("%-8s wait mode %s failed\n", transport->name, waitmode->name);
+        ecx_closenic(&port);
+        return FALSE;
+    }
+    /* transports without timestamps run without, and show no wire time */
+    ecx_settimestamping(&port, tstamp);
+    if (transport->receiver && !ecx_startreceiver(&port)) {
+        printf("%-8s receiver failed\n", transport->name);
+        ecx_closenic(&port);
+        return FALSE;
+    }
+    samples = malloc(sizeof(*samples) * cycles);
+    memset(data, 0, sizeof(data));
+    memset(result, 0, sizeof(*result));
+
+    for (i = 0; i < BENCH_WARMUP; ++i) {
+        bench_cycle(frames, data, transport->batch);
+    }
+    total = 0;
+    wiretotal = 0;
+    wirecount = 0;
+    cpustart = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    wallstart = now_ns();
+    for (i = 0; i < cycles; ++i) {
+        start = now_ns();
+        result->lost += bench_cycle(frames, data, transport->batch);
+        samples[i] = now_ns() - start;
+        total += samples[i];
+    }
+    result->cpu = 100.0 * (clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpustart) /
+                  (now_ns() - wallstart);
+    ecx_closenic(&port);
+
+    qsort(samples, cycles, sizeof(*samples), cmp_int64);
+    result->min = samples[0];
+    result->avg = total / cycles;
+    result->p50 = samples[cycles / 2];
+    result->p99 = samples[(cycles * 99) / 100];
+    result->max = samples[cycles - 1];
+    result->wire = wirecount ? wiretotal / wirecount : -1;
+    free(samples);
+
+    return TRUE;
+}
+
+static void
+bench_print(const Transport *transport, const WaitMode *waitmode,
+            const Result *result)
+{
+    printf("%-8s %-8s %8.1f %8.1f %8.1f %8.1f %8.1f %6d %5.1f",
+           transport->name, waitmode->name,
+           result->min / 1000.0, result->avg / 1000.0, result->p50 / 1000.0,
+           result->p99 / 1000.0, result->max / 1000.0, result->lost,
+           result->cpu);
+    if (result->wire >= 0) {
+        printf(" %8.1f\n", result->wire / 1000.0);
+    } else {
+        printf(" %8s\n", "-");
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    Echo echo;
+    Result result;
+    const char *select, *selectwait, *selecttstamp;
+    int cycles, frames, tstamp;
+    size_t i, w;
+
+    if (argc < 3) {
+        printf("Usage: nicbench IFNAME PEERIF [transport] [cycles] [frames] [wait] [tstamp]\n"
+               "IFNAME and PEERIF are the two ends of a veth pair\n"
+               "transport is socket, mmap, xdp, batch, rxthread, loopback or all\n"
+               "(default all)\n"
+               "cycles defaults to 10000, frames per cycle to 1\n"
+               "wait is timeout, busy, block or all (default timeout)\n"
+               "tstamp is off, software or hardware (default off)\n");
+        return 1;
+    }
+    select = argc > 3 ? argv[3] : "all";
+    cycles = argc > 4 ? atoi(argv[4]) : 10000;
+    frames = argc > 5 ? atoi(argv[5]) : 1;
+    selectwait = argc > 6 ? argv[6] : "timeout";
+    selecttstamp = argc > 7 ? argv[7] : "off";
+    if (cycles < 1) {
+        cycles = 1;
+    }
+    if (frames < 1) {
+        frames = 1;
+    } else if (frames > EC_MAXSLOTS) {
+        frames = EC_MAXSLOTS;
+    }
+
+    tstamp = -1;
+    for (i = 0; i < sizeof(tstampmodes) / sizeof(tstampmodes[0]); ++i) {
+        if (strcmp(selecttstamp, tstampmodes[i].name) == 0) {
+            tstamp = tstampmodes[i].mode;
+        }
+    }
+    if (tstamp < 0) {
+        printf("Unknown timestamping '%s'\n", selecttstamp);
+        return 1;
+    }
+
+    if (!echo_start(&echo, argv[2])) {
+        printf("Cannot open echo socket on '%s'\n", argv[2]);
+        return 1;
+    }
+
+    printf("%d cycles of %d LRW frame(s), %d bytes each, times in usec\n",
+           cycles, frames, BENCH_DATASIZE);
+    printf("%-8s %-8s %8s %8s %8s %8s %8s %6s %5s %8s\n", "mode", "wait",
+           "min", "avg", "p50", "p99", "max", "lost", "cpu%", "wire");
+    for (i = 0; i < sizeof(transports) / sizeof(transports[0]); ++i) {
+        if (strcmp(select, "all") != 0 && strcmp(select, transports[i].name) != 0) {
+            continue;
+        }
+        for (w = 0; w < sizeof(waitmodes) / sizeof(waitmodes[0]); ++w) {
+            if (strcmp(selectwait, "all") != 0 &&
+                strcmp(selectwait, waitmodes[w].name) != 0) {
+                continue;
+            }
+            if (bench_run(argv[1], &transports[i], &waitmodes[w], tstamp,
+                          cycles, frames, &result)) {
+                bench_print(&transports[i], &waitmodes[w], &result);
+            }
+        }
+    }
+
+    echo_stop(&echo);
+
+    return 0;
+}
@@ -0,0 +1,1392 @@
+/** \file
+ * \brief Simulated EtherCAT segment for Simple Open EtherCAT master
+ *
+ * A segment is a line of virtual ESCs, each a CiA402 drive, that process
+ * EtherCAT frames as real slaves do. Every ESC has
+ *
+ * - a register and process RAM space of ECSIM_MEMSIZE bytes, addressed by
+ *   auto increment, configured station address, broadcast or through its
+ *   FMMUs by logical address, with working counters as the spec defines,
+ * - the AL state machine with the checks of the sync manager configuration
+ *   on the way to SAFE-OP,
+ * - an SII EEPROM image with strings, general, FMMU, SM and PDO categories,
+ *   read through the EEPROM interface registers,
+ * - the DC receive time latches, system time offset and delay registers,
+ *   the propagation delay is ECSIM_HOPDELAY per slave and direction,
+ * - a CoE mailbox on SM0/SM1 answering SDO upload and download requests
+ *   from a CiA402 object dictionary with RxPDO 0x1600 and TxPDO 0x1A00,
+ *   whose mapping is applied to the SM2 and SM3 process data.
+ *
+ * The drive follows the CiA402 state machine by its controlword and in
+ * operation enabled copies target position, velocity and torque to the
+ * actual values. Frames are processed in place by ecsim_process(), either
+ * from a thread on the peer of a veth pair, see ecsim_start(), or in-process
+ * by ecsim_backend, a loopback backend that passes every frame through the
+ * segment on the way.
+ */
+
+#include "ecsim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+
+/* register space and process RAM of one ESC */
+#define ECSIM_MEMSIZE       0x2000
+/* SII EEPROM size in bytes */
+#define ECSIM_EEPSIZE       1024
+/* object dictionary data of one drive in bytes */
+#define ECSIM_ODSIZE        256
+/* propagation delay of one slave in ns */
+#define ECSIM_HOPDELAY      500
+/* FMMUs and SMs evaluated */
+#define ECSIM_MAXFMMU       4
+#define ECSIM_MAXPDOENTRY   8
+
+/* sync manager layout, also in the SII */
+#define ECSIM_MBXOUT        0x1000
+#define ECSIM_MBXIN         0x1080
+#define ECSIM_MBXSIZE       0x0080
+#define ECSIM_OUTPUTS       0x1100
+#define ECSIM_INPUTS        0x1180
+
+/* SM status bit of a full mailbox */
+#define ECSIM_SMFULL        0x08
+
+/* AL status codes */
+#define ECSIM_AL_INVALIDSTATE  0x0011
+#define ECSIM_AL_UNKNOWNSTATE  0x0012
+#define ECSIM_AL_INVALIDOUTPUT 0x001d
+#define ECSIM_AL_INVALIDINPUT  0x001e
+
+/* SDO abort codes */
+#define ECSIM_SDO_BADCOMMAND   0x05040001
+#define ECSIM_SDO_UNSUPPORTED  0x06010000
+#define ECSIM_SDO_READONLY     0x06010002
+#define ECSIM_SDO_NOOBJECT     0x06020000
+#define ECSIM_SDO_BADLENGTH    0x06070010
+#define ECSIM_SDO_NOSUBINDEX   0x06090011
+#define ECSIM_SDO_BADSTATE     0x08000022
+
+/* drive states of CiA402 */
+enum
+{
+    SIM_SWITCHONDISABLED,
+    SIM_READYTOSWITCHON,
+    SIM_SWITCHEDON,
+    SIM_OPERATIONENABLED,
+    SIM_FAULT
+};
+
+/* operations on ESC memory */
+enum
+{
+    SIM_READ,
+    SIM_WRITE,
+    SIM_READWRITE,
+    SIM_READOR
+};
+
+typedef struct {
+    uint16          index;
+    uint8           subindex;
+    boolean         writable;
+    uint16          bits;
+    uint32          value;
+    const char *    string;
+} SimObject;
+
+typedef struct {
+    uint16          odoffset;
+    uint16          pdooffset;
+    uint16          length;
+} SimPdoEntry;
+
+typedef struct {
+    uint8           mem[ECSIM_MEMSIZE];
+    uint8           eeprom[ECSIM_EEPSIZE];
+    uint8           od[ECSIM_ODSIZE];
+    /* local clock minus monotonic clock in ns */
+    int64           localoffset;
+    int             drivestate;
+    uint16          lastcontrol;
+    uint8           mbxcnt;
+    int             nrxpdo;
+    int             ntxpdo;
+    SimPdoEntry     rxpdo[ECSIM_MAXPDOENTRY];
+    SimPdoEntry     txpdo[ECSIM_MAXPDOENTRY];
+} SimSlave;
+
+struct SimSegment {
+    pthread_mutex_t mutex;
+    int             nslaves;
+    SimSlave *      slaves;
+    /* slave position + 1 by configured station address, 0 if none */
+    uint16 *        station;
+    uint64          frames;
+    /* object dictionary offsets used by the drive */
+    int             controlword;
+    int             statusword;
+    int             modes;
+    int             modesdisplay;
+    int             targetposition;
+    int             targetvelocity;
+    int             targettorque;
+    int             actualposition;
+    int             actualvelocity;
+    int             actualtorque;
+    /* thread on a NIC */
+    int             sock;
+    volatile int    running;
+    pthread_t       thread;
+};
+
+/* CiA402 object dictionary, values are the defaults of every drive */
+static const SimObject objects[] = {
+    { 0x1000, 0, FALSE, 32, 0x00020192, NULL },
+    { 0x1001, 0, FALSE, 8,  0, NULL },
+    { 0x1008, 0, FALSE, 8 * (sizeof(ECSIM_NAME) - 1), 0, ECSIM_NAME },
+    { 0x1018, 0, FALSE, 8,  4, NULL },
+    { 0x1018, 1, FALSE, 32, ECSIM_VENDOR, NULL },
+    { 0x1018, 2, FALSE, 32, ECSIM_PRODUCT, NULL },
+    { 0x1018, 3, FALSE, 32, ECSIM_REVISION, NULL },
+    { 0x1018, 4, FALSE, 32, 0, NULL },
+    { 0x1600, 0, TRUE,  8,  6, NULL },
+    { 0x1600, 1, TRUE,  32, 0x60400010, NULL },
+    { 0x1600, 2, TRUE,  32, 0x607a0020, NULL },
+    { 0x1600, 3, TRUE,  32, 0x60ff0020, NULL },
+    { 0x1600, 4, TRUE,  32, 0x60710010, NULL },
+    { 0x1600, 5, TRUE,  32, 0x60600008, NULL },
+    { 0x1600, 6, TRUE,  32, 0x00000008, NULL },
+    { 0x1600, 7, TRUE,  32, 0, NULL },
+    { 0x1600, 8, TRUE,  32, 0, NULL },
+    { 0x1a00, 0, TRUE,  8,  6, NULL },
+    { 0x1a00, 1, TRUE,  32, 0x60410010, NULL },
+    { 0x1a00, 2, TRUE,  32, 0x60640020, NULL },
+    { 0x1a00, 3, TRUE,  32, 0x606c0020, NULL },
+    { 0x1a00, 4, TRUE,  32, 0x60770010, NULL },
+    { 0x1a00, 5, TRUE,  32, 0x60610008, NULL },
+    { 0x1a00, 6, TRUE,  32, 0x00000008, NULL },
+    { 0x1a00, 7, TRUE,  32, 0, NULL },
+    { 0x1a00, 8, TRUE,  32, 0, NULL },
+    { 0x1c00, 0, FALSE, 8,  4, NULL },
+    { 0x1c00, 1, FALSE, 8,  1, NULL },
+    { 0x1c00, 2, FALSE, 8,  2, NULL },
+    { 0x1c00, 3, FALSE, 8,  3, NULL },
+    { 0x1c00, 4, FALSE, 8,  4, NULL },
+    { 0x1c12, 0, TRUE,  8,  1, NULL },
+    { 0x1c12, 1, TRUE,  16, 0x1600, NULL },
+    { 0x1c13, 0, TRUE,  8,  1, NULL },
+    { 0x1c13, 1, TRUE,  16, 0x1a00, NULL },
+    { 0x6040, 0, TRUE,  16, 0, NULL },
+    { 0x6041, 0, FALSE, 16, 0, NULL },
+    { 0x6060, 0, TRUE,  8,  8, NULL },
+    { 0x6061, 0, FALSE, 8,  0, NULL },
+    { 0x6064, 0, FALSE, 32, 0, NULL },
+    { 0x606c, 0, FALSE, 32, 0, NULL },
+    { 0x6071, 0, TRUE,  16, 0, NULL },
+    { 0x6077, 0, FALSE, 16, 0, NULL },
+    { 0x607a, 0, TRUE,  32, 0, NULL },
+    { 0x60ff, 0, TRUE,  32, 0, NULL },
+    { 0x6502, 0, FALSE, 32, 0x00000380, NULL },
+};
+
+#define SIM_NOBJECTS    ((int)(sizeof(objects) / sizeof(objects[0])))
+
+/* segment served by ecsim_backend */
+static SimSegment *attached;
+
+static uint16
+get16(const uint8 *p)
+{
+    return (uint16)(p[0] | (p[1] << 8));
+}
+
+static uint32
+get32(const uint8 *p)
+{
+    return (uint32)get16(p) | ((uint32)get16(p + 2) << 16);
+}
+
+static uint64
+get64(const uint8 *p)
+{
+    return (uint64)get32(p) | ((uint64)get32(p + 4) << 32);
+}
+
+static void
+put16(uint8 *p, uint16 v)
+{
+    p[0] = (uint8)v;
+    p[1] = (uint8)(v >> 8);
+}
+
+static void
+put32(uint8 *p, uint32 v)
+{
+    put16(p, (uint16)v);
+    put16(p + 2, (uint16)(v >> 16));
+}
+
+static void
+put64(uint8 *p, uint64 v)
+{
+    put32(p, (uint32)v);
+    put32(p + 4, (uint32)(v >> 32));
+}
+
+static int64
+sim_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static boolean
+sim_overlaps(int adr, int len, int reg, int reglen)
+{
+    return (adr < reg + reglen) && (reg < adr + len);
+}
+
+/* Find object in dictionary, return its index in objects[] or -1 and the
+ * offset of its data in the drive. */
+static int
+od_find(uint16 index, uint8 subindex, int *offset)
+{
+    int i, pos;
+
+    pos = 0;
+    for (i = 0; i < SIM_NOBJECTS; ++i) {
+        if ((objects[i].index == index) && (objects[i].subindex == subindex)) {
+            *offset = pos;
+            return i;
+        }
+        pos += (objects[i].bits + 7) / 8;
+    }
+
+    return -1;
+}
+
+static boolean
+od_exists(uint16 index)
+{
+    int i;
+
+    for (i = 0; i < SIM_NOBJECTS; ++i) {
+        if (objects[i].index == index) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static uint32
+od_get(SimSlave *slave, uint16 index, uint8 subindex)
+{
+    int i, offset;
+    uint32 value;
+
+    i = od_find(index, subindex, &offset);
+    if (i < 0) {
+        return 0;
+    }
+    value = 0;
+    memcpy(&value, &slave->od[offset], (objects[i].bits + 7) / 8);
+
+    return etohl(value);
+}
+
+static void
+od_init(SimSlave *slave, int position)
+{
+    int i, pos, size;
+    uint32 value;
+
+    pos = 0;
+    for (i = 0; i < SIM_NOBJECTS; ++i) {
+        size = (objects[i].bits + 7) / 8;
+        if (objects[i].string) {
+            memcpy(&slave->od[pos], objects[i].string, size);
+        } else {
+            value = htoel(objects[i].value);
+            memcpy(&slave->od[pos], &value, size);
+        }
+        pos += size;
+    }
+    /* serial number */
+    od_find(0x1018, 4, &pos);
+    put32(&slave->od[pos], position + 1);
+}
+
+/* Resolve PDO assign object to the mapped object data, return the size of
+ * the process data in bits or -1 if an object mapped does not exist. */
+static int
+sim_mappdo(SimSlave *slave, uint16 assign, SimPdoEntry *entry, int *nentry)
+{
+    int a, m, bits, offset, i;
+    uint16 pdo;
+    uint32 map;
+
+    bits = 0;
+    *nentry = 0;
+    for (a = 1; a <= (int)od_get(slave, assign, 0); ++a) {
+        pdo = (uint16)od_get(slave, assign, (uint8)a);
+        for (m = 1; m <= (int)od_get(slave, pdo, 0); ++m) {
+            map = od_get(slave, pdo, (uint8)m);
+            /* padding has no object */
+            if ((map >> 16) != 0) {
+                i = od_find((uint16)(map >> 16), (uint8)(map >> 8), &offset);
+                if ((i < 0) || (objects[i].bits != (map & 0xff)) || (bits & 7) ||
+                    (*nentry >= ECSIM_MAXPDOENTRY)) {
+                    return -1;
+                }
+                entry[*nentry].odoffset = (uint16)offset;
+                entry[*nentry].pdooffset = (uint16)(bits / 8);
+                entry[*nentry].length = (uint16)(objects[i].bits / 8);
+                (*nentry)++;
+            }
+            bits += map & 0xff;
+        }
+    }
+
+    return bits;
+}
+
+static int
+sim_state(SimSlave *slave)
+{
+    return get16(&slave->mem[ECT_REG_ALSTAT]) & 0x0f;
+}
+
+/* CiA402 drive cycle, outputs are taken when operational */
+static void
+sim_drive(SimSegment *sim, SimSlave *slave)
+{
+    uint8 *od = slave->od;
+    uint8 *mem = slave->mem;
+    uint16 control, status;
+    uint16 smoutputs, sminputs;
+    int i;
+
+    smoutputs = get16(&mem[ECT_REG_SM2]);
+    sminputs = get16(&mem[ECT_REG_SM3]);
+    if ((sim_state(slave) == EC_STATE_OPERATIONAL) &&
+        (smoutputs + get16(&mem[ECT_REG_SM2 + 2]) <= ECSIM_MEMSIZE)) {
+        for (i = 0; i < slave->nrxpdo; ++i) {
+            memcpy(&od[slave->rxpdo[i].odoffset],
+                   &mem[smoutputs + slave->rxpdo[i].pdooffset],
+                   slave->rxpdo[i].length);
+        }
+    }
+
+    control = get16(&od[sim->controlword]);
+    switch (slave->drivestate) {
+    case SIM_FAULT:
+        if ((control & 0x0080) && !(slave->lastcontrol & 0x0080)) {
+            slave->drivestate = SIM_SWITCHONDISABLED;
+        }
+        break;
+    default:
+        if ((control & 0x0002) == 0) {
+            /* disable voltage */
+            slave->drivestate = SIM_SWITCHONDISABLED;
+        } else if ((control & 0x0006) == 0x0002) {
+            /* quick stop */
+            slave->drivestate = SIM_SWITCHONDISABLED;
+        } else if ((control & 0x0087) == 0x0006) {
+            slave->drivestate = SIM_READYTOSWITCHON;
+        } else if (((control & 0x008f) == 0x0007) &&
+                   (slave->drivestate != SIM_SWITCHONDISABLED)) {
+            slave->drivestate = SIM_SWITCHEDON;
+        } else if (((control & 0x008f) == 0x000f) &&
+                   (slave->drivestate >= SIM_SWITCHEDON)) {
+            slave->drivestate = SIM_OPERATIONENABLED;
+        }
+        break;
+    }
+    slave->lastcontrol = control;
+
+    switch (slave->drivestate) {
+    case SIM_READYTOSWITCHON:
+        status = 0x0021;
+        break;
+    case SIM_SWITCHEDON:
+        status = 0x0023;
+        break;
+    case SIM_OPERATIONENABLED:
+        status = 0x0427;
+        break;
+    case SIM_FAULT:
+        status = 0x0008;
+        break;
+    default:
+        status = 0x0040;
+        break;
+    }
+    put16(&od[sim->statusword], status | 0x0200);
+    od[sim->modesdisplay] = od[sim->modes];
+    if (slave->drivestate == SIM_OPERATIONENABLED) {
+        switch (od[sim->modes]) {
+        case 9:
+            /* cyclic synchronous velocity, one unit per cycle */
+            put32(&od[sim->actualposition], get32(&od[sim->actualposition]) +
+                  get32(&od[sim->targetvelocity]));
+            memcpy(&od[sim->actualvelocity], &od[sim->targetvelocity], 4);
+            break;
+        case 10:
+            /* cyclic synchronous torque */
+            memcpy(&od[sim->actualtorque], &od[sim->targettorque], 2);
+            break;
+        default:
+            /* cyclic synchronous position */
+            put32(&od[sim->actualvelocity], get32(&od[sim->targetposition]) -
+                  get32(&od[sim->actualposition]));
+            memcpy(&od[sim->actualposition], &od[sim->targetposition], 4);
+            break;
+        }
+    } else {
+        put32(&od[sim->actualvelocity], 0);
+        put16(&od[sim->actualtorque], 0);
+    }
+
+    if (sim_state(slave) >= EC_STATE_SAFE_OP &&
+        (sminputs + get16(&mem[ECT_REG_SM3 + 2]) <= ECSIM_MEMSIZE)) {
+        for (i = 0; i < slave->ntxpdo; ++i) {
+            memcpy(&mem[sminputs + slave->txpdo[i].pdooffset],
+                   &od[slave->txpdo[i].odoffset], slave->txpdo[i].length);
+        }
+    }
+}
+
+/* Check process data configuration for SAFE-OP, return AL status code. */
+static uint16
+sim_checkpdo(SimSlave *slave)
+{
+    int rxbits, txbits;
+
+    rxbits = sim_mappdo(slave, ECT_SDO_RXPDOASSIGN, slave->rxpdo, &slave->nrxpdo);
+    txbits = sim_mappdo(slave, ECT_SDO_TXPDOASSIGN, slave->txpdo, &slave->ntxpdo);
+    if ((rxbits < 0) ||
+        (get16(&slave->mem[ECT_REG_SM2 + 2]) != (rxbits + 7) / 8) ||
+        (rxbits && !(slave->mem[ECT_REG_SM2 + 6] & 0x01))) {
+        slave->nrxpdo = 0;
+        slave->ntxpdo = 0;
+        return ECSIM_AL_INVALIDOUTPUT;
+    }
+    if ((txbits < 0) ||
+        (get16(&slave->mem[ECT_REG_SM3 + 2]) != (txbits + 7) / 8) ||
+        (txbits && !(slave->mem[ECT_REG_SM3 + 6] & 0x01))) {
+        slave->nrxpdo = 0;
+        slave->ntxpdo = 0;
+        return ECSIM_AL_INVALIDINPUT;
+    }
+
+    return 0;
+}
+
+/* AL control written */
+static void
+sim_alcontrol(SimSegment *sim, SimSlave *slave)
+{
+    uint16 control, status;
+    int state, request;
+    uint16 code;
+
+    control = get16(&slave->mem[ECT_REG_ALCTL]);
+    status = get16(&slave->mem[ECT_REG_ALSTAT]);
+    request = control & 0x0f;
+    state = status & 0x0f;
+    /* a pending error must be acknowledged */
+    if ((status & EC_STATE_ERROR) && !(control & EC_STATE_ACK)) {
+        return;
+    }
+    code = 0;
+    switch (request) {
+    case EC_STATE_INIT:
+        break;
+    case EC_STATE_PRE_OP:
+        if (state == EC_STATE_BOOT) {
+            code = ECSIM_AL_INVALIDSTATE;
+        }
+        break;
+    case EC_STATE_BOOT:
+        if ((state != EC_STATE_INIT) && (state != EC_STATE_BOOT)) {
+            code = ECSIM_AL_INVALIDSTATE;
+        }
+        break;
+    case EC_STATE_SAFE_OP:
+        if (state == EC_STATE_PRE_OP) {
+            code = sim_checkpdo(slave);
+        } else if (state < EC_STATE_SAFE_OP) {
+            code = ECSIM_AL_INVALIDSTATE;
+        }
+        break;
+    case EC_STATE_OPERATIONAL:
+        if (state < EC_STATE_SAFE_OP) {
+            code = ECSIM_AL_INVALIDSTATE;
+        }
+        break;
+    default:
+        code = ECSIM_AL_UNKNOWNSTATE;
+        break;
+    }
+    if (code) {
+        put16(&slave->mem[ECT_REG_ALSTAT], (uint16)(state | EC_STATE_ERROR));
+        put16(&slave->mem[ECT_REG_ALSTATCODE], code);
+        return;
+    }
+    put16(&slave->mem[ECT_REG_ALSTAT], (uint16)request);
+    put16(&slave->mem[ECT_REG_ALSTATCODE], 0);
+    if (request < EC_STATE_SAFE_OP) {
+        slave->nrxpdo = 0;
+        slave->ntxpdo = 0;
+        slave->drivestate = SIM_SWITCHONDISABLED;
+    }
+    if (request == EC_STATE_INIT) {
+        slave->mem[ECT_REG_SM1STAT] &= ~ECSIM_SMFULL;
+    }
+    if ((request >= EC_STATE_SAFE_OP) && (state < EC_STATE_SAFE_OP)) {
+        /* valid inputs from the start */
+        sim_drive(sim, slave);
+    }
+}
+
+/* EEPROM control written */
+static void
+sim_eeprom(SimSlave *slave)
+{
+    uint8 *mem = slave->mem;
+    uint32 adr;
+    int i;
+
+    adr = get32(&mem[ECT_REG_EEPADR]) * 2;
+    switch (get16(&mem[ECT_REG_EEPCTL]) & 0x0700) {
+    case EC_ECMD_READ & 0x0700:
+        for (i = 0; i < 8; ++i) {
+            mem[ECT_REG_EEPDAT + i] = (adr + i < ECSIM_EEPSIZE) ?
+                slave->eeprom[adr + i] : 0xff;
+        }
+        break;
+    case EC_ECMD_WRITE & 0x0700:
+        if (adr + 1 < ECSIM_EEPSIZE) {
+            slave->eeprom[adr] = mem[ECT_REG_EEPDAT];
+            slave->eeprom[adr + 1] = mem[ECT_REG_EEPDAT + 1];
+        }
+        break;
+    default:
+        break;
+    }
+    /* done at once, never busy, 8 byte reads */
+    put16(&mem[ECT_REG_EEPSTAT], EC_ESTAT_R64);
+}
+
+/* Latch receive times of the ports, the frame is at the first slave at now. */
+static void
+sim_latch(SimSegment *sim, int position, int64 now)
+{
+    SimSlave *slave = &sim->slaves[position];
+    int64 port0, port1;
+
+    port0 = now + (int64)position * ECSIM_HOPDELAY + slave->localoffset;
+    port1 = 0;
+    if (position < sim->nslaves - 1) {
+        port1 = port0 + (int64)(sim->nslaves - 1 - position) * 2 * ECSIM_HOPDELAY;
+    }
+    put32(&slave->mem[ECT_REG_DCTIME0], (uint32)port0);
+    put32(&slave->mem[ECT_REG_DCTIME1], (uint32)port1);
+    put32(&slave->mem[ECT_REG_DCTIME2], 0);
+    put32(&slave->mem[ECT_REG_DCTIME3], 0);
+    put64(&slave->mem[ECT_REG_DCSOF], (uint64)port0);
+}
+
+/* Place mailbox response in SM1 */
+static void
+sim_mbxrespond(SimSlave *slave, uint8 type, const uint8 *data, int length)
+{
+    uint8 *mem = slave->mem;
+    uint16 start, size;
+
+    start = get16(&mem[ECT_REG_SM1]);
+    size = get16(&mem[ECT_REG_SM1 + 2]);
+    if ((length + 6 > size) || (start + size > ECSIM_MEMSIZE)) {
+        return;
+    }
+    slave->mbxcnt = (slave->mbxcnt % 7) + 1;
+    memset(&mem[start], 0, size);
+    put16(&mem[start], (uint16)length);
+    mem[start + 5] = (uint8)(type | (slave->mbxcnt << 4));
+    memcpy(&mem[start + 6], data, length);
+    mem[ECT_REG_SM1STAT] |= ECSIM_SMFULL;
+}
+
+static void
+sim_sdoabort(SimSlave *slave, uint16 index, uint8 subindex, uint32 code)
+{
+    uint8 res[10];
+
+    put16(&res[0], ECT_COES_SDOREQ << 12);
+    res[2] = ECT_SDO_ABORT;
+    put16(&res[3], index);
+    res[5] = subindex;
+    put32(&res[6], code);
+    sim_mbxrespond(slave, ECT_MBXT_COE, res, sizeof(res));
+}
+
+/* CoE SDO request in mailbox, req points at the CoE header */
+static void
+sim_sdo(SimSlave *slave, const uint8 *req, int length)
+{
+    uint8 res[ECSIM_MBXSIZE];
+    uint8 command;
+    uint16 index;
+    uint8 subindex;
+    int i, size, reqsize;
+    int offset = 0;
+
+    if ((length < 10) || ((get16(req) >> 12) != ECT_COES_SDOREQ)) {
+        return;
+    }
+    command = req[2];
+    index = get16(&req[3]);
+    subindex = req[5];
+    if (command & 0x10) {
+        /* complete access */
+        sim_sdoabort(slave, index, subindex, ECSIM_SDO_UNSUPPORTED);
+        return;
+    }
+    i = od_find(index, subindex, &offset);
+    if (((command & 0xe0) == ECT_SDO_UP_REQ) || ((command & 0xe0) == 0x20)) {
+        if (i < 0) {
+            sim_sdoabort(slave, index, subindex, od_exists(index) ?
+                         ECSIM_SDO_NOSUBINDEX : ECSIM_SDO_NOOBJECT);
+            return;
+        }
+    }
+    size = (objects[i < 0 ? 0 : i].bits + 7) / 8;
+    memset(res, 0, sizeof(res));
+    put16(&res[0], ECT_COES_SDORES << 12);
+    put16(&res[3], index);
+    res[5] = subindex;
+    switch (command & 0xe0) {
+    case ECT_SDO_UP_REQ:
+        if (size <= 4) {
+            /* expedited */
+            res[2] = (uint8)(0x43 | ((4 - size) << 2));
+            memcpy(&res[6], &slave->od[offset], size);
+            sim_mbxrespond(slave, ECT_MBXT_COE, res, 10);
+        } else if (size + 10 <= (int)sizeof(res) - 6) {
+            res[2] = 0x41;
+            put32(&res[6], size);
+            memcpy(&res[10], &slave->od[offset], size);
+            sim_mbxrespond(slave, ECT_MBXT_COE, res, 10 + size);
+        } else {
+            sim_sdoabort(slave, index, subindex, ECSIM_SDO_UNSUPPORTED);
+        }
+        break;
+    case 0x20:
+        /* download, expedited or normal */
+        if (command & 0x02) {
+            reqsize = (command & 0x01) ? 4 - ((command >> 2) & 0x03) : 4;
+            req += 6;
+        } else {
+            reqsize = get32(&req[6]);
+            req += 10;
+            if (reqsize + 10 > length) {
+                sim_sdoabort(slave, index, subindex, ECSIM_SDO_BADLENGTH);
+                return;
+            }
+        }
+        if (!objects[i].writable) {
+            sim_sdoabort(slave, index, subindex, ECSIM_SDO_READONLY);
+        } else if (reqsize != size) {
+            sim_sdoabort(slave, index, subindex, ECSIM_SDO_BADLENGTH);
+        } else if ((index < 0x2000) && (sim_state(slave) != EC_STATE_PRE_OP)) {
+            /* PDO configuration only in PRE-OP */
+            sim_sdoabort(slave, index, subindex, ECSIM_SDO_BADSTATE);
+        } else {
+            memcpy(&slave->od[offset], req, size);
+            res[2] = 0x60;
+            sim_mbxrespond(slave, ECT_MBXT_COE, res, 10);
+        }
+        break;
+    default:
+        sim_sdoabort(slave, index, subindex, ECSIM_SDO_BADCOMMAND);
+        break;
+    }
+}
+
+/* SM0 mailbox written by master */
+static void
+sim_mailbox(SimSlave *slave)
+{
+    uint8 *mem = slave->mem;
+    uint8 err[4];
+    uint16 start, length;
+
+    if (sim_state(slave) < EC_STATE_PRE_OP) {
+        return;
+    }
+    start = get16(&mem[ECT_REG_SM0]);
+    length = get16(&mem[start]);
+    if (length + 6 > get16(&mem[ECT_REG_SM0 + 2])) {
+        return;
+    }
+    if ((mem[start + 5] & 0x0f) == ECT_MBXT_COE) {
+        sim_sdo(slave, &mem[start + 6], length);
+    } else {
+        /* mailbox error, unsupported protocol */
+        put16(&err[0], 0x0001);
+        put16(&err[2], 0x0002);
+        sim_mbxrespond(slave, ECT_MBXT_ERR, err, sizeof(err));
+    }
+}
+
+/* Register bytes the master cannot write */
+static boolean
+sim_readonly(int adr)
+{
+    if ((adr < 0x0010) ||
+        ((adr >= ECT_REG_DLSTAT) && (adr < ECT_REG_DLSTAT + 2)) ||
+        ((adr >= ECT_REG_ALSTAT) && (adr < ECT_REG_PDICTL)) ||
+        ((adr >= ECT_REG_DCTIME0) && (adr < ECT_REG_DCSYSOFFSET)) ||
+        ((adr >= ECT_REG_DCSYSDIFF) && (adr < ECT_REG_DCSYSDIFF + 4))) {
+        return TRUE;
+    }
+    /* status and PDI control of sync managers */
+    if ((adr >= ECT_REG_SM0) && (adr < ECT_REG_SM0 + 8 * EC_MAXSM)) {
+        return ((adr & 7) == 5) || ((adr & 7) == 7);
+    }
+
+    return FALSE;
+}
+
+static void
+sim_read(SimSlave *slave, int adr, uint8 *data, int len, int op, int64 now)
+{
+    uint8 *mem = slave->mem;
+    uint16 start, size;
+    int i;
+
+    if (sim_overlaps(adr, len, ECT_REG_DCSYSTIME, 8)) {
+        put64(&mem[ECT_REG_DCSYSTIME], (uint64)(now + slave->localoffset) +
+              get64(&mem[ECT_REG_DCSYSOFFSET]));
+    }
+    for (i = 0; i < len; ++i) {
+        if (adr + i >= ECSIM_MEMSIZE) {
+            break;
+        }
+        if (op == SIM_READOR) {
+            data[i] |= mem[adr + i];
+        } else {
+            data[i] = mem[adr + i];
+        }
+    }
+    /* last byte of full SM1 mailbox read */
+    start = get16(&mem[ECT_REG_SM1]);
+    size = get16(&mem[ECT_REG_SM1 + 2]);
+    if ((mem[ECT_REG_SM1STAT] & ECSIM_SMFULL) && size &&
+        sim_overlaps(adr, len, start + size - 1, 1)) {
+        mem[ECT_REG_SM1STAT] &= ~ECSIM_SMFULL;
+    }
+}
+
+static void
+sim_write(SimSegment *sim, int position, int adr, const uint8 *data, int len,
+          int64 now)
+{
+    SimSlave *slave = &sim->slaves[position];
+    uint8 *mem = slave->mem;
+    uint16 station, start, size;
+    int i;
+
+    station = get16(&mem[ECT_REG_STADR]);
+    for (i = 0; i < len; ++i) {
+        if (adr + i >= ECSIM_MEMSIZE) {
+            break;
+        }
+        if (!sim_readonly(adr + i)) {
+            mem[adr + i] = data[i];
+        }
+    }
+    if (!sim_overlaps(adr, len, 0, ECSIM_MEMSIZE)) {
+        return;
+    }
+    if (get16(&mem[ECT_REG_STADR]) != station) {
+        if (sim->station[station] == position + 1) {
+            sim->station[station] = 0;
+        }
+        sim->station[get16(&mem[ECT_REG_STADR])] = (uint16)(position + 1);
+    }
+    if (sim_overlaps(adr, len, ECT_REG_ALCTL, 2)) {
+        sim_alcontrol(sim, slave);
+    }
+    if (sim_overlaps(adr, len, ECT_REG_EEPCTL, 2)) {
+        sim_eeprom(slave);
+    }
+    if (sim_overlaps(adr, len, ECT_REG_DCTIME0, 4)) {
+        sim_latch(sim, position, now);
+    }
+    /* last byte of SM0 mailbox written */
+    start = get16(&mem[ECT_REG_SM0]);
+    size = get16(&mem[ECT_REG_SM0 + 2]);
+    if ((mem[ECT_REG_SM0 + 6] & 0x01) && size &&
+        sim_overlaps(adr, len, start + size - 1, 1)) {
+        sim_mailbox(slave);
+    }
+    /* outputs written */
+    start = get16(&mem[ECT_REG_SM2]);
+    size = get16(&mem[ECT_REG_SM2 + 2]);
+    if (size && (sim_state(slave) >= EC_STATE_SAFE_OP) &&
+        sim_overlaps(adr, len, start, size)) {
+        sim_drive(sim, slave);
+    }
+}
+
+/* Physical memory access of one slave, return working counter increment */
+static int
+sim_access(SimSegment *sim, int position, int op, int adr, uint8 *data,
+           int len, int64 now)
+{
+    SimSlave *slave = &sim->slaves[position];
+    uint8 old[0x0800];
+
+    switch (op) {
+    case SIM_READ:
+    case SIM_READOR:
+        sim_read(slave, adr, data, len, op, now);
+        return 1;
+    case SIM_WRITE:
+        sim_write(sim, position, adr, data, len, now);
+        return 1;
+    default:
+        memset(old, 0, len);
+        sim_read(slave, adr, old, len, SIM_READ, now);
+        sim_write(sim, position, adr, data, len, now);
+        memcpy(data, old, len);
+        return 3;
+    }
+}
+
+/* Logical memory access of one slave through its FMMUs */
+static int
+sim_logical(SimSegment *sim, int position, uint8 command, uint32 adr,
+            uint8 *data, int len, int64 now)
+{
+    SimSlave *slave = &sim->slaves[position];
+    uint8 *fmmu;
+    uint32 start, lo, hi;
+    int f, pass, reads, writes;
+
+    reads = 0;
+    writes = 0;
+    /* outputs are taken before inputs are put in the frame */
+    for (pass = 0; pass < 2; ++pass) {
+        for (f = 0; f < ECSIM_MAXFMMU; ++f) {
+            fmmu = &slave->mem[ECT_REG_FMMU0 + 16 * f];
+            if (!(fmmu[12] & 0x01)) {
+                continue;
+            }
+            start = get32(fmmu);
+            lo = start > adr ? start : adr;
+            hi = start + get16(&fmmu[4]);
+            if (hi > adr + len) {
+                hi = adr + len;
+            }
+            if (lo >= hi) {
+                continue;
+            }
+            if ((pass == 0) && (fmmu[11] & 0x02) && (command != EC_CMD_LRD)) {
+                sim_write(sim, position, get16(&fmmu[8]) + (lo - start),
+                          &data[lo - adr], hi - lo, now);
+                writes = 1;
+            }
+            if ((pass == 1) && (fmmu[11] & 0x01) && (command != EC_CMD_LWR)) {
+                sim_read(slave, get16(&fmmu[8]) + (lo - start),
+                         &data[lo - adr], hi - lo, SIM_READ, now);
+                reads = 1;
+            }
+        }
+    }
+    if (command == EC_CMD_LRW) {
+        return reads + 2 * writes;
+    }
+
+    return reads + writes;
+}
+
+/* Process one datagram through all slaves, dg points at the command */
+static void
+sim_datagram(SimSegment *sim, uint8 *dg, int len, int64 now)
+{
+    uint8 *data = &dg[10];
+    uint8 command = dg[0];
+    uint16 adp, ado, addressed;
+    int wkc, k, op;
+
+    adp = get16(&dg[2]);
+    ado = get16(&dg[4]);
+    wkc = get16(&data[len]);
+    switch (command) {
+    case EC_CMD_APRD:
+    case EC_CMD_APWR:
+    case EC_CMD_APRW:
+    case EC_CMD_ARMW:
+    case EC_CMD_BRD:
+    case EC_CMD_BWR:
+    case EC_CMD_BRW:
+        op = (command == EC_CMD_APRD) ? SIM_READ :
+             (command == EC_CMD_APWR) ? SIM_WRITE :
+             (command == EC_CMD_APRW) ? SIM_READWRITE :
+             (command == EC_CMD_BRD) ? SIM_READOR :
+             (command == EC_CMD_BWR) ? SIM_WRITE :
+             (command == EC_CMD_BRW) ? SIM_READWRITE : SIM_READ;
+        for (k = 0; k < sim->nslaves; ++k, ++adp) {
+            if ((command >= EC_CMD_BRD) && (command <= EC_CMD_BRW)) {
+                wkc += sim_access(sim, k, op, ado, data, len, now);
+            } else if (adp == 0) {
+                wkc += sim_access(sim, k, op, ado, data, len, now);
+            } else if (command == EC_CMD_ARMW) {
+                wkc += sim_access(sim, k, SIM_WRITE, ado, data, len, now);
+            }
+        }
+        put16(&dg[2], adp);
+        break;
+    case EC_CMD_FPRD:
+    case EC_CMD_FPWR:
+    case EC_CMD_FPRW:
+        op = (command == EC_CMD_FPRD) ? SIM_READ :
+             (command == EC_CMD_FPWR) ? SIM_WRITE : SIM_READWRITE;
+        addressed = sim->station[adp];
+        if (addressed) {
+            wkc += sim_access(sim, addressed - 1, op, ado, data, len, now);
+        }
+        break;
+    case EC_CMD_FRMW:
+        addressed = sim->station[adp];
+        for (k = 0; k < sim->nslaves; ++k) {
+            op = (k == addressed - 1) ? SIM_READ : SIM_WRITE;
+            wkc += sim_access(sim, k, op, ado, data, len, now);
+        }
+        break;
+    case EC_CMD_LRD:
+    case EC_CMD_LWR:
+    case EC_CMD_LRW:
+        for (k = 0; k < sim->nslaves; ++k) {
+            wkc += sim_logical(sim, k, command, get32(&dg[2]), data, len, now);
+        }
+        break;
+    default:
+        break;
+    }
+    put16(&data[len], (uint16)wkc);
+}
+
+/* Append SII category header, return position of its data */
+static int
+sii_category(uint8 *eep, int pos, uint16 category, int words)
+{
+    put16(&eep[pos], category);
+    put16(&eep[pos + 2], (uint16)words);
+
+    return pos + 4;
+}
+
+static int
+sii_pdo(SimSlave *slave, uint8 *eep, int pos, uint16 category, uint16 pdo,
+        uint8 sm)
+{
+    uint8 *data;
+    uint32 map;
+    int n, m;
+
+    n = od_get(slave, pdo, 0);
+    data = &eep[sii_category(eep, pos, category, (8 + 8 * n) / 2)];
+    put16(&data[0], pdo);
+    data[2] = (uint8)n;
+    data[3] = sm;
+    for (m = 1; m <= n; ++m) {
+        map = od_get(slave, pdo, (uint8)m);
+        put16(&data[8 * m], (uint16)(map >> 16));
+        data[8 * m + 2] = (uint8)(map >> 8);
+        /* UNSIGNED8, 16 or 32 */
+        data[8 * m + 4] = ((map & 0xff) == 8) ? 0x05 :
+                          ((map & 0xff) == 16) ? 0x06 : 0x07;
+        data[8 * m + 5] = (uint8)map;
+    }
+
+    return pos + 4 + 8 + 8 * n;
+}
+
+/* Build SII EEPROM image of the drive */
+static void
+sii_init(SimSlave *slave, int position)
+{
+    static const char *strings[] = { ECSIM_NAME, "ECsim" };
+    static const uint16 sm[4][4] = {
+        { ECSIM_MBXOUT, ECSIM_MBXSIZE, 0x26, 1 },
+        { ECSIM_MBXIN, ECSIM_MBXSIZE, 0x22, 1 },
+        { ECSIM_OUTPUTS, ECSIM_RXPDOSIZE, 0x64, 1 },
+        { ECSIM_INPUTS, ECSIM_TXPDOSIZE, 0x20, 1 },
+    };
+    uint8 *eep = slave->eeprom;
+    uint8 *data;
+    int pos, i, len;
+
+    memset(eep, 0xff, ECSIM_EEPSIZE);
+    memset(eep, 0, ECT_SII_START * 2);
+    put32(&eep[ECT_SII_MANUF * 2], ECSIM_VENDOR);
+    put32(&eep[ECT_SII_ID * 2], ECSIM_PRODUCT);
+    put32(&eep[ECT_SII_REV * 2], ECSIM_REVISION);
+    put32(&eep[0x0e * 2], position + 1);
+    put16(&eep[ECT_SII_RXMBXADR * 2], ECSIM_MBXOUT);
+    put16(&eep[ECT_SII_MBXSIZE * 2], ECSIM_MBXSIZE);
+    put16(&eep[ECT_SII_TXMBXADR * 2], ECSIM_MBXIN);
+    put16(&eep[(ECT_SII_TXMBXADR + 1) * 2], ECSIM_MBXSIZE);
+    put16(&eep[ECT_SII_MBXPROTO * 2], ECT_MBXPROT_COE);
+    /* 8 kbit, version 1 */
+    put16(&eep[0x3e * 2], (ECSIM_EEPSIZE * 8 / 1024) - 1);
+    put16(&eep[0x3f * 2], 1);
+    pos = ECT_SII_START * 2;
+
+    len = 1;
+    for (i = 0; i < 2; ++i) {
+        len += 1 + (int)strlen(strings[i]);
+    }
+    data = &eep[sii_category(eep, pos, ECT_SII_STRING, (len + 1) / 2)];
+    memset(data, 0, len + 1);
+    data[0] = 2;
+    len = 1;
+    for (i = 0; i < 2; ++i) {
+        data[len] = (uint8)strlen(strings[i]);
+        memcpy(&data[len + 1], strings[i], data[len]);
+        len += 1 + data[len];
+    }
+    pos += 4 + ((len + 1) & ~1);
+
+    data = &eep[sii_category(eep, pos, ECT_SII_GENERAL, 16)];
+    memset(data, 0, 32);
+    data[1] = 0;
+    data[2] = 2;
+    data[3] = 1;
+    data[5] = ECT_COEDET_SDO | ECT_COEDET_PDOASSIGN | ECT_COEDET_PDOCONFIG;
+    data[9] = 1;
+    pos += 4 + 32;
+
+    data = &eep[sii_category(eep, pos, ECT_SII_FMMU, 2)];
+    data[0] = 1;
+    data[1] = 2;
+    data[2] = 3;
+    data[3] = 0xff;
+    pos += 4 + 4;
+
+    data = &eep[sii_category(eep, pos, ECT_SII_SM, 16)];
+    for (i = 0; i < 4; ++i) {
+        put16(&data[8 * i], sm[i][0]);
+        put16(&data[8 * i + 2], sm[i][1]);
+        data[8 * i + 4] = (uint8)sm[i][2];
+        data[8 * i + 5] = 0;
+        data[8 * i + 6] = (uint8)sm[i][3];
+        data[8 * i + 7] = 0;
+    }
+    pos += 4 + 32;
+
+    pos = sii_pdo(slave, eep, pos, ECT_SII_PDO, 0x1a00, 3);
+    pos = sii_pdo(slave, eep, pos, ECT_SII_PDO + 1, 0x1600, 2);
+    put16(&eep[pos], 0xffff);
+}
+
+/* Registers after power up */
+static void
+esc_init(SimSegment *sim, SimSlave *slave, int position)
+{
+    uint8 *mem = slave->mem;
+    uint16 dlstatus;
+
+    memset(mem, 0, ECSIM_MEMSIZE);
+    mem[ECT_REG_TYPE] = 0x11;
+    mem[0x0001] = 0x02;
+    mem[0x0004] = 8;
+    mem[0x0005] = 8;
+    mem[0x0006] = ECSIM_MEMSIZE / 1024;
+    mem[ECT_REG_PORTDES] = 0x0f;
+    /* DC and 64 bit DC */
+    put16(&mem[ECT_REG_ESCSUP], 0x000c);
+    /* PDI operational, link and communication on port 0, and on port 1
+     * unless last in line */
+    dlstatus = 0x0211;
+    if (position < sim->nslaves - 1) {
+        dlstatus |= 0x0820;
+    } else {
+        dlstatus |= 0x0400;
+    }
+    put16(&mem[ECT_REG_DLSTAT], dlstatus);
+    put16(&mem[ECT_REG_ALSTAT], EC_STATE_INIT);
+    put16(&mem[ECT_REG_PDICTL], 0x0005);
+    put16(&mem[ECT_REG_EEPSTAT], EC_ESTAT_R64);
+    /* free running clocks of the slaves differ */
+    slave->localoffset = (int64)(position + 1) * 1000003;
+}
+
+/** Create a segment of nslaves drives in INIT.
+ * @param[in] nslaves     = number of slaves, up to ECSIM_MAXSLAVE
+ * @return segment, NULL on error
+ */
+SimSegment *
+ecsim_create(int nslaves)
+{
+    SimSegment *sim;
+    int k;
+    int offset = 0;
+
+    if ((nslaves < 1) || (nslaves > ECSIM_MAXSLAVE)) {
+        return NULL;
+    }
+    sim = calloc(1, sizeof(*sim));
+    if (!sim) {
+        return NULL;
+    }
+    sim->slaves = calloc(nslaves, sizeof(SimSlave));
+    sim->station = calloc(0x10000, sizeof(uint16));
+    if (!sim->slaves || !sim->station) {
+        ecsim_destroy(sim);
+        return NULL;
+    }
+    sim->nslaves = nslaves;
+    sim->sock = -1;
+    pthread_mutex_init(&sim->mutex, NULL);
+    od_find(0x6040, 0, &sim->controlword);
+    od_find(0x6041, 0, &sim->statusword);
+    od_find(0x6060, 0, &sim->modes);
+    od_find(0x6061, 0, &sim->modesdisplay);
+    od_find(0x6064, 0, &sim->actualposition);
+    od_find(0x606c, 0, &sim->actualvelocity);
+    od_find(0x6071, 0, &sim->targettorque);
+    od_find(0x6077, 0, &sim->actualtorque);
+    od_find(0x607a, 0, &sim->targetposition);
+    od_find(0x60ff, 0, &sim->targetvelocity);
+    /* last object must fit in the drive data */
+    od_find(0x6502, 0, &offset);
+    if (offset + 4 > ECSIM_ODSIZE) {
+        ecsim_destroy(sim);
+        return NULL;
+    }
+    for (k = 0; k < nslaves; ++k) {
+        esc_init(sim, &sim->slaves[k], k);
+        od_init(&sim->slaves[k], k);
+        sii_init(&sim->slaves[k], k);
+    }
+    return sim;
+}
+
+/** Destroy segment, stops its NIC thread.
+ * @param[in] sim         = segment
+ */
+void
+ecsim_destroy(SimSegment *sim)
+{
+    if (!sim) {
+        return;
+    }
+    ecsim_stop(sim);
+    if (attached == sim) {
+        attached = NULL;
+    }
+    if (sim->nslaves) {
+        pthread_mutex_destroy(&sim->mutex);
+    }
+    free(sim->station);
+    free(sim->slaves);
+    free(sim);
+}
+
+/** Number of slaves of the segment */
+int
+ecsim_slavecount(SimSegment *sim)
+{
+    return sim->nslaves;
+}
+
+/** Number of EtherCAT frames processed by the segment */
+uint64
+ecsim_framecount(SimSegment *sim)
+{
+    return sim->frames;
+}
+
+/** Process EtherCAT frame in place, as it returns from the last slave.
+ * @param[in] sim         = segment
+ * @param[in,out] frame   = frame incl. ethernet header
+ * @param[in] length      = frame length in bytes
+ * @return length, 0 if the frame is no EtherCAT frame
+ */
+int
+ecsim_process(SimSegment *sim, uint8 *frame, int length)
+{
+    int pos, dlength, hdrsize;
+    int64 now;
+
+    hdrsize = (int)(EC_HEADERSIZE - EC_ELENGTHSIZE);
+    if ((length < (int)(ETH_HEADERSIZE + EC_ELENGTHSIZE) + hdrsize) ||
+        (frame[12] != (ETH_P_ECAT >> 8)) || (frame[13] != (ETH_P_ECAT & 0xff))) {
+        return 0;
+    }
+    pthread_mutex_lock(&sim->mutex);
+    now = sim_now();
+    pos = (int)(ETH_HEADERSIZE + EC_ELENGTHSIZE);
+    while (pos + hdrsize <= length) {
+        dlength = get16(&frame[pos + 6]);
+        if (pos + hdrsize + (dlength & 0x07ff) + (int)EC_WKCSIZE > length) {
+            break;
+        }
+        sim_datagram(sim, &frame[pos], dlength & 0x07ff, now);
+        pos += hdrsize + (dlength & 0x07ff) + EC_WKCSIZE;
+        if (!(dlength & EC_DATAGRAMFOLLOWS)) {
+            break;
+        }
+    }
+    sim->frames++;
+    pthread_mutex_unlock(&sim->mutex);
+    /* returned through port 0 of the first slave */
+    frame[6] |= 0x02;
+
+    return length;
+}
+
+static void *
+ecsim_thread(void *arg)
+{
+    SimSegment *sim = arg;
+    uint8 frame[EC_BUFSIZE];
+    int length;
+
+    while (sim->running) {
+        length = recv(sim->sock, frame, sizeof(frame), 0);
+        if ((length > 0) && ecsim_process(sim, frame, length)) {
+            send(sim->sock, frame, length, 0);
+        }
+    }
+
+    return NULL;
+}
+
+/** Serve segment on NIC, f.e. the peer of a veth pair, from a thread.
+ * @param[in] sim         = segment
+ * @param[in] ifname      = NIC the master is connected to
+ * @return >0 if started
+ */
+int
+ecsim_start(SimSegment *sim, const char *ifname)
+{
+    struct ifreq ifr;
+    struct sockaddr_ll sll;
+    struct timeval timeout;
+
+    sim->sock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ECAT));
+    if (sim->sock < 0) {
+        return 0;
+    }
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 100000;
+    setsockopt(sim->sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    if (ioctl(sim->sock, SIOCGIFINDEX, &ifr) < 0) {
+        close(sim->sock);
+        sim->sock = -1;
+        return 0;
+    }
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_ifindex = ifr.ifr_ifindex;
+    sll.sll_protocol = htons(ETH_P_ECAT);
+    if (bind(sim->sock, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+        close(sim->sock);
+        sim->sock = -1;
+        return 0;
+    }
+    sim->running = 1;
+    if (pthread_create(&sim->thread, NULL, ecsim_thread, sim) != 0) {
+        sim->running = 0;
+        close(sim->sock);
+        sim->sock = -1;
+        return 0;
+    }
+
+    return 1;
+}
+
+/** Stop NIC thread of segment.
+ * @param[in] sim         = segment
+ */
+void
+ecsim_stop(SimSegment *sim)
+{
+    if (sim->running) {
+        sim->running = 0;
+        pthread_join(sim->thread, NULL);
+    }
+    if (sim->sock >= 0) {
+        close(sim->sock);
+        sim->sock = -1;
+    }
+}
+
+/** Select segment of ecsim_backend, before the port is set up.
+ * @param[in] sim         = segment
+ */
+void
+ecsim_attach(SimSegment *sim)
+{
+    attached = sim;
+}
+
+static int
+ecsim_backendsetup(ec_stackT *stack, const char *ifname)
+{
+    if (!attached) {
+        return 0;
+    }
+    return ecx_loopbackend.setup(stack, ifname);
+}
+
+static void
+ecsim_backendclose(ec_stackT *stack)
+{
+    ecx_loopbackend.close(stack);
+}
+
+/* The frame sent is processed by the segment and queued for receive. */
+static int
+ecsim_backendsend(ec_stackT *stack, const void *frame, int length)
+{
+    ec_bufT buf;
+
+    if (length > (int)sizeof(buf)) {
+        return -1;
+    }
+    memcpy(buf, frame, length);
+    ecsim_process(attached, buf, length);
+
+    return ecx_loopbackend.send(stack, buf, length);
+}
+
+static int
+ecsim_backendrecv(ecx_portt *port, ec_stackT *stack, uint8 **frame)
+{
+    return ecx_loopbackend.recv(port, stack, frame);
+}
+
+const ec_backendT ecsim_backend = {
+    "ecsim", ecsim_backendsetup, ecsim_backendclose, ecsim_backendsend,
+    ecsim_backendrecv, NULL
+};
@@ -0,0 +1,49 @@
+/** \file
+ * \brief Simulated EtherCAT segment for Simple Open EtherCAT master
+ *
+ * A segment is a line of virtual ESCs that process EtherCAT frames as real
+ * slaves do, see ecsim.c.
+ */
+
+#ifndef _ecsim_
+#define _ecsim_
+
+#include "ethercat.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** maximum number of slaves of a segment */
+#define ECSIM_MAXSLAVE      1024
+
+/** identity of the simulated drives */
+#define ECSIM_VENDOR        0x00000fff
+#define ECSIM_PRODUCT       0x00000402
+#define ECSIM_REVISION      0x00010000
+#define ECSIM_NAME          "ECsim CiA402 drive"
+
+/** process data of the default PDO mapping in bytes */
+#define ECSIM_RXPDOSIZE     14
+#define ECSIM_TXPDOSIZE     14
+
+typedef struct SimSegment SimSegment;
+
+SimSegment *ecsim_create(int nslaves);
+void ecsim_destroy(SimSegment *sim);
+int ecsim_slavecount(SimSegment *sim);
+uint64 ecsim_framecount(SimSegment *sim);
+int ecsim_process(SimSegment *sim, uint8 *frame, int length);
+int ecsim_start(SimSegment *sim, const char *ifname);
+void ecsim_stop(SimSegment *sim);
+void ecsim_attach(SimSegment *sim);
+
+/** NIC backend that passes every frame sent through the segment given to
+ * ecsim_attach(), for ecx_setupnic_backend() */
+extern const ec_backendT ecsim_backend;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
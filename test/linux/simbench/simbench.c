@@ -0,0 +1,618 @@
+/** \file
+ * \brief Master benchmark against a simulated segment for Simple Open
+ * EtherCAT master
+ *
+ * Usage: simbench [-z] [-g] [-s STATS] [-l POLICY] [-w CAPTURE] [-r CAPTURE] SLAVES [cycles] [sdos] [IFNAME PEERIF]
+ * SLAVES is the number of simulated CiA402 drives, f.e. 18 or 200.
+ * Without IFNAME the segment is attached in-process by its NIC backend, with
+ * IFNAME and PEERIF, the two ends of a veth pair, the segment is served by a
+ * thread on PEERIF and the master uses the plain socket on IFNAME.
+ *
+ * With -w all frames of the run are captured to the pcapng file CAPTURE.
+ * With -r the segment is replaced by the replay backend, which answers from
+ * CAPTURE with the recorded round trip times. Run with the same SLAVES,
+ * cycles and sdos as the capture to compare the master timing of two builds
+ * without the segment. With -z the process data is received in place.
+ * With -s the statistics of the cyclic exchange are exported in the shared
+ * memory object STATS, f.e. /simbench, for ecstat. With -l frames that miss
+ * the receive timeout are salvaged from the cycle after, sent once more or
+ * both, for POLICY salvage, retry or both. With -g the drives are split
+ * over groups 1 and 2 and each group is cycled by its own thread at the same
+ * time on the one port, the statistics of -s are those of group 1.
+ *
+ * The master configures the segment as an application would: enumeration,
+ * SII and CoE mapping, PDO tables, DC, SAFE-OP and OP. The time of every step
+ * is reported, then the cycle times of cycles process data exchanges in which
+ * the drives are enabled and follow a position ramp, and the throughput of
+ * sdos SDO uploads and downloads spread over all drives. Working counter
+ * errors and drives not following their targets are counted.
+ *
+ * Create the veth pair with:
+ *   ip link add ecat0 type veth peer name ecat1
+ *   ip link set ecat0 up
+ *   ip link set ecat1 up
+ */
+
+#include "ethercat.h"
+#include "ecsim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define BENCH_MAXSLAVE      ECSIM_MAXSLAVE
+#define BENCH_IOMAPSIZE     (BENCH_MAXSLAVE * (ECSIM_RXPDOSIZE + ECSIM_TXPDOSIZE))
+#define BENCH_ENABLECYCLES  3
+#define BENCH_CAPTURESIZE   (256 * 1024 * 1024)
+#define BENCH_RETRYTIMEOUT  (EC_TIMEOUTRET / 2)
+#define BENCH_MAXGROUPS     2
+
+typedef struct {
+    ecx_contextt    context;
+    uint8           map[BENCH_IOMAPSIZE];
+    ecx_portt       port;
+    ec_slavet       slavelist[BENCH_MAXSLAVE + 1];
+    int             slavecount;
+    ec_groupt       grouplist[EC_MAXGROUP];
+    uint8           esibuf[EC_MAXEEPBUF];
+    uint32          esimap[EC_MAXEEPBITMAP];
+    ec_eringt       elist;
+    boolean         ecaterror;
+    int64           DCtime;
+    ec_SMcommtypet  SMcommtype[EC_MAX_MAPT];
+    ec_PDOassignt   PDOassign[EC_MAX_MAPT];
+    ec_PDOdesct     PDOdesc[EC_MAX_MAPT];
+    ec_eepromSMt    eepSM;
+    ec_eepromFMMUt  eepFMMU;
+} Fieldbus;
+
+/* Objects of a drive, located by its PDO table */
+typedef struct {
+    ec_pdohandlet   control;
+    ec_pdohandlet   target;
+    ec_pdohandlet   status;
+    ec_pdohandlet   actual;
+} Drive;
+
+typedef struct {
+    int64           min;
+    int64           avg;
+    int64           p50;
+    int64           p99;
+    int64           max;
+} Stats;
+
+/* Cyclic exchange of one group */
+typedef struct {
+    Fieldbus       *fb;
+    uint8           group;
+    int             cycles;
+    int64          *samples;
+    int             wkcerrors;
+    int             notfollowing;
+} Cycler;
+
+static Fieldbus fieldbus;
+static Drive drives[BENCH_MAXSLAVE + 1];
+/* groups the drives are split over, 0 if all are cycled in group 0 */
+static int groups;
+
+static int64
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+cmp_int64(const void *a, const void *b)
+{
+    int64 x = *(const int64 *)a;
+    int64 y = *(const int64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void
+stats_compute(int64 *samples, int n, Stats *stats)
+{
+    int64 total;
+    int i;
+
+    qsort(samples, n, sizeof(*samples), cmp_int64);
+    total = 0;
+    for (i = 0; i < n; ++i) {
+        total += samples[i];
+    }
+    stats->min = samples[0];
+    stats->avg = total / n;
+    stats->p50 = samples[n / 2];
+    stats->p99 = samples[((int64)n * 99) / 100];
+    stats->max = samples[n - 1];
+}
+
+static void
+fieldbus_initialize(Fieldbus *fb)
+{
+    ecx_contextt *context;
+
+    memset(fb, 0, sizeof(*fb));
+    context = &fb->context;
+    context->port = &fb->port;
+    context->slavelist = fb->slavelist;
+    context->slavecount = &fb->slavecount;
+    context->maxslave = BENCH_MAXSLAVE + 1;
+    context->grouplist = fb->grouplist;
+    context->maxgroup = EC_MAXGROUP;
+    context->esibuf = fb->esibuf;
+    context->esimap = fb->esimap;
+    context->esislave = 0;
+    context->elist = &fb->elist;
+    context->idxstack = &fb->grouplist[0].idxstack;
+    context->ecaterror = &fb->ecaterror;
+    context->DCtime = &fb->DCtime;
+    context->SMcommtype = fb->SMcommtype;
+    context->PDOassign = fb->PDOassign;
+    context->PDOdesc = fb->PDOdesc;
+    context->eepSM = &fb->eepSM;
+    context->eepFMMU = &fb->eepFMMU;
+    context->manualstatechange = 0;
+}
+
+static int
+fieldbus_roundtrip(Fieldbus *fb)
+{
+    int g, wkc;
+
+    if (!groups) {
+        ecx_send_processdata(&fb->context);
+        return ecx_receive_processdata(&fb->context, EC_TIMEOUTRET);
+    }
+    wkc = 0;
+    for (g = 1; g <= groups; ++g) {
+        ecx_send_processdata_group(&fb->context, (uint8)g);
+        wkc += ecx_receive_processdata_group(&fb->context, (uint8)g, EC_TIMEOUTRET);
+    }
+
+    return wkc;
+}
+
+static void
+step_print(const char *name, int64 start)
+{
+    printf("  %-24s %10.3f ms\n", name, (now_ns() - start) / 1e6);
+}
+
+/* Locate the objects of the drives by their PDO tables */
+static boolean
+bench_handles(Fieldbus *fb)
+{
+    static ec_pdotablet table;
+    ecx_contextt *context = &fb->context;
+    Drive *drive;
+    int i;
+
+    for (i = 1; i <= fb->slavecount; ++i) {
+        drive = &drives[i];
+        if (!ecx_readpdotable(context, (uint16)i, &table) ||
+            !ecx_pdohandle(context, &table, 0x6040, 0, &drive->control) ||
+            !ecx_pdohandle(context, &table, 0x607a, 0, &drive->target) ||
+            !ecx_pdohandle(context, &table, 0x6041, 0, &drive->status) ||
+            !ecx_pdohandle(context, &table, 0x6064, 0, &drive->actual)) {
+            printf("slave %d does not map the CiA402 objects\n", i);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Bring the segment to OP, return FALSE if a step failed */
+static boolean
+bench_configure(Fieldbus *fb, int nslaves)
+{
+    ecx_contextt *context = &fb->context;
+    uint32 obytes, ibytes;
+    int64 start, total;
+    int i, g, size;
+
+    printf("configuration of %d slaves\n", nslaves);
+    total = now_ns();
+    start = now_ns();
+    if (ecx_config_init(context, FALSE) != nslaves) {
+        printf("found %d slaves, expected %d\n", fb->slavecount, nslaves);
+        return FALSE;
+    }
+    step_print("config_init", start);
+    start = now_ns();
+    if (!groups) {
+        ecx_config_map_group(context, fb->map, 0);
+        obytes = fb->grouplist[0].Obytes;
+        ibytes = fb->grouplist[0].Ibytes;
+    } else {
+        /* first half of the drives in group 1, the rest in group 2 */
+        for (i = 1; i <= fb->slavecount; ++i) {
+            fb->slavelist[i].group = (uint8)(1 + ((i - 1) * groups) / fb->slavecount);
+        }
+        size = 0;
+        obytes = 0;
+        ibytes = 0;
+        for (g = 1; g <= groups; ++g) {
+            size += ecx_config_map_group(context, fb->map + size, (uint8)g);
+            obytes += fb->grouplist[g].Obytes;
+            ibytes += fb->grouplist[g].Ibytes;
+        }
+    }
+    step_print("config_map_group", start);
+    if ((obytes != (uint32)nslaves * ECSIM_RXPDOSIZE) ||
+        (ibytes != (uint32)nslaves * ECSIM_TXPDOSIZE)) {
+        printf("mapped %uO+%uI bytes, expected %dO+%dI\n", obytes, ibytes,
+               nslaves * ECSIM_RXPDOSIZE, nslaves * ECSIM_TXPDOSIZE);
+        return FALSE;
+    }
+    start = now_ns();
+    if (!bench_handles(fb)) {
+        return FALSE;
+    }
+    step_print("pdo tables", start);
+    start = now_ns();
+    if (!ecx_configdc(context)) {
+        printf("no DC found\n");
+        return FALSE;
+    }
+    step_print("configdc", start);
+    start = now_ns();
+    ecx_statecheck(context, 0, EC_STATE_SAFE_OP, EC_TIMEOUTSTATE * 4);
+    if (fb->slavelist[0].state != EC_STATE_SAFE_OP) {
+        printf("not all slaves reached SAFE-OP\n");
+        return FALSE;
+    }
+    step_print("safe-op", start);
+    start = now_ns();
+    fieldbus_roundtrip(fb);
+    fb->slavelist[0].state = EC_STATE_OPERATIONAL;
+    ecx_writestate(context, 0);
+    for (i = 0; i < 10; ++i) {
+        fieldbus_roundtrip(fb);
+        ecx_statecheck(context, 0, EC_STATE_OPERATIONAL, EC_TIMEOUTSTATE / 10);
+        if (fb->slavelist[0].state == EC_STATE_OPERATIONAL) {
+            break;
+        }
+    }
+    if (fb->slavelist[0].state != EC_STATE_OPERATIONAL) {
+        printf("not all slaves reached OP\n");
+        return FALSE;
+    }
+    step_print("op", start);
+    step_print("total", total);
+
+    return TRUE;
+}
+
+/* Export the statistics of group in the shared memory object name */
+static ec_groupstatst *
+stats_export(Fieldbus *fb, uint8 group, const char *name)
+{
+    ec_groupstatst *stats;
+    int fd;
+
+    fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(*stats)) < 0) {
+        close(fd);
+        return NULL;
+    }
+    stats = mmap(NULL, sizeof(*stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (stats == MAP_FAILED) {
+        return NULL;
+    }
+    ecx_attachstats(&fb->context, group, stats);
+
+    return stats;
+}
+
+/* Cyclic exchange of a group, its drives are enabled and follow a position
+ * ramp */
+static void
+cycler_run(Cycler *cy)
+{
+    Fieldbus *fb = cy->fb;
+    ec_groupt *grp = &fb->grouplist[cy->group];
+    int64 start;
+    int c, i, wkc, expected;
+    uint16 control, status;
+    int32 position, actual;
+
+    expected = grp->outputsWKC * 2 + grp->inputsWKC;
+    cy->wkcerrors = 0;
+    cy->notfollowing = 0;
+    for (c = 0; c < cy->cycles; ++c) {
+        /* shutdown, switch on, enable operation, then ramp */
+        control = (c == 0) ? 0x0006 : (c == 1) ? 0x0007 : 0x000f;
+        position = (c >= BENCH_ENABLECYCLES) ? c * 10 : 0;
+        for (i = 1; i <= fb->slavecount; ++i) {
+            if (fb->slavelist[i].group == cy->group) {
+                ecx_pdoset(&drives[i].control, control);
+                ecx_pdoset(&drives[i].target, (uint32)(position + i));
+            }
+        }
+        start = now_ns();
+        ecx_send_processdata_group(&fb->context, cy->group);
+        wkc = ecx_receive_processdata_group(&fb->context, cy->group, EC_TIMEOUTRET);
+        cy->samples[c] = now_ns() - start;
+        if (wkc != expected) {
+            cy->wkcerrors++;
+            continue;
+        }
+        if (c < BENCH_ENABLECYCLES) {
+            continue;
+        }
+        for (i = 1; i <= fb->slavecount; ++i) {
+            if (fb->slavelist[i].group != cy->group) {
+                continue;
+            }
+            status = (uint16)ecx_pdoget(&drives[i].status);
+            actual = (int32)ecx_pdogetsigned(&drives[i].actual);
+            if (((status & 0x006f) != 0x0027) || (actual != position + i)) {
+                cy->notfollowing++;
+            }
+        }
+    }
+}
+
+static void *
+cycler_thread(void *param)
+{
+    cycler_run(param);
+    return NULL;
+}
+
+static void
+cycler_print(Cycler *cy)
+{
+    ec_groupt *grp = &cy->fb->grouplist[cy->group];
+    Stats stats;
+
+    stats_compute(cy->samples, cy->cycles, &stats);
+    if (groups) {
+        printf("group %d: ", cy->group);
+    }
+    printf("%d cycles of %uO+%uI bytes, %d frames, times in usec\n", cy->cycles,
+           grp->Obytes, grp->Ibytes, grp->nsegments);
+    printf("  %8s %8s %8s %8s %8s %8s %8s\n",
+           "min", "avg", "p50", "p99", "max", "wkcerr", "nofollow");
+    printf("  %8.1f %8.1f %8.1f %8.1f %8.1f %8d %8d\n", stats.min / 1e3,
+           stats.avg / 1e3, stats.p50 / 1e3, stats.p99 / 1e3, stats.max / 1e3,
+           cy->wkcerrors, cy->notfollowing);
+}
+
+/* Cyclic exchange of group 0, or of every group by its own thread at the
+ * same time */
+static void
+bench_cycles(Fieldbus *fb, int cycles)
+{
+    Cycler cyclers[BENCH_MAXGROUPS];
+    pthread_t threads[BENCH_MAXGROUPS];
+    int64 start, elapsed;
+    int g, n;
+
+    n = groups ? groups : 1;
+    for (g = 0; g < n; ++g) {
+        cyclers[g].fb = fb;
+        cyclers[g].group = (uint8)(groups ? g + 1 : 0);
+        cyclers[g].cycles = cycles;
+        cyclers[g].samples = malloc(sizeof(*cyclers[g].samples) * cycles);
+    }
+    if (!groups) {
+        cycler_run(&cyclers[0]);
+        cycler_print(&cyclers[0]);
+        free(cyclers[0].samples);
+        return;
+    }
+    start = now_ns();
+    for (g = 0; g < n; ++g) {
+        pthread_create(&threads[g], NULL, cycler_thread, &cyclers[g]);
+    }
+    for (g = 0; g < n; ++g) {
+        pthread_join(threads[g], NULL);
+    }
+    elapsed = now_ns() - start;
+    for (g = 0; g < n; ++g) {
+        cycler_print(&cyclers[g]);
+        free(cyclers[g].samples);
+    }
+    printf("%d groups cycled concurrently, %.0f cycles/s together\n", n,
+           (double)cycles * n * 1e9 / elapsed);
+}
+
+/* SDO uploads of the actual position and downloads of the target torque */
+static void
+bench_sdo(Fieldbus *fb, int sdos)
+{
+    ecx_contextt *context = &fb->context;
+    int64 start, elapsed;
+    int n, slave, size, failed;
+    int32 value;
+    int16 torque;
+
+    failed = 0;
+    start = now_ns();
+    for (n = 0; n < sdos; ++n) {
+        slave = 1 + (n % fb->slavecount);
+        size = sizeof(value);
+        if (ecx_SDOread(context, (uint16)slave, 0x6064, 0x00, FALSE, &size,
+                        &value, EC_TIMEOUTRXM) <= 0) {
+            failed++;
+        }
+    }
+    elapsed = now_ns() - start;
+    printf("%d SDO uploads   %10.0f/s %8.1f usec each, %d failed\n", sdos,
+           sdos * 1e9 / elapsed, elapsed / 1e3 / sdos, failed);
+
+    failed = 0;
+    start = now_ns();
+    for (n = 0; n < sdos; ++n) {
+        slave = 1 + (n % fb->slavecount);
+        torque = htoes((int16)n);
+        if (ecx_SDOwrite(context, (uint16)slave, 0x6071, 0x00, FALSE,
+                         sizeof(torque), &torque, EC_TIMEOUTRXM) <= 0) {
+            failed++;
+        }
+    }
+    elapsed = now_ns() - start;
+    printf("%d SDO downloads %10.0f/s %8.1f usec each, %d failed\n", sdos,
+           sdos * 1e9 / elapsed, elapsed / 1e3 / sdos, failed);
+}
+
+int
+main(int argc, char *argv[])
+{
+    SimSegment *sim;
+    const char *capture, *replay;
+    uint64 frames, overwritten, dropped;
+    const char *statsname;
+    ec_groupstatst *stats;
+    int nslaves, cycles, sdos, zerocopy, latepolicy, ok, g;
+
+    capture = NULL;
+    statsname = NULL;
+    stats = NULL;
+    replay = NULL;
+    zerocopy = 0;
+    latepolicy = EC_LATE_DROP;
+    while (argc > 2 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "-z")) {
+            zerocopy = 1;
+            argc--;
+            argv++;
+            continue;
+        } else if (!strcmp(argv[1], "-g")) {
+            groups = BENCH_MAXGROUPS;
+            argc--;
+            argv++;
+            continue;
+        } else if (!strcmp(argv[1], "-s")) {
+            statsname = argv[2];
+        } else if (!strcmp(argv[1], "-l")) {
+            if (!strcmp(argv[2], "salvage")) {
+                latepolicy = EC_LATE_SALVAGE;
+            } else if (!strcmp(argv[2], "retry")) {
+                latepolicy = EC_LATE_RETRY;
+            } else if (!strcmp(argv[2], "both")) {
+                latepolicy = EC_LATE_SALVAGE | EC_LATE_RETRY;
+            }
+        } else if (!strcmp(argv[1], "-w")) {
+            capture = argv[2];
+        } else if (!strcmp(argv[1], "-r")) {
+            replay = argv[2];
+        } else {
+            break;
+        }
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 2 || argv[1][0] == '-') {
+        printf("Usage: simbench [-z] [-g] [-s STATS] [-l POLICY] [-w CAPTURE] [-r CAPTURE] SLAVES [cycles] [sdos] [IFNAME PEERIF]\n"
+               "SLAVES is the number of simulated drives, up to %d\n"
+               "cycles defaults to 10000, sdos to 1000\n"
+               "without IFNAME and PEERIF, the two ends of a veth pair, the\n"
+               "segment is attached in-process\n"
+               "-w captures all frames to a pcapng file, -r replays one\n"
+               "instead of the segment, -z receives process data in place\n"
+               "-s exports the cycle statistics in shared memory STATS\n"
+               "-l handles lost frames by POLICY salvage, retry or both\n"
+               "-g cycles two groups of drives from two threads\n",
+               ECSIM_MAXSLAVE);
+        return 1;
+    }
+    nslaves = atoi(argv[1]);
+    cycles = argc > 2 ? atoi(argv[2]) : 10000;
+    sdos = argc > 3 ? atoi(argv[3]) : 1000;
+    if (cycles < BENCH_ENABLECYCLES + 1) {
+        cycles = BENCH_ENABLECYCLES + 1;
+    }
+    if (sdos < 1) {
+        sdos = 1;
+    }
+    if (groups && (nslaves < groups)) {
+        printf("-g needs at least %d slaves\n", groups);
+        return 1;
+    }
+    sim = ecsim_create(nslaves);
+    if (!sim) {
+        printf("Cannot create segment of %d slaves\n", nslaves);
+        return 1;
+    }
+
+    fieldbus_initialize(&fieldbus);
+    if (replay) {
+        ok = ecx_setupnic_transport(&fieldbus.port, replay, FALSE, ECT_TRANSPORT_REPLAY);
+    } else if (argc > 5) {
+        if (!ecsim_start(sim, argv[5])) {
+            printf("Cannot open segment on '%s'\n", argv[5]);
+            ecsim_destroy(sim);
+            return 1;
+        }
+        ok = ecx_setupnic(&fieldbus.port, argv[4], FALSE);
+    } else {
+        ecsim_attach(sim);
+        ok = ecx_setupnic_backend(&fieldbus.port, "ecsim", FALSE, &ecsim_backend);
+    }
+    if (!ok) {
+        printf("Cannot open port\n");
+        ecsim_destroy(sim);
+        return 1;
+    }
+    if (zerocopy && !ecx_setzerocopy(&fieldbus.port, TRUE)) {
+        printf("No in place receive on this port\n");
+    }
+    if (capture && !ecx_startcapture(&fieldbus.port, capture, BENCH_CAPTURESIZE)) {
+        printf("Cannot create capture '%s'\n", capture);
+        capture = NULL;
+    }
+
+    if (bench_configure(&fieldbus, nslaves)) {
+        for (g = groups ? 1 : 0; g <= groups; ++g) {
+            ecx_setlatepolicy(&fieldbus.context, (uint8)g, latepolicy, BENCH_RETRYTIMEOUT);
+        }
+        if (statsname && !(stats = stats_export(&fieldbus, groups ? 1 : 0, statsname))) {
+            printf("Cannot export statistics to '%s'\n", statsname);
+        }
+        bench_cycles(&fieldbus, cycles);
+        if (stats) {
+            printf("%llu cycles in statistics, %llu WKC faults, %llu frames lost, "
+                   "%llu recovered, %llu salvaged, latency p50 %.1f p99 %.1f usec\n",
+                   (unsigned long long)stats->cycles, (unsigned long long)stats->wkcfaults,
+                   (unsigned long long)stats->lostframes, (unsigned long long)stats->recovered,
+                   (unsigned long long)stats->salvaged,
+                   ecx_statspercentile(stats, 500) / 1e3, ecx_statspercentile(stats, 990) / 1e3);
+        }
+        bench_sdo(&fieldbus, sdos);
+    }
+    if (!replay) {
+        printf("%llu frames processed by the segment\n",
+               (unsigned long long)ecsim_framecount(sim));
+    }
+
+    fieldbus.slavelist[0].state = EC_STATE_INIT;
+    ecx_writestate(&fieldbus.context, 0);
+    if (capture) {
+        ecx_getcapturestats(&fieldbus.port, &frames, &overwritten, &dropped);
+        printf("%d frames captured, %llu overwritten, %llu dropped\n",
+               ecx_stopcapture(&fieldbus.port), (unsigned long long)overwritten,
+               (unsigned long long)dropped);
+    }
+    ecx_closenic(&fieldbus.port);
+    ecsim_destroy(sim);
+
+    return 0;
+}